@@ -0,0 +1,379 @@
+/*
+ * Config parse and apply benchmark
+ *
+ * Generates a small config, a large one (thousands of bindings, hundreds of
+ * rules) and an include-heavy tree, then times a fresh parse, a reload
+ * (parse, diff and adopt) and a load from the binary cache for each, and
+ * counts the allocations every step makes.
+ *
+ *   meson compile -C build starview-config-bench && ./build/starview-config-bench
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include "config.h"
+
+#define BENCH_ITERATIONS 50
+
+/*
+ * Allocation counting. The executable's malloc family shadows libc's, so
+ * allocations made inside libc on behalf of the parser (strdup, fopen,
+ * opendir) are counted too.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static size_t alloc_count;
+static size_t alloc_bytes;
+
+void *malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#define ALLOC_COUNTING 1
+#else
+static size_t alloc_count;
+static size_t alloc_bytes;
+#define ALLOC_COUNTING 0
+#endif
+
+struct sample {
+    double ms;
+    size_t allocs;
+    size_t bytes;
+};
+
+struct measure {
+    struct timespec start;
+    size_t allocs, bytes;
+};
+
+static void measure_start(struct measure *m) {
+    m->allocs = alloc_count;
+    m->bytes = alloc_bytes;
+    clock_gettime(CLOCK_MONOTONIC, &m->start);
+}
+
+static void measure_stop(struct measure *m, struct sample *total) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    total->ms += (end.tv_sec - m->start.tv_sec) * 1000.0 +
+                 (end.tv_nsec - m->start.tv_nsec) / 1e6;
+    total->allocs += alloc_count - m->allocs;
+    total->bytes += alloc_bytes - m->bytes;
+}
+
+/*
+ * CONFIG GENERATION
+ */
+static char bench_dir[] = "/tmp/starview-config-bench-XXXXXX";
+
+static const char *modifier_sets[] = {
+    "", "Alt+", "Ctrl+", "Shift+", "Super+", "Alt+Shift+", "Alt+Ctrl+",
+    "Ctrl+Shift+", "Super+Shift+", "Super+Ctrl+", "Super+Alt+",
+    "Alt+Ctrl+Shift+", "Super+Alt+Shift+", "Super+Ctrl+Shift+",
+    "Super+Alt+Ctrl+", "Super+Alt+Ctrl+Shift+",
+};
+#define MODIFIER_SETS (int)(sizeof(modifier_sets) / sizeof(*modifier_sets))
+
+static const char *actions[] = {
+    "spawn foot -e htop", "close", "fullscreen", "toggle_floating",
+    "focus left", "move right", "workspace 3", "move_to_workspace 5",
+    "resize_grow_width", "spawn grim -g \\\"$(slurp)\\\" ~/shot.png",
+};
+#define ACTIONS (int)(sizeof(actions) / sizeof(*actions))
+
+static void key_name(int i, char *buf, size_t size) {
+    if (i < 26) snprintf(buf, size, "%c", 'a' + i);
+    else if (i < 36) snprintf(buf, size, "%d", i - 26);
+    else snprintf(buf, size, "F%d", i - 35);
+}
+#define KEY_NAMES 47
+
+static FILE *open_file(const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", bench_dir, name);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        exit(1);
+    }
+    return fp;
+}
+
+static void write_header(FILE *fp) {
+    fputs("[general]\n"
+          "gaps_inner = 5\n"
+          "gaps_outer = 10\n"
+          "border_width = 2\n"
+          "border_color_active = \"#89b4fa\"\n"
+          "border_color_inactive = \"#45475a\"\n"
+          "focus_follows_mouse = true\n"
+          "default_mode = \"tiling\"\n\n"
+          "[decoration]\n"
+          "enabled = true\n"
+          "height = 30\n"
+          "bg_color = \"#1e1e2e\"\n"
+          "title_color = \"#cdd6f4\"\n"
+          "close_color = \"#f38ba8\"\n"
+          "font = \"sans\"\n"
+          "font_size = 12\n\n"
+          "[animation]\n"
+          "enabled = true\n"
+          "duration = 200\n"
+          "window_open = \"zoom\"\n"
+          "curve = \"ease_out\"\n\n", fp);
+}
+
+// count bindings, starting at combination first, as TOML key/value lines
+static void write_bindings(FILE *fp, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        char key[8];
+        key_name(i % KEY_NAMES, key, sizeof(key));
+        fprintf(fp, "\"%s%s\" = \"%s\"\n",
+                modifier_sets[(i / KEY_NAMES) % MODIFIER_SETS], key,
+                actions[i % ACTIONS]);
+    }
+}
+
+static void write_rules(FILE *fp, int count) {
+    for (int i = 0; i < count; i++) {
+        fputs("\n[[rules]]\n", fp);
+        switch (i % 4) {
+        case 0: fprintf(fp, "app_id = \"org.example.app%d\"\n", i); break;
+        case 1: fprintf(fp, "app_id = \"com.vendor%d.*\"\n", i); break;
+        case 2: fprintf(fp, "title = \"*Window %d*\"\n", i); break;
+        case 3: fprintf(fp, "app_id = \"tool%d\"\ntitle = \"* - Settings\"\n", i); break;
+        }
+        fprintf(fp, "floating = %s\n", i % 2 ? "true" : "false");
+        if (i % 3 == 0) fprintf(fp, "workspace = %d\n", 1 + i % 9);
+        if (i % 5 == 0) fprintf(fp, "width = %d\nheight = %d\n", 400 + i, 300 + i);
+    }
+}
+
+static void write_autostart(FILE *fp, int count) {
+    fputs("autostart = [\n", fp);
+    for (int i = 0; i < count; i++)
+        fprintf(fp, "    \"daemon%d --flag --log ~/.local/state/daemon%d.log\",\n", i, i);
+    fputs("]\n", fp);
+}
+
+// The same settings as the bundled starview.toml, in one valid file
+static void generate_small(void) {
+    FILE *fp = open_file("small.toml");
+    write_autostart(fp, 4);
+    write_header(fp);
+    fputs("[keybinds]\n", fp);
+    write_bindings(fp, KEY_NAMES, 60);
+    fputs("\n[modes.resize]\n"
+          "\"h\" = \"resize_shrink_width\"\n"
+          "\"l\" = \"resize_grow_width\"\n"
+          "\"Escape\" = \"mode default\"\n", fp);
+    write_rules(fp, 6);
+    fclose(fp);
+}
+
+static void generate_large(void) {
+    FILE *fp = open_file("large.toml");
+    write_autostart(fp, 100);
+    write_header(fp);
+    fputs("[keybinds]\n", fp);
+    write_bindings(fp, 0, KEY_NAMES * MODIFIER_SETS);
+    for (int m = 0; m < 4; m++) {
+        fprintf(fp, "\n[modes.mode%d]\n", m);
+        write_bindings(fp, m * 100, 400);
+    }
+    write_rules(fp, 400);
+    fclose(fp);
+}
+
+/*
+ * main.toml includes a directory of 150 small files and a chain of nested
+ * includes as deep as MAX_INCLUDE_DEPTH allows.
+ */
+static void generate_includes(void) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/include.d", bench_dir);
+    mkdir(path, 0700);
+
+    FILE *fp = open_file("include.toml");
+    fprintf(fp, "include = [\"include.d/\", \"chain1.toml\"]\n");
+    write_header(fp);
+    fclose(fp);
+
+    for (int i = 0; i < 150; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "include.d/part%03d.toml", i);
+        fp = open_file(name);
+        fprintf(fp, "[modes.part%d]\n", i);
+        write_bindings(fp, i, 8);
+        write_rules(fp, 2);
+        fclose(fp);
+    }
+
+    for (int i = 1; i < MAX_INCLUDE_DEPTH; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "chain%d.toml", i);
+        fp = open_file(name);
+        if (i + 1 < MAX_INCLUDE_DEPTH)
+            fprintf(fp, "include = [\"chain%d.toml\"]\n", i + 1);
+        fprintf(fp, "[modes.chain%d]\n", i);
+        write_bindings(fp, i * 20, 20);
+        fclose(fp);
+    }
+}
+
+/*
+ * The cache only stores a parse when every source predates it by a
+ * second, so moving mtimes back enables it and touching them disables it.
+ */
+static void set_source_age(int seconds) {
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= seconds;
+    times[1] = times[0];
+    for (int i = 0; i < config.source_count; i++)
+        utimes(config.sources[i], times);
+}
+
+static void remove_cache(void) {
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s/cache'", bench_dir);
+    if (system(cmd) != 0) fprintf(stderr, "could not clear %s/cache\n", bench_dir);
+}
+
+// The parser logs every file it loads; keep that out of the timings
+static int saved_fds[2] = { -1, -1 };
+
+static void quiet(bool on) {
+    fflush(stdout);
+    fflush(stderr);
+    for (int fd = STDOUT_FILENO; fd <= STDERR_FILENO; fd++) {
+        int *saved = &saved_fds[fd - STDOUT_FILENO];
+        if (on) {
+            *saved = dup(fd);
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, fd);
+            close(null);
+        } else if (*saved >= 0) {
+            dup2(*saved, fd);
+            close(*saved);
+            *saved = -1;
+        }
+    }
+}
+
+static void report(const char *step, const struct sample *s) {
+    printf("  %-8s %9.3f ms", step, s->ms / BENCH_ITERATIONS);
+    if (ALLOC_COUNTING)
+        printf("  %8zu allocs  %10zu bytes",
+               s->allocs / BENCH_ITERATIONS, s->bytes / BENCH_ITERATIONS);
+    printf("\n");
+}
+
+static void bench_config(const char *name) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", bench_dir, name);
+
+    // config_load() parses into the live config, which must start empty
+    config_free(&config);
+    quiet(true);
+    int ret = config_load(path);
+    quiet(false);
+    if (ret < 0) {
+        fprintf(stderr, "%s does not parse\n", path);
+        exit(1);
+    }
+    printf("%s: %d files, %d keybinds, %d modes, %d rules, %d autostart\n",
+           name, config.source_count, config.keybind_count,
+           config.binding_mode_count, config.rule_count, config.autostart_count);
+
+    struct sample parse = {0}, apply = {0}, cached = {0};
+    struct measure m;
+
+    // Fresh sources are never cached, so these are all full parses
+    set_source_age(0);
+    quiet(true);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        measure_start(&m);
+        struct config *next = config_reload_begin();
+        ret = config_reload_parse(next);
+        measure_stop(&m, &parse);
+
+        uint32_t changed;
+        measure_start(&m);
+        config_reload_finish(next, ret, &changed);
+        measure_stop(&m, &apply);
+    }
+
+    // One parse to store the snapshot, then every load is a hit
+    set_source_age(60);
+    uint32_t changed;
+    config_reload(&changed);
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        measure_start(&m);
+        struct config *next = config_reload_begin();
+        ret = config_reload_parse(next);
+        measure_stop(&m, &cached);
+        config_reload_finish(next, ret, &changed);
+    }
+    quiet(false);
+
+    report("parse", &parse);
+    report("apply", &apply);
+    report("cached", &cached);
+    remove_cache();
+}
+
+int main(void) {
+    if (!mkdtemp(bench_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    char cache[512];
+    snprintf(cache, sizeof(cache), "%s/cache", bench_dir);
+    setenv("XDG_CACHE_HOME", cache, 1);
+
+    generate_small();
+    generate_large();
+    generate_includes();
+
+    printf("%d iterations; parse = begin + parse, apply = diff + adopt + "
+           "keybind index\n", BENCH_ITERATIONS);
+    bench_config("small.toml");
+    bench_config("large.toml");
+    bench_config("include.toml");
+
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", bench_dir);
+    return system(cmd) == 0 ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+/*
+ * IPC load generator
+ *
+ * Opens a set of request/reply clients and a set of subscribers against the
+ * i3-compatible socket and reports round-trip latency percentiles,
+ * throughput, event fan-out and the compositor's CPU use over the run.
+ *
+ *   starview-ipc-bench --clients 16 --rate 200 --duration 10
+ *   starview-ipc-bench --spawn ./build/compositor --max-p99-us 2000
+ *
+ * With --spawn the compositor is started on the headless backend with a
+ * private socket and a throwaway HOME holding a minimal config, so it never
+ * reads the user's config, runs their autostart or writes their cache. This
+ * is how the meson benchmark target runs it. The exit
+ * status is 1 when a --max-* threshold is exceeded, so the run can gate IPC
+ * changes.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define IPC_MAGIC "i3-ipc"
+#define IPC_MAGIC_LEN 6
+#define IPC_HEADER_LEN 14
+
+#define IPC_COMMAND 0
+#define IPC_GET_WORKSPACES 1
+#define IPC_SUBSCRIBE 2
+#define IPC_GET_TREE 4
+#define IPC_EVENT_MASK 0x80000000u
+
+// Outstanding requests per client in open-loop mode
+#define MAX_IN_FLIGHT 256
+
+struct options {
+    const char *socket_path;
+    const char *spawn;
+    int clients;
+    int subscribers;
+    double rate;            // requests/s per client, 0 = closed loop
+    double duration;
+    int weight_tree;
+    int weight_workspaces;
+    int weight_command;
+    const char *command;
+    uint64_t max_p99_us;
+    uint64_t max_p999_us;
+};
+
+struct client {
+    int fd;
+    bool subscriber;
+
+    char *in;
+    size_t in_len;
+    size_t in_cap;
+
+    uint64_t sent_at[MAX_IN_FLIGHT];
+    int head, in_flight;
+    uint64_t next_send;
+
+    uint64_t replies;
+    uint64_t events;
+    uint64_t event_bytes;
+};
+
+struct samples {
+    uint64_t *ns;
+    size_t len;
+    size_t cap;
+};
+
+static volatile sig_atomic_t interrupted;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+static void samples_add(struct samples *samples, uint64_t ns) {
+    if (samples->len == samples->cap) {
+        size_t cap = samples->cap ? samples->cap * 2 : 65536;
+        uint64_t *data = realloc(samples->ns, cap * sizeof(*data));
+        if (!data) return;
+        samples->ns = data;
+        samples->cap = cap;
+    }
+    samples->ns[samples->len++] = ns;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const struct samples *samples, double p) {
+    if (samples->len == 0) return 0;
+    size_t index = (size_t)(p * (samples->len - 1) + 0.5);
+    return samples->ns[index];
+}
+
+static int ipc_connect(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool ipc_send(int fd, uint32_t type, const char *payload) {
+    uint32_t len = payload ? strlen(payload) : 0;
+    char header[IPC_HEADER_LEN];
+    memcpy(header, IPC_MAGIC, IPC_MAGIC_LEN);
+    memcpy(header + 6, &len, 4);
+    memcpy(header + 10, &type, 4);
+
+    // Requests are tiny; a short write here means the compositor stalled
+    char buf[IPC_HEADER_LEN + 512];
+    if (len > sizeof(buf) - IPC_HEADER_LEN) return false;
+    memcpy(buf, header, IPC_HEADER_LEN);
+    if (len) memcpy(buf + IPC_HEADER_LEN, payload, len);
+    return send(fd, buf, IPC_HEADER_LEN + len, MSG_NOSIGNAL) == (ssize_t)(IPC_HEADER_LEN + len);
+}
+
+static void client_send_request(struct client *client, const struct options *opts,
+                                uint64_t now) {
+    int total = opts->weight_tree + opts->weight_workspaces + opts->weight_command;
+    int pick = rand() % total;
+
+    uint32_t type = IPC_COMMAND;
+    const char *payload = opts->command;
+    if (pick < opts->weight_tree) {
+        type = IPC_GET_TREE;
+        payload = NULL;
+    } else if (pick < opts->weight_tree + opts->weight_workspaces) {
+        type = IPC_GET_WORKSPACES;
+        payload = NULL;
+    }
+
+    if (!ipc_send(client->fd, type, payload)) return;
+    client->sent_at[(client->head + client->in_flight) % MAX_IN_FLIGHT] = now;
+    client->in_flight++;
+}
+
+// Consume complete messages; replies are matched to sends in FIFO order
+static bool client_read(struct client *client, struct samples *samples) {
+    if (client->in_cap - client->in_len < 65536) {
+        size_t cap = client->in_cap ? client->in_cap * 2 : 131072;
+        char *in = realloc(client->in, cap);
+        if (!in) return false;
+        client->in = in;
+        client->in_cap = cap;
+    }
+
+    ssize_t n = recv(client->fd, client->in + client->in_len,
+                     client->in_cap - client->in_len, MSG_DONTWAIT);
+    if (n == 0) return false;
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    client->in_len += n;
+
+    uint64_t now = now_ns();
+    size_t pos = 0;
+    while (client->in_len - pos >= IPC_HEADER_LEN) {
+        uint32_t len, type;
+        memcpy(&len, client->in + pos + 6, 4);
+        memcpy(&type, client->in + pos + 10, 4);
+        if (client->in_len - pos < IPC_HEADER_LEN + len) break;
+        pos += IPC_HEADER_LEN + len;
+
+        if (type & IPC_EVENT_MASK) {
+            client->events++;
+            client->event_bytes += len;
+        } else if (client->in_flight > 0) {
+            uint64_t sent = client->sent_at[client->head];
+            client->head = (client->head + 1) % MAX_IN_FLIGHT;
+            client->in_flight--;
+            client->replies++;
+            if (!client->subscriber) samples_add(samples, now - sent);
+        }
+    }
+    memmove(client->in, client->in + pos, client->in_len - pos);
+    client->in_len -= pos;
+    return true;
+}
+
+// utime + stime of a process, in seconds
+static double process_cpu_seconds(pid_t pid) {
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+
+    // Skip "pid (comm)" first, since comm may contain spaces
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    unsigned long utime, stime;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+               &utime, &stime) != 2) {
+        return -1;
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// No autostart, no config watching and no X server
+static const char sandbox_config[] =
+    "[general]\n"
+    "auto_reload = false\n"
+    "\n"
+    "[xwayland]\n"
+    "enabled = false\n";
+
+// HOME of a spawned compositor; also holds its IPC socket
+static char sandbox_dir[] = "/tmp/starview-ipc-bench.XXXXXX";
+
+static bool sandbox_create(void) {
+    if (!mkdtemp(sandbox_dir)) return false;
+
+    char path[256];
+    static const char *const dirs[] = { "/.config", "/.config/starview", "/.cache", "/bin" };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s%s", sandbox_dir, dirs[i]);
+        if (mkdir(path, 0700) < 0) return false;
+    }
+
+    snprintf(path, sizeof(path), "%s/.config/starview/starview.toml", sandbox_dir);
+    FILE *f = fopen(path, "w");
+    if (!f) return false;
+    fputs(sandbox_config, f);
+    return fclose(f) == 0;
+}
+
+static int sandbox_remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+static void sandbox_remove(void) {
+    nftw(sandbox_dir, sandbox_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// The compositor itself is the child, so its /proc stat is what gets measured
+static pid_t spawn_compositor(const char *path, const char *socket_path) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+
+    setenv("WLR_BACKENDS", "headless", 1);
+    setenv("WLR_RENDERER", "pixman", 1);
+    setenv("WLR_LIBINPUT_NO_DEVICES", "1", 1);
+    setenv("SWAYSOCK", socket_path, 1);
+
+    char dir[256];
+    setenv("HOME", sandbox_dir, 1);
+    snprintf(dir, sizeof(dir), "%s/.config", sandbox_dir);
+    setenv("XDG_CONFIG_HOME", dir, 1);
+    snprintf(dir, sizeof(dir), "%s/.cache", sandbox_dir);
+    setenv("XDG_CACHE_HOME", dir, 1);
+    // An empty PATH, so the terminal launched at startup is never found
+    snprintf(dir, sizeof(dir), "%s/bin", sandbox_dir);
+    setenv("PATH", dir, 1);
+
+    // Keep the compositor's logging out of the report
+    freopen("/dev/null", "w", stdout);
+    execv(path, (char *[]){ (char *)path, NULL });
+    _exit(127);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -S, --socket PATH       IPC socket (default $SWAYSOCK)\n"
+        "  -x, --spawn PATH        start the compositor at PATH on the headless backend\n"
+        "  -c, --clients N         request/reply clients (default 8)\n"
+        "  -s, --subscribers N     event subscribers (default 2)\n"
+        "  -r, --rate N            requests/s per client, 0 = closed loop (default 0)\n"
+        "  -d, --duration SECONDS  run time (default 5)\n"
+        "  -m, --mix T:W:C         weights of GET_TREE, GET_WORKSPACES, COMMAND (default 2:2:1)\n"
+        "  -C, --command STRING    payload for COMMAND requests (default \"nop\")\n"
+        "      --max-p99-us N      fail if p99 exceeds N microseconds\n"
+        "      --max-p999-us N     fail if p99.9 exceeds N microseconds\n",
+        argv0);
+}
+
+int main(int argc, char **argv) {
+    struct options opts = {
+        .socket_path = getenv("SWAYSOCK"),
+        .clients = 8,
+        .subscribers = 2,
+        .duration = 5,
+        .weight_tree = 2,
+        .weight_workspaces = 2,
+        .weight_command = 1,
+        .command = "nop",
+    };
+
+    static const struct option long_options[] = {
+        { "socket", required_argument, NULL, 'S' },
+        { "spawn", required_argument, NULL, 'x' },
+        { "clients", required_argument, NULL, 'c' },
+        { "subscribers", required_argument, NULL, 's' },
+        { "rate", required_argument, NULL, 'r' },
+        { "duration", required_argument, NULL, 'd' },
+        { "mix", required_argument, NULL, 'm' },
+        { "command", required_argument, NULL, 'C' },
+        { "max-p99-us", required_argument, NULL, 'P' },
+        { "max-p999-us", required_argument, NULL, 'Q' },
+        { "help", no_argument, NULL, 'h' },
+        { 0 },
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "S:x:c:s:r:d:m:C:h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'S': opts.socket_path = optarg; break;
+        case 'x': opts.spawn = optarg; break;
+        case 'c': opts.clients = atoi(optarg); break;
+        case 's': opts.subscribers = atoi(optarg); break;
+        case 'r': opts.rate = atof(optarg); break;
+        case 'd': opts.duration = atof(optarg); break;
+        case 'm':
+            if (sscanf(optarg, "%d:%d:%d", &opts.weight_tree,
+                       &opts.weight_workspaces, &opts.weight_command) != 3) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'C': opts.command = optarg; break;
+        case 'P': opts.max_p99_us = strtoull(optarg, NULL, 10); break;
+        case 'Q': opts.max_p999_us = strtoull(optarg, NULL, 10); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (opts.weight_tree + opts.weight_workspaces + opts.weight_command <= 0 ||
+        opts.clients < 0 || opts.subscribers < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    char spawn_socket[108];
+    pid_t child = -1;
+    if (opts.spawn) {
+        if (!sandbox_create()) {
+            fprintf(stderr, "sandbox %s: %s\n", sandbox_dir, strerror(errno));
+            sandbox_remove();
+            return 1;
+        }
+        snprintf(spawn_socket, sizeof(spawn_socket), "%s/ipc.sock", sandbox_dir);
+        opts.socket_path = spawn_socket;
+        child = spawn_compositor(opts.spawn, spawn_socket);
+        if (child < 0) {
+            perror("fork");
+            sandbox_remove();
+            return 1;
+        }
+    }
+    if (!opts.socket_path) {
+        fprintf(stderr, "No IPC socket: set $SWAYSOCK or use --socket/--spawn\n");
+        return 2;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    int total = opts.clients + opts.subscribers;
+    struct client *clients = calloc(total ? total : 1, sizeof(*clients));
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!clients || epfd < 0) return 1;
+
+    // A freshly spawned compositor needs a moment to create its socket
+    uint64_t connect_deadline = now_ns() + 10ull * 1000000000ull;
+    for (int i = 0; i < total; i++) {
+        struct client *client = &clients[i];
+        while ((client->fd = ipc_connect(opts.socket_path)) < 0 &&
+               opts.spawn && now_ns() < connect_deadline && !interrupted) {
+            usleep(50000);
+        }
+        if (client->fd < 0) {
+            fprintf(stderr, "connect %s: %s\n", opts.socket_path, strerror(errno));
+            if (child > 0) {
+                kill(child, SIGTERM);
+                waitpid(child, NULL, 0);
+                sandbox_remove();
+            }
+            return 1;
+        }
+
+        client->subscriber = i >= opts.clients;
+        if (client->subscriber) {
+            ipc_send(client->fd, IPC_SUBSCRIBE, "[\"window\",\"workspace\",\"mode\",\"tick\"]");
+            client->sent_at[0] = now_ns();
+            client->in_flight = 1;
+        }
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = client };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, client->fd, &ev);
+    }
+
+    pid_t compositor = child;
+    if (compositor <= 0 && total > 0) {
+        struct ucred cred;
+        socklen_t len = sizeof(cred);
+        if (getsockopt(clients[0].fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0) {
+            compositor = cred.pid;
+        }
+    }
+
+    struct samples samples = {0};
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(opts.duration * 1e9);
+    uint64_t interval = opts.rate > 0 ? (uint64_t)(1e9 / opts.rate) : 0;
+    double cpu_start = compositor > 0 ? process_cpu_seconds(compositor) : -1;
+
+    // Stagger open-loop clients so they do not fire in lockstep
+    for (int i = 0; i < opts.clients; i++) {
+        clients[i].next_send = start + (interval ? interval * i / (opts.clients ? opts.clients : 1) : 0);
+    }
+
+    bool failed = false;
+    struct epoll_event events[64];
+    while (!interrupted && !failed) {
+        uint64_t now = now_ns();
+        if (now >= end) break;
+
+        uint64_t wake = end;
+        for (int i = 0; i < opts.clients; i++) {
+            struct client *client = &clients[i];
+            if (interval == 0) {
+                if (client->in_flight == 0) client_send_request(client, &opts, now);
+                continue;
+            }
+            while (client->next_send <= now && client->in_flight < MAX_IN_FLIGHT) {
+                client_send_request(client, &opts, now);
+                client->next_send += interval;
+            }
+            if (client->next_send < wake) wake = client->next_send;
+        }
+
+        int timeout = wake > now ? (int)((wake - now + 999999) / 1000000) : 0;
+        int n = epoll_wait(epfd, events, 64, timeout);
+        for (int i = 0; i < n; i++) {
+            if (!client_read(events[i].data.ptr, &samples)) {
+                fprintf(stderr, "compositor closed a connection\n");
+                failed = true;
+            }
+        }
+    }
+
+    double elapsed = (now_ns() - start) / 1e9;
+    double cpu_end = compositor > 0 ? process_cpu_seconds(compositor) : -1;
+
+    uint64_t events_total = 0, event_bytes = 0;
+    for (int i = opts.clients; i < total; i++) {
+        events_total += clients[i].events;
+        event_bytes += clients[i].event_bytes;
+    }
+
+    qsort(samples.ns, samples.len, sizeof(*samples.ns), compare_u64);
+    uint64_t p50 = percentile(&samples, 0.50) / 1000;
+    uint64_t p99 = percentile(&samples, 0.99) / 1000;
+    uint64_t p999 = percentile(&samples, 0.999) / 1000;
+    uint64_t max = samples.len ? samples.ns[samples.len - 1] / 1000 : 0;
+
+    printf("clients:     %d request/reply, %d subscribers, %s\n",
+           opts.clients, opts.subscribers,
+           interval ? "open loop" : "closed loop");
+    printf("requests:    %zu in %.2fs (%.0f/s)\n", samples.len, elapsed, samples.len / elapsed);
+    printf("latency us:  p50 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+           (unsigned long long)p50, (unsigned long long)p99,
+           (unsigned long long)p999, (unsigned long long)max);
+    printf("events:      %llu (%.0f/s, %.1f KiB/s per subscriber)\n",
+           (unsigned long long)events_total, events_total / elapsed,
+           opts.subscribers ? event_bytes / 1024.0 / elapsed / opts.subscribers : 0.0);
+    if (cpu_start >= 0 && cpu_end >= 0) {
+        printf("compositor:  pid %d, %.1f%% CPU\n", (int)compositor,
+               100.0 * (cpu_end - cpu_start) / elapsed);
+    }
+
+    if (opts.max_p99_us && p99 > opts.max_p99_us) {
+        fprintf(stderr, "FAIL: p99 %lluus > %lluus\n",
+                (unsigned long long)p99, (unsigned long long)opts.max_p99_us);
+        failed = true;
+    }
+    if (opts.max_p999_us && p999 > opts.max_p999_us) {
+        fprintf(stderr, "FAIL: p99.9 %lluus > %lluus\n",
+                (unsigned long long)p999, (unsigned long long)opts.max_p999_us);
+        failed = true;
+    }
+
+    for (int i = 0; i < total; i++) {
+        close(clients[i].fd);
+        free(clients[i].in);
+    }
+    free(clients);
+    free(samples.ns);
+
+    if (child > 0) {
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+        sandbox_remove();
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * GET_TREE serialization benchmark
+ *
+ * Builds a synthetic tree the size of a busy session (10 workspaces, 200
+ * windows) the way ipc.c used to with json-c, and the way it does now with
+ * the streaming writer, and reports the average time and allocation
+ * pattern of each.
+ *
+ *   meson compile -C build starview-json-bench && ./build/starview-json-bench
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "json_writer.h"
+
+#define BENCH_WORKSPACES 10
+#define BENCH_WINDOWS 200
+#define BENCH_ITERATIONS 2000
+
+struct bench_window {
+    char title[64];
+    char app_id[32];
+    int workspace;
+    int x, y, width, height;
+    bool floating;
+};
+
+static struct bench_window windows[BENCH_WINDOWS];
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static struct json_object *jc_rect(int x, int y, int width, int height) {
+    struct json_object *rect = json_object_new_object();
+    json_object_object_add(rect, "x", json_object_new_int(x));
+    json_object_object_add(rect, "y", json_object_new_int(y));
+    json_object_object_add(rect, "width", json_object_new_int(width));
+    json_object_object_add(rect, "height", json_object_new_int(height));
+    return rect;
+}
+
+static char *tree_jsonc(void) {
+    struct json_object *root = json_object_new_object();
+    json_object_object_add(root, "id", json_object_new_int(1));
+    json_object_object_add(root, "type", json_object_new_string("root"));
+    json_object_object_add(root, "rect", jc_rect(0, 0, 1920, 1080));
+
+    struct json_object *workspaces = json_object_new_array();
+    for (int ws = 1; ws <= BENCH_WORKSPACES; ws++) {
+        struct json_object *node = json_object_new_object();
+        json_object_object_add(node, "id", json_object_new_int(100 + ws));
+        json_object_object_add(node, "type", json_object_new_string("workspace"));
+        json_object_object_add(node, "num", json_object_new_int(ws));
+        json_object_object_add(node, "rect", jc_rect(0, 0, 1920, 1080));
+
+        struct json_object *nodes = json_object_new_array();
+        for (int i = 0; i < BENCH_WINDOWS; i++) {
+            struct bench_window *win = &windows[i];
+            if (win->workspace != ws) continue;
+
+            struct json_object *con = json_object_new_object();
+            json_object_object_add(con, "id", json_object_new_int64((int64_t)(uintptr_t)win));
+            json_object_object_add(con, "type",
+                json_object_new_string(win->floating ? "floating_con" : "con"));
+            json_object_object_add(con, "name", json_object_new_string(win->title));
+            json_object_object_add(con, "app_id", json_object_new_string(win->app_id));
+            json_object_object_add(con, "focused", json_object_new_boolean(i == 0));
+            json_object_object_add(con, "visible", json_object_new_boolean(ws == 1));
+            json_object_object_add(con, "rect",
+                jc_rect(win->x, win->y, win->width, win->height));
+            json_object_object_add(con, "window_rect",
+                jc_rect(0, 24, win->width, win->height - 24));
+            json_object_object_add(con, "nodes", json_object_new_array());
+            json_object_array_add(nodes, con);
+        }
+        json_object_object_add(node, "nodes", nodes);
+        json_object_array_add(workspaces, node);
+    }
+    json_object_object_add(root, "nodes", workspaces);
+
+    char *result = strdup(json_object_to_json_string_ext(root, JSON_C_TO_STRING_PLAIN));
+    json_object_put(root);
+    return result;
+}
+
+static void tree_writer(struct json_writer *w) {
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_kv_int(w, "id", 1);
+    jw_kv_string(w, "type", "root");
+    jw_kv_rect(w, "rect", 0, 0, 1920, 1080);
+
+    jw_key(w, "nodes");
+    jw_array_begin(w);
+    for (int ws = 1; ws <= BENCH_WORKSPACES; ws++) {
+        jw_object_begin(w);
+        jw_kv_int(w, "id", 100 + ws);
+        jw_kv_string(w, "type", "workspace");
+        jw_kv_int(w, "num", ws);
+        jw_kv_rect(w, "rect", 0, 0, 1920, 1080);
+
+        jw_key(w, "nodes");
+        jw_array_begin(w);
+        for (int i = 0; i < BENCH_WINDOWS; i++) {
+            struct bench_window *win = &windows[i];
+            if (win->workspace != ws) continue;
+
+            jw_object_begin(w);
+            jw_key(w, "id");
+            jw_uint(w, (uintptr_t)win);
+            jw_kv_string(w, "type", win->floating ? "floating_con" : "con");
+            jw_kv_string(w, "name", win->title);
+            jw_kv_string(w, "app_id", win->app_id);
+            jw_kv_bool(w, "focused", i == 0);
+            jw_kv_bool(w, "visible", ws == 1);
+            jw_kv_rect(w, "rect", win->x, win->y, win->width, win->height);
+            jw_kv_rect(w, "window_rect", 0, 24, win->width, win->height - 24);
+            jw_key(w, "nodes");
+            jw_array_begin(w);
+            jw_array_end(w);
+            jw_object_end(w);
+        }
+        jw_array_end(w);
+        jw_object_end(w);
+    }
+    jw_array_end(w);
+    jw_object_end(w);
+}
+
+int main(void) {
+    for (int i = 0; i < BENCH_WINDOWS; i++) {
+        struct bench_window *win = &windows[i];
+        snprintf(win->title, sizeof(win->title), "Terminal %d - \"~/src\"", i);
+        snprintf(win->app_id, sizeof(win->app_id), "app.%d", i % 17);
+        win->workspace = 1 + i % BENCH_WORKSPACES;
+        win->x = (i * 37) % 1920;
+        win->y = (i * 53) % 1080;
+        win->width = 400 + i % 300;
+        win->height = 300 + i % 200;
+        win->floating = (i % 7) == 0;
+    }
+
+    // Both must produce a tree of comparable size for the numbers to mean anything
+    char *reference = tree_jsonc();
+    struct json_writer w = {0};
+    tree_writer(&w);
+    printf("tree: %zu bytes (json-c), %zu bytes (writer)\n", strlen(reference), w.len);
+    free(reference);
+
+    double start = now_ms();
+    size_t total = 0;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        char *json = tree_jsonc();
+        total += strlen(json);
+        free(json);
+    }
+    double jsonc_ms = (now_ms() - start) / BENCH_ITERATIONS;
+
+    start = now_ms();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        tree_writer(&w);
+        total += w.len;
+    }
+    double writer_ms = (now_ms() - start) / BENCH_ITERATIONS;
+
+    printf("json-c: %8.3f ms/tree (object graph + to_string + strdup)\n", jsonc_ms);
+    printf("writer: %8.3f ms/tree (reused buffer, %zu bytes capacity)\n", writer_ms, w.cap);
+    printf("speedup: %.1fx (checksum %zu)\n", jsonc_ms / writer_ms, total);
+
+    jw_free(&w);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Fuzz target for the config parsers
+ *
+ * The first input byte picks the parser and the rest is its input:
+ *   0  toml_parse(), then every value is read back through the accessors
+ *      the config loader uses, keys go through parse_keybind() and string
+ *      values through parse_color()
+ *   1  parse_keybind()
+ *   2  parse_color()
+ *
+ * When the compiler takes -fsanitize=fuzzer (clang, or AFL++'s
+ * afl-clang-fast, which links its own driver) the meson target uses it:
+ *   meson setup build-fuzz -Db_sanitize=address,undefined
+ *   meson compile -C build-fuzz starview-config-fuzz
+ *   ./build-fuzz/starview-config-fuzz -close_fd_mask=2 corpus/
+ * Otherwise it is built with a main() that runs each file argument (or
+ * stdin) once, which is enough to reproduce a crash.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "toml.h"
+
+// Deeper documents are still parsed, just not walked any further
+#define FUZZ_MAX_DEPTH 64
+
+static void walk_table(const toml_table_t *tab, int depth);
+
+static void use_string(toml_datum_t d) {
+    if (!d.ok) return;
+    uint32_t mods, keysym;
+    parse_color(d.u.s);
+    parse_keybind(d.u.s, &mods, &keysym);
+    free(d.u.s);
+}
+
+static void use_timestamp(toml_datum_t d) {
+    if (d.ok) free(d.u.ts);
+}
+
+static void walk_array(const toml_array_t *arr, int depth) {
+    if (depth > FUZZ_MAX_DEPTH) return;
+
+    toml_array_kind(arr);
+    toml_array_type(arr);
+    int n = toml_array_nelem(arr);
+    for (int i = 0; i < n; i++) {
+        use_string(toml_string_at(arr, i));
+        toml_bool_at(arr, i);
+        toml_int_at(arr, i);
+        toml_double_at(arr, i);
+        use_timestamp(toml_timestamp_at(arr, i));
+
+        const toml_array_t *sub = toml_array_at(arr, i);
+        if (sub) walk_array(sub, depth + 1);
+        const toml_table_t *tab = toml_table_at(arr, i);
+        if (tab) walk_table(tab, depth + 1);
+    }
+}
+
+static void walk_table(const toml_table_t *tab, int depth) {
+    if (depth > FUZZ_MAX_DEPTH) return;
+
+    const char *key;
+    for (int i = 0; (key = toml_key_in(tab, i)); i++) {
+        uint32_t mods, keysym;
+        parse_keybind(key, &mods, &keysym);
+
+        toml_key_exists(tab, key);
+        use_string(toml_string_in(tab, key));
+        toml_bool_in(tab, key);
+        toml_int_in(tab, key);
+        toml_double_in(tab, key);
+        use_timestamp(toml_timestamp_in(tab, key));
+
+        const toml_array_t *arr = toml_array_in(tab, key);
+        if (arr) walk_array(arr, depth + 1);
+        const toml_table_t *sub = toml_table_in(tab, key);
+        if (sub) walk_table(sub, depth + 1);
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < 1) return 0;
+
+    // Every parser takes a NUL-terminated string; toml_parse() writes to it
+    char *input = malloc(size);
+    if (!input) return 0;
+    memcpy(input, data + 1, size - 1);
+    input[size - 1] = '\0';
+
+    switch (data[0] % 3) {
+    case 0: {
+        char errbuf[256];
+        toml_table_t *root = toml_parse(input, errbuf, sizeof(errbuf));
+        if (root) {
+            walk_table(root, 0);
+            toml_free(root);
+        }
+        break;
+    }
+    case 1: {
+        uint32_t mods, keysym;
+        parse_keybind(input, &mods, &keysym);
+        break;
+    }
+    case 2:
+        parse_color(input);
+        break;
+    }
+
+    free(input);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+static int run_file(FILE *fp) {
+    size_t size = 0, capacity = 4096;
+    uint8_t *data = malloc(capacity);
+    size_t n;
+    while (data && (n = fread(data + size, 1, capacity - size, fp)) > 0) {
+        size += n;
+        if (size == capacity) {
+            uint8_t *grown = realloc(data, capacity *= 2);
+            if (!grown) break;
+            data = grown;
+        }
+    }
+    if (!data) return 1;
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) return run_file(stdin);
+
+    for (int i = 1; i < argc; i++) {
+        FILE *fp = fopen(argv[i], "rb");
+        if (!fp) {
+            perror(argv[i]);
+            return 1;
+        }
+        int ret = run_file(fp);
+        fclose(fp);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+#endif
@@ -4,9 +4,11 @@
 #include "background.h"
 #include "config.h"
 #include <cairo/cairo.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include <wlr/types/wlr_scene.h>
 #include <wlr/interfaces/wlr_buffer.h>
 #include <drm_fourcc.h>
@@ -99,6 +101,82 @@ static cairo_surface_t *load_image(const char *path) {
     return image;
 }
 
+/*
+ * Decoded wallpaper, shared by every output and kept until the file changes.
+ * Startup decodes it on a worker while the backend comes up, so the first
+ * output doesn't wait on the PNG decoder. The worker only reads the path and
+ * returns the image through pthread_join(), so it never takes the lock.
+ */
+static struct {
+    pthread_mutex_t lock;
+    char path[sizeof(((struct background_config *)0)->image_path)];
+    struct stat st;     // of the file the image was decoded from
+    cairo_surface_t *image;
+    pthread_t thread;
+    bool loading;
+} wallpaper = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void *wallpaper_decode(void *data) {
+    (void)data;
+    return load_image(wallpaper.path);
+}
+
+static bool wallpaper_stat(const char *path, struct stat *st) {
+    if (stat(path, st) == 0) return true;
+    memset(st, 0, sizeof(*st));
+    return false;
+}
+
+static bool wallpaper_current(const char *path) {
+    struct stat st;
+    wallpaper_stat(path, &st);
+    return strcmp(wallpaper.path, path) == 0 && st.st_ino == wallpaper.st.st_ino &&
+           st.st_size == wallpaper.st.st_size &&
+           st.st_mtim.tv_sec == wallpaper.st.st_mtim.tv_sec &&
+           st.st_mtim.tv_nsec == wallpaper.st.st_mtim.tv_nsec;
+}
+
+static void wallpaper_join(void) {
+    if (!wallpaper.loading) return;
+    void *image = NULL;
+    pthread_join(wallpaper.thread, &image);
+    wallpaper.image = image;
+    wallpaper.loading = false;
+}
+
+void background_preload(const struct background_config *bg) {
+    if (!bg || !bg->enabled || bg->image_path[0] == '\0') return;
+
+    pthread_mutex_lock(&wallpaper.lock);
+    if (!wallpaper.loading && !wallpaper_current(bg->image_path)) {
+        if (wallpaper.image) cairo_surface_destroy(wallpaper.image);
+        wallpaper.image = NULL;
+        snprintf(wallpaper.path, sizeof(wallpaper.path), "%s", bg->image_path);
+        wallpaper_stat(wallpaper.path, &wallpaper.st);
+        // Without a thread the first output decodes it instead
+        wallpaper.loading =
+            pthread_create(&wallpaper.thread, NULL, wallpaper_decode, NULL) == 0;
+        if (!wallpaper.loading) wallpaper.path[0] = '\0';
+    }
+    pthread_mutex_unlock(&wallpaper.lock);
+}
+
+// A reference to the decoded image at path, or NULL; waits for a preload
+static cairo_surface_t *wallpaper_get(const char *path) {
+    pthread_mutex_lock(&wallpaper.lock);
+    wallpaper_join();
+    if (!wallpaper.image || !wallpaper_current(path)) {
+        if (wallpaper.image) cairo_surface_destroy(wallpaper.image);
+        snprintf(wallpaper.path, sizeof(wallpaper.path), "%s", path);
+        wallpaper_stat(wallpaper.path, &wallpaper.st);
+        wallpaper.image = load_image(path);
+    }
+    cairo_surface_t *image = wallpaper.image ?
+        cairo_surface_reference(wallpaper.image) : NULL;
+    pthread_mutex_unlock(&wallpaper.lock);
+    return image;
+}
+
 static void draw_image_fill(cairo_t *cr, cairo_surface_t *image, 
                            int width, int height) {
     int img_w = cairo_image_surface_get_width(image);
@@ -170,14 +248,8 @@ static void draw_image_tile(cairo_t *cr, cairo_surface_t *image,
     cairo_pattern_destroy(pattern);
 }
 
-struct wlr_scene_buffer *background_create(struct wlr_scene_tree *parent,
-                                           int width, int height,
-                                           struct background_config *bg) {
-    if (!bg || !parent) return NULL;
-
-    fprintf(stderr, "[BG] Creating background %dx%d, enabled=%d, image_path='%s'\n",
-            width, height, bg->enabled, bg->image_path);
-
+static struct cairo_buffer *background_render(int width, int height,
+                                              struct background_config *bg) {
     struct cairo_buffer *buffer = cairo_buffer_create(width, height);
     if (!buffer) return NULL;
 
@@ -193,10 +265,8 @@ struct wlr_scene_buffer *background_create(struct wlr_scene_tree *parent,
 
     /* Draw image if path exists and is not empty */
     if (bg->image_path[0] != '\0') {
-        fprintf(stderr, "[BG] Image path not empty, attempting load\n");
-        cairo_surface_t *image = load_image(bg->image_path);
+        cairo_surface_t *image = wallpaper_get(bg->image_path);
         if (image) {
-            fprintf(stderr, "[BG] Drawing image with mode %d\n", bg->mode);
             switch (bg->mode) {
             case BG_FILL:
                 draw_image_fill(cr, image, width, height);
@@ -221,12 +291,23 @@ struct wlr_scene_buffer *background_create(struct wlr_scene_tree *parent,
         } else {
             fprintf(stderr, "[BG] Failed to load image\n");
         }
-    } else {
-        fprintf(stderr, "[BG] No image path specified\n");
     }
 
     cairo_destroy(cr);
     cairo_surface_flush(buffer->surface);
+    return buffer;
+}
+
+struct wlr_scene_buffer *background_create(struct wlr_scene_tree *parent,
+                                           int width, int height,
+                                           struct background_config *bg) {
+    if (!bg || !parent) return NULL;
+
+    fprintf(stderr, "[BG] Creating background %dx%d, enabled=%d, image_path='%s'\n",
+            width, height, bg->enabled, bg->image_path);
+
+    struct cairo_buffer *buffer = background_render(width, height, bg);
+    if (!buffer) return NULL;
 
     struct wlr_scene_buffer *scene_buf = wlr_scene_buffer_create(parent, &buffer->base);
     wlr_buffer_drop(&buffer->base);
@@ -244,48 +325,9 @@ void background_update(struct wlr_scene_buffer *scene_buf,
                       struct background_config *bg) {
     if (!scene_buf || !bg) return;
 
-    struct cairo_buffer *buffer = cairo_buffer_create(width, height);
+    struct cairo_buffer *buffer = background_render(width, height, bg);
     if (!buffer) return;
 
-    cairo_t *cr = cairo_create(buffer->surface);
-    
-    cairo_set_source_rgba(cr,
-        ((bg->color >> 24) & 0xff) / 255.0,
-        ((bg->color >> 16) & 0xff) / 255.0,
-        ((bg->color >> 8) & 0xff) / 255.0,
-        (bg->color & 0xff) / 255.0);
-    cairo_paint(cr);
-
-    if (bg->image_path[0] != '\0') {
-        cairo_surface_t *image = load_image(bg->image_path);
-        if (image) {
-            switch (bg->mode) {
-            case BG_FILL:
-                draw_image_fill(cr, image, width, height);
-                break;
-            case BG_FIT:
-                draw_image_fit(cr, image, width, height);
-                break;
-            case BG_CENTER:
-                draw_image_center(cr, image, width, height);
-                break;
-            case BG_STRETCH:
-                draw_image_stretch(cr, image, width, height);
-                break;
-            case BG_TILE:
-                draw_image_tile(cr, image, width, height);
-                break;
-            case BG_COLOR:
-            default:
-                break;
-            }
-            cairo_surface_destroy(image);
-        }
-    }
-
-    cairo_destroy(cr);
-    cairo_surface_flush(buffer->surface);
-
     wlr_scene_buffer_set_buffer(scene_buf, &buffer->base);
     wlr_buffer_drop(&buffer->base);
 }
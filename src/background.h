@@ -17,4 +17,7 @@ void background_update(struct wlr_scene_buffer *scene_buf,
                       int width, int height,
                       struct background_config *bg);
 
+/* Start decoding bg's wallpaper on a worker thread; safe from any thread */
+void background_preload(const struct background_config *bg);
+
 #endif
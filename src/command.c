@@ -0,0 +1,787 @@
+#define _POSIX_C_SOURCE 200809L
+#define WLR_USE_UNSTABLE
+
+#include "core.h"
+#include "config.h"
+#include "config_live.h"
+#include "ipc.h"
+#include <regex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * ============================================================================
+ * Command language
+ * A sway-compatible subset, used by IPC_COMMAND:
+ *
+ *   [criteria] command args, command args; [criteria] command args
+ *
+ * Commands separated by ',' share the criteria in front of them, ';' starts
+ * a new group. Without criteria a command applies to the focused window.
+ * The whole string runs inside one arrange_begin()/arrange_end() pair, so a
+ * script moving twenty windows costs one re-layout, not twenty.
+ * ============================================================================
+ */
+
+#define COMMAND_MAX_ARGS 16
+
+struct criteria {
+    bool present;
+
+    bool has_app_id, has_title, has_mark;
+    bool app_id_focused, title_focused;  // value was __focused__
+    regex_t app_id, title, mark;
+
+    bool has_con_id;
+    uintptr_t con_id;
+    int workspace;  // 0 matches any
+    int floating;   // -1 any, 0 tiled only, 1 floating only
+};
+
+struct command_context {
+    struct server *server;
+    struct criteria *criteria;
+};
+
+// Error replies are formatted here; valid until the next command runs
+static char command_error[256];
+
+static const char *command_fail(const char *fmt, const char *arg) {
+    snprintf(command_error, sizeof(command_error), fmt, arg ? arg : "");
+    return command_error;
+}
+
+/*
+ * ============================================================================
+ * Lexer
+ * Words are copied into a scratch buffer with quotes removed, so the input
+ * string itself is never modified.
+ * ============================================================================
+ */
+
+struct lexer {
+    const char *p;
+    char *out;
+};
+
+static void lex_skip_space(struct lexer *lx) {
+    while (*lx->p == ' ' || *lx->p == '\t' || *lx->p == '\n') lx->p++;
+}
+
+// Next word, or NULL at the end of input or at one of the `stops` characters
+static const char *lex_word(struct lexer *lx, const char *stops) {
+    lex_skip_space(lx);
+    if (*lx->p == '\0' || strchr(stops, *lx->p)) return NULL;
+
+    char *start = lx->out;
+    char quote = 0;
+    while (*lx->p) {
+        char c = *lx->p;
+        if (quote) {
+            lx->p++;
+            if (c == quote) {
+                quote = 0;
+                continue;
+            }
+            if (c == '\\' && *lx->p) c = *lx->p++;
+            *lx->out++ = c;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            quote = c;
+            lx->p++;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\n' || strchr(stops, c)) break;
+        *lx->out++ = c;
+        lx->p++;
+    }
+    *lx->out++ = '\0';
+    return start;
+}
+
+// The rest of the command up to an unquoted stop character, quotes and all
+static const char *lex_raw(struct lexer *lx, const char *stops) {
+    lex_skip_space(lx);
+    const char *start = lx->p;
+    char quote = 0;
+    while (*lx->p) {
+        char c = *lx->p;
+        if (c == '\\' && lx->p[1]) {
+            lx->p += 2;
+            continue;
+        }
+        if (quote) {
+            if (c == quote) quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (strchr(stops, c)) {
+            break;
+        }
+        lx->p++;
+    }
+
+    size_t len = lx->p - start;
+    while (len > 0 && (start[len - 1] == ' ' || start[len - 1] == '\t' ||
+                       start[len - 1] == '\n'))
+        len--;
+    if (len == 0) return NULL;
+
+    char *out = lx->out;
+    memcpy(out, start, len);
+    out[len] = '\0';
+    lx->out += len + 1;
+    return out;
+}
+
+/*
+ * ============================================================================
+ * Criteria
+ * ============================================================================
+ */
+
+static void criteria_finish(struct criteria *criteria) {
+    if (criteria->has_app_id && !criteria->app_id_focused) regfree(&criteria->app_id);
+    if (criteria->has_title && !criteria->title_focused) regfree(&criteria->title);
+    if (criteria->has_mark) regfree(&criteria->mark);
+}
+
+static const char *criteria_regex(regex_t *regex, const char *key, const char *value) {
+    if (regcomp(regex, value, REG_EXTENDED | REG_NOSUB) != 0) {
+        snprintf(command_error, sizeof(command_error),
+                 "Invalid regex for %s: '%s'", key, value);
+        return command_error;
+    }
+    return NULL;
+}
+
+// Parse "[key=value ...]"; the lexer sits on the opening bracket
+static const char *criteria_parse(struct lexer *lx, struct criteria *criteria) {
+    lx->p++;
+    criteria->present = true;
+
+    const char *key;
+    while ((key = lex_word(lx, "=]"))) {
+        const char *value = NULL;
+        lex_skip_space(lx);
+        if (*lx->p == '=') {
+            lx->p++;
+            value = lex_word(lx, "]");
+            if (!value) return command_fail("Missing value for criteria '%s'", key);
+        }
+
+        const char *error = NULL;
+        if (strcmp(key, "floating") == 0 && !value) {
+            criteria->floating = 1;
+        } else if (strcmp(key, "tiling") == 0 && !value) {
+            criteria->floating = 0;
+        } else if (!value) {
+            return command_fail("Unknown criteria '%s'", key);
+        } else if (strcmp(key, "app_id") == 0 && !criteria->has_app_id) {
+            criteria->has_app_id = true;
+            criteria->app_id_focused = strcmp(value, "__focused__") == 0;
+            if (!criteria->app_id_focused) error = criteria_regex(&criteria->app_id, key, value);
+            if (error) criteria->has_app_id = false;
+        } else if (strcmp(key, "title") == 0 && !criteria->has_title) {
+            criteria->has_title = true;
+            criteria->title_focused = strcmp(value, "__focused__") == 0;
+            if (!criteria->title_focused) error = criteria_regex(&criteria->title, key, value);
+            if (error) criteria->has_title = false;
+        } else if (strcmp(key, "con_mark") == 0 && !criteria->has_mark) {
+            error = criteria_regex(&criteria->mark, key, value);
+            criteria->has_mark = !error;
+        } else if (strcmp(key, "con_id") == 0) {
+            char *end;
+            criteria->con_id = strtoull(value, &end, 10);
+            criteria->has_con_id = true;
+            if (*end) error = command_fail("Invalid con_id '%s'", value);
+        } else if (strcmp(key, "workspace") == 0) {
+            criteria->workspace = atoi(value);
+            if (criteria->workspace < 1 || criteria->workspace > MAX_WORKSPACES)
+                error = command_fail("Invalid workspace '%s'", value);
+        } else {
+            error = command_fail("Unknown criteria '%s'", key);
+        }
+        if (error) return error;
+    }
+
+    if (*lx->p != ']') return command_fail("Unterminated criteria%s", NULL);
+    lx->p++;
+    return NULL;
+}
+
+static bool criteria_string(bool focused_match, regex_t *regex, const char *value,
+                            const char *focused_value) {
+    if (focused_match) {
+        return focused_value && value && strcmp(value, focused_value) == 0;
+    }
+    return regexec(regex, value ? value : "", 0, NULL, 0) == 0;
+}
+
+static bool criteria_match(struct criteria *criteria, struct toplevel *toplevel,
+                           struct toplevel *focused) {
+    struct wlr_xdg_toplevel *xdg = toplevel->xdg_toplevel;
+
+    if (criteria->has_con_id && (uintptr_t)toplevel != criteria->con_id) return false;
+    if (criteria->workspace && toplevel->workspace != criteria->workspace) return false;
+    if (criteria->floating >= 0 && toplevel->floating != (criteria->floating == 1)) return false;
+
+    if (criteria->has_app_id &&
+        !criteria_string(criteria->app_id_focused, &criteria->app_id, xdg->app_id,
+                         focused ? focused->xdg_toplevel->app_id : NULL)) {
+        return false;
+    }
+    if (criteria->has_title &&
+        !criteria_string(criteria->title_focused, &criteria->title, xdg->title,
+                         focused ? focused->xdg_toplevel->title : NULL)) {
+        return false;
+    }
+    if (criteria->has_mark) {
+        bool any = false;
+        for (int i = 0; i < toplevel->mark_count && !any; i++) {
+            any = regexec(&criteria->mark, toplevel->marks[i], 0, NULL, 0) == 0;
+        }
+        if (!any) return false;
+    }
+    return true;
+}
+
+// Matched windows are snapshotted first since actions reorder the list
+static struct {
+    struct toplevel **items;
+    int count;
+    int capacity;
+} targets;
+
+static void targets_push(struct toplevel *toplevel) {
+    if (targets.count == targets.capacity) {
+        int capacity = targets.capacity ? targets.capacity * 2 : 16;
+        struct toplevel **items = realloc(targets.items, capacity * sizeof(*items));
+        if (!items) return;
+        targets.items = items;
+        targets.capacity = capacity;
+    }
+    targets.items[targets.count++] = toplevel;
+}
+
+static int targets_collect(struct command_context *ctx) {
+    struct toplevel *focused = get_focused_toplevel(ctx->server);
+    targets.count = 0;
+
+    if (!ctx->criteria->present) {
+        if (focused) targets_push(focused);
+        return targets.count;
+    }
+
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &ctx->server->toplevels, link) {
+        if (criteria_match(ctx->criteria, toplevel, focused)) targets_push(toplevel);
+    }
+    return targets.count;
+}
+
+/*
+ * ============================================================================
+ * Marks
+ * ============================================================================
+ */
+
+static int toplevel_find_mark(struct toplevel *toplevel, const char *mark) {
+    for (int i = 0; i < toplevel->mark_count; i++) {
+        if (strcmp(toplevel->marks[i], mark) == 0) return i;
+    }
+    return -1;
+}
+
+static void toplevel_remove_mark(struct toplevel *toplevel, int index) {
+    free(toplevel->marks[index]);
+    toplevel->marks[index] = toplevel->marks[--toplevel->mark_count];
+    ipc_tree_mark_dirty(toplevel->server, toplevel);
+}
+
+static void toplevel_clear_marks(struct toplevel *toplevel) {
+    while (toplevel->mark_count > 0) toplevel_remove_mark(toplevel, 0);
+}
+
+static bool toplevel_add_mark(struct toplevel *toplevel, const char *mark) {
+    // Marks are unique, so take it away from whoever had it
+    struct toplevel *other;
+    wl_list_for_each(other, &toplevel->server->toplevels, link) {
+        int index = toplevel_find_mark(other, mark);
+        if (index >= 0) toplevel_remove_mark(other, index);
+    }
+
+    char **marks = realloc(toplevel->marks, (toplevel->mark_count + 1) * sizeof(*marks));
+    if (!marks) return false;
+    toplevel->marks = marks;
+
+    char *copy = strdup(mark);
+    if (!copy) return false;
+    toplevel->marks[toplevel->mark_count++] = copy;
+    ipc_tree_mark_dirty(toplevel->server, toplevel);
+    return true;
+}
+
+void command_toplevel_destroy(struct toplevel *toplevel) {
+    for (int i = 0; i < toplevel->mark_count; i++) free(toplevel->marks[i]);
+    free(toplevel->marks);
+    toplevel->marks = NULL;
+    toplevel->mark_count = 0;
+}
+
+/*
+ * ============================================================================
+ * Commands
+ * Each returns NULL on success or an error message for the reply.
+ * ============================================================================
+ */
+
+static bool toplevel_is_floating(struct toplevel *toplevel) {
+    return toplevel->server->mode == MODE_FLOATING || toplevel->floating;
+}
+
+// Checked before acting, so a failing command leaves every target untouched
+static bool targets_all_floating(int count) {
+    for (int i = 0; i < count; i++) {
+        if (!toplevel_is_floating(targets.items[i])) return false;
+    }
+    return true;
+}
+
+static struct wlr_scene_node *toplevel_node(struct toplevel *toplevel) {
+    return toplevel->decor.tree ? &toplevel->decor.tree->node : &toplevel->scene_tree->node;
+}
+
+// "N", "N px" or nothing; `*index` is advanced past what was consumed
+static int parse_amount(int argc, const char **argv, int *index, int fallback) {
+    if (*index >= argc) return fallback;
+
+    char *end;
+    long value = strtol(argv[*index], &end, 10);
+    if (end == argv[*index] || (*end && strcmp(end, "px") != 0)) return fallback;
+    (*index)++;
+    if (*index < argc && strcmp(argv[*index], "px") == 0) (*index)++;
+    return (int)value;
+}
+
+static int parse_workspace(struct server *server, int argc, const char **argv, int index) {
+    if (index < argc && strcmp(argv[index], "number") == 0) index++;
+    if (index >= argc) return 0;
+
+    const char *name = argv[index];
+    if (strcmp(name, "next") == 0) {
+        return server->current_workspace % MAX_WORKSPACES + 1;
+    }
+    if (strcmp(name, "prev") == 0) {
+        return server->current_workspace > 1 ? server->current_workspace - 1 : MAX_WORKSPACES;
+    }
+
+    int ws = atoi(name);
+    return ws >= 1 && ws <= MAX_WORKSPACES ? ws : 0;
+}
+
+static enum keybind_action parse_direction(const char *dir, enum keybind_action left) {
+    // The four directional actions are declared left, right, up, down
+    static const char *const names[] = { "left", "right", "up", "down" };
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(dir, names[i]) == 0) return left + i;
+    }
+    return ACTION_NONE;
+}
+
+static const char *cmd_focus(struct command_context *ctx, int argc, const char **argv) {
+    struct server *server = ctx->server;
+
+    if (argc == 1) {
+        if (!ctx->criteria->present) return "focus needs a direction or criteria";
+        if (!targets_collect(ctx)) return "No matching window";
+
+        struct toplevel *toplevel = targets.items[0];
+        if (toplevel->workspace != server->current_workspace) {
+            workspace_show(server, toplevel->workspace);
+        }
+        focus_toplevel(toplevel);
+        return NULL;
+    }
+
+    enum keybind_action action = parse_direction(argv[1], ACTION_FOCUS_LEFT);
+    if (strcmp(argv[1], "next") == 0) action = ACTION_FOCUS_NEXT;
+    if (strcmp(argv[1], "prev") == 0) action = ACTION_FOCUS_PREV;
+    if (action == ACTION_NONE) return command_fail("Unknown focus target '%s'", argv[1]);
+
+    struct toplevel *origin = targets_collect(ctx) ? targets.items[0] : NULL;
+    handle_action(server, origin, action, "");
+    return NULL;
+}
+
+static const char *cmd_move(struct command_context *ctx, int argc, const char **argv) {
+    struct server *server = ctx->server;
+    if (argc < 2) return "Expected 'move <direction|workspace|position>'";
+
+    int index = 1;
+    if (strcmp(argv[index], "container") == 0 || strcmp(argv[index], "window") == 0) index++;
+    if (index < argc && strcmp(argv[index], "to") == 0) index++;
+    if (index >= argc) return "Expected 'move <direction|workspace|position>'";
+
+    const char *what = argv[index++];
+    int count = targets_collect(ctx);
+
+    enum keybind_action action = parse_direction(what, ACTION_MOVE_LEFT);
+    if (action != ACTION_NONE) {
+        int amount = parse_amount(argc, argv, &index, 0);
+        for (int i = 0; i < count; i++) {
+            struct toplevel *toplevel = targets.items[i];
+            if (amount > 0 && toplevel_is_floating(toplevel)) {
+                struct wlr_scene_node *node = toplevel_node(toplevel);
+                int dx = action == ACTION_MOVE_LEFT ? -amount : action == ACTION_MOVE_RIGHT ? amount : 0;
+                int dy = action == ACTION_MOVE_UP ? -amount : action == ACTION_MOVE_DOWN ? amount : 0;
+                wlr_scene_node_set_position(node, node->x + dx, node->y + dy);
+            } else {
+                handle_action(server, toplevel, action, "");
+            }
+        }
+        return NULL;
+    }
+
+    if (strcmp(what, "workspace") == 0) {
+        int ws = parse_workspace(server, argc, argv, index);
+        if (!ws) return "Expected 'move workspace <1-10|next|prev>'";
+        for (int i = 0; i < count; i++) {
+            workspace_move_toplevel(targets.items[i], ws);
+            ipc_tree_mark_dirty(server, targets.items[i]);
+        }
+        arrange_windows(server);
+        return NULL;
+    }
+
+    if (strcmp(what, "position") == 0) {
+        bool center = index < argc && strcmp(argv[index], "center") == 0;
+        int x = 0, y = 0;
+        if (!center) {
+            int before = index;
+            x = parse_amount(argc, argv, &index, 0);
+            if (index == before) return "Expected 'move position <x> <y>|center'";
+            before = index;
+            y = parse_amount(argc, argv, &index, 0);
+            if (index == before) return "Expected 'move position <x> <y>|center'";
+        }
+
+        if (!targets_all_floating(count)) return "Only floating windows can be positioned";
+        for (int i = 0; i < count; i++) {
+            struct toplevel *toplevel = targets.items[i];
+            if (center) {
+                handle_action(server, toplevel, ACTION_CENTER_WINDOW, "");
+            } else {
+                wlr_scene_node_set_position(toplevel_node(toplevel), x, y);
+            }
+        }
+        return NULL;
+    }
+
+    return command_fail("Unknown move target '%s'", what);
+}
+
+static const char *cmd_resize(struct command_context *ctx, int argc, const char **argv) {
+    struct server *server = ctx->server;
+    if (argc < 3) return "Expected 'resize <grow|shrink|set> ...'";
+
+    int count = targets_collect(ctx);
+    int index = 2;
+
+    if (strcmp(argv[1], "set") == 0) {
+        index = 2;
+        if (index < argc && strcmp(argv[index], "width") == 0) index++;
+        int width = parse_amount(argc, argv, &index, 0);
+        if (index < argc && strcmp(argv[index], "height") == 0) index++;
+        int height = parse_amount(argc, argv, &index, 0);
+        if (width <= 0 || height <= 0) return "Expected 'resize set <width> <height>'";
+
+        if (!targets_all_floating(count)) return "Only floating windows can be sized";
+        for (int i = 0; i < count; i++) {
+            wlr_xdg_toplevel_set_size(targets.items[i]->xdg_toplevel, width, height);
+        }
+        return NULL;
+    }
+
+    bool grow = strcmp(argv[1], "grow") == 0;
+    if (!grow && strcmp(argv[1], "shrink") != 0) {
+        return command_fail("Unknown resize mode '%s'", argv[1]);
+    }
+
+    const char *dim = argv[2];
+    bool horizontal = strcmp(dim, "width") == 0 || strcmp(dim, "left") == 0 ||
+                      strcmp(dim, "right") == 0 || strcmp(dim, "horizontal") == 0;
+    bool vertical = strcmp(dim, "height") == 0 || strcmp(dim, "up") == 0 ||
+                    strcmp(dim, "down") == 0 || strcmp(dim, "vertical") == 0;
+    if (!horizontal && !vertical) return command_fail("Unknown resize dimension '%s'", dim);
+
+    index = 3;
+    int amount = parse_amount(argc, argv, &index, config.resize_step);
+    if (!grow) amount = -amount;
+
+    for (int i = 0; i < count; i++) {
+        struct toplevel *toplevel = targets.items[i];
+        if (toplevel_is_floating(toplevel)) {
+            struct wlr_box geo;
+            wlr_xdg_surface_get_geometry(toplevel->xdg_toplevel->base, &geo);
+            int w = geo.width + (horizontal ? amount : 0);
+            int h = geo.height + (vertical ? amount : 0);
+            if (w < 100) w = 100;
+            if (h < 100) h = 100;
+            wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, w, h);
+        } else if (horizontal) {
+            // The master/stack layout only has one tunable split
+            handle_action(server, toplevel, grow ? ACTION_INC_MASTER_RATIO : ACTION_DEC_MASTER_RATIO, "");
+        } else {
+            return "Tiled windows can only be resized horizontally";
+        }
+    }
+    return NULL;
+}
+
+static const char *cmd_layout(struct command_context *ctx, int argc, const char **argv) {
+    if (argc < 2) return "Expected 'layout <tiling|floating|toggle>'";
+
+    enum keybind_action action;
+    if (strcmp(argv[1], "tiling") == 0) {
+        action = ACTION_MODE_TILING;
+    } else if (strcmp(argv[1], "floating") == 0) {
+        action = ACTION_MODE_FLOATING;
+    } else if (strcmp(argv[1], "toggle") == 0) {
+        action = ACTION_TOGGLE_MODE;
+    } else {
+        return command_fail("Unsupported layout '%s'", argv[1]);
+    }
+    handle_action(ctx->server, NULL, action, "");
+    return NULL;
+}
+
+// "enable", "disable" or "toggle"; -1 if none of them
+static int parse_toggle(int argc, const char **argv, bool current) {
+    if (argc < 2 || strcmp(argv[1], "toggle") == 0) return !current;
+    if (strcmp(argv[1], "enable") == 0) return 1;
+    if (strcmp(argv[1], "disable") == 0) return 0;
+    return -1;
+}
+
+static const char *cmd_floating(struct command_context *ctx, int argc, const char **argv) {
+    int count = targets_collect(ctx);
+    for (int i = 0; i < count; i++) {
+        struct toplevel *toplevel = targets.items[i];
+        int want = parse_toggle(argc, argv, toplevel->floating);
+        if (want < 0) return "Expected 'floating <enable|disable|toggle>'";
+        if (want != toplevel->floating) {
+            handle_action(ctx->server, toplevel, ACTION_TOGGLE_FLOATING, "");
+        }
+    }
+    return NULL;
+}
+
+static const char *cmd_fullscreen(struct command_context *ctx, int argc, const char **argv) {
+    int count = targets_collect(ctx);
+    for (int i = 0; i < count; i++) {
+        struct toplevel *toplevel = targets.items[i];
+        int want = parse_toggle(argc, argv, toplevel->fullscreen);
+        if (want < 0) return "Expected 'fullscreen <enable|disable|toggle>'";
+        if (want != toplevel->fullscreen) {
+            handle_action(ctx->server, toplevel, ACTION_FULLSCREEN, "");
+        }
+    }
+    return NULL;
+}
+
+static const char *cmd_mark(struct command_context *ctx, int argc, const char **argv) {
+    bool add = false, toggle = false;
+    const char *mark = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--add") == 0) add = true;
+        else if (strcmp(argv[i], "--replace") == 0) add = false;
+        else if (strcmp(argv[i], "--toggle") == 0) toggle = true;
+        else mark = argv[i];
+    }
+    if (!mark) return "Expected 'mark [--add|--replace] [--toggle] <identifier>'";
+
+    if (targets_collect(ctx) != 1) {
+        return targets.count ? "Only one window can be marked" : "No matching window";
+    }
+
+    struct toplevel *toplevel = targets.items[0];
+    int index = toplevel_find_mark(toplevel, mark);
+    if (toggle && index >= 0) {
+        toplevel_remove_mark(toplevel, index);
+        return NULL;
+    }
+    if (!add) toplevel_clear_marks(toplevel);
+    if (!toplevel_add_mark(toplevel, mark)) return "Out of memory";
+    return NULL;
+}
+
+static const char *cmd_unmark(struct command_context *ctx, int argc, const char **argv) {
+    const char *mark = argc > 1 ? argv[1] : NULL;
+
+    // Without criteria, sway removes the mark wherever it is
+    targets.count = 0;
+    if (ctx->criteria->present) {
+        targets_collect(ctx);
+    } else {
+        struct toplevel *toplevel;
+        wl_list_for_each(toplevel, &ctx->server->toplevels, link) targets_push(toplevel);
+    }
+
+    for (int i = 0; i < targets.count; i++) {
+        struct toplevel *toplevel = targets.items[i];
+        if (!mark) {
+            toplevel_clear_marks(toplevel);
+            continue;
+        }
+        int index = toplevel_find_mark(toplevel, mark);
+        if (index >= 0) toplevel_remove_mark(toplevel, index);
+    }
+    return NULL;
+}
+
+static const char *cmd_workspace(struct command_context *ctx, int argc, const char **argv) {
+    int ws = parse_workspace(ctx->server, argc, argv, 1);
+    if (!ws) return "Expected 'workspace <1-10|next|prev>'";
+    workspace_show(ctx->server, ws);
+    return NULL;
+}
+
+static const char *cmd_kill(struct command_context *ctx, int argc, const char **argv) {
+    (void)argc;
+    (void)argv;
+    int count = targets_collect(ctx);
+    for (int i = 0; i < count; i++) {
+        wlr_xdg_toplevel_send_close(targets.items[i]->xdg_toplevel);
+    }
+    return NULL;
+}
+
+// argv[1] is the unlexed rest of the command, passed to the shell as written
+static const char *cmd_exec(struct command_context *ctx, int argc, const char **argv) {
+    if (argc < 2) return "Expected 'exec <command>'";
+    handle_action(ctx->server, NULL, ACTION_SPAWN, argv[1]);
+    return NULL;
+}
+
+static const char *cmd_reload(struct command_context *ctx, int argc, const char **argv) {
+    (void)argc;
+    (void)argv;
+    uint32_t changed;
+    if (config_reload(&changed) < 0)
+        return "Config reload failed, keeping the running config";
+    config_apply_live(ctx->server, changed);
+    return NULL;
+}
+
+static const char *cmd_exit(struct command_context *ctx, int argc, const char **argv) {
+    (void)argc;
+    (void)argv;
+    wl_display_terminate(ctx->server->display);
+    return NULL;
+}
+
+static const char *cmd_nop(struct command_context *ctx, int argc, const char **argv) {
+    (void)ctx;
+    (void)argc;
+    (void)argv;
+    return NULL;
+}
+
+static const struct {
+    const char *name;
+    const char *(*run)(struct command_context *ctx, int argc, const char **argv);
+} commands[] = {
+    { "exec", cmd_exec },
+    { "exit", cmd_exit },
+    { "floating", cmd_floating },
+    { "focus", cmd_focus },
+    { "fullscreen", cmd_fullscreen },
+    { "kill", cmd_kill },
+    { "layout", cmd_layout },
+    { "mark", cmd_mark },
+    { "move", cmd_move },
+    { "nop", cmd_nop },
+    { "reload", cmd_reload },
+    { "resize", cmd_resize },
+    { "unmark", cmd_unmark },
+    { "workspace", cmd_workspace },
+};
+
+static const char *command_run(struct command_context *ctx, int argc, const char **argv) {
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strcmp(argv[0], commands[i].name) == 0) return commands[i].run(ctx, argc, argv);
+    }
+    return command_fail("Unknown command '%s'", argv[0]);
+}
+
+void command_execute(struct server *server, const char *input,
+                     void (*report)(void *data, bool success, const char *error),
+                     void *data) {
+    // Unquoted words never outgrow their source, plus a NUL each
+    size_t len = strlen(input);
+    char *words = malloc(len * 2 + 2);
+    if (!words) {
+        report(data, false, "Out of memory");
+        return;
+    }
+
+    struct lexer lx = { .p = input, .out = words };
+    arrange_begin(server);
+
+    for (;;) {
+        lex_skip_space(&lx);
+        if (*lx.p == '\0') break;
+
+        struct criteria criteria = { .floating = -1 };
+        struct command_context ctx = { .server = server, .criteria = &criteria };
+
+        if (*lx.p == '[') {
+            const char *error = criteria_parse(&lx, &criteria);
+            if (error) {
+                report(data, false, error);
+                criteria_finish(&criteria);
+                while (*lx.p && *lx.p != ';') lx.p++;
+                if (*lx.p) lx.p++;
+                continue;
+            }
+        }
+
+        for (;;) {
+            const char *argv[COMMAND_MAX_ARGS];
+            int argc = 0;
+            const char *word;
+            bool overflow = false;
+            while ((word = lex_word(&lx, ",;"))) {
+                if (argc < COMMAND_MAX_ARGS) argv[argc++] = word;
+                else overflow = true;
+
+                // Like sway, exec hands its quoting and escapes to the shell
+                if (argc == 1 && strcmp(word, "exec") == 0) {
+                    if ((word = lex_raw(&lx, ",;"))) argv[argc++] = word;
+                    break;
+                }
+            }
+
+            if (overflow) {
+                report(data, false, "Too many arguments");
+            } else if (argc > 0) {
+                const char *error = command_run(&ctx, argc, argv);
+                report(data, !error, error);
+            }
+
+            lx.out = words;
+            if (*lx.p == ',') {
+                lx.p++;
+                continue;
+            }
+            if (*lx.p == ';') lx.p++;
+            break;
+        }
+        criteria_finish(&criteria);
+    }
+
+    arrange_end(server);
+    free(words);
+}
@@ -2,16 +2,21 @@
 #define WLR_USE_UNSTABLE
 
 #include "config.h"
+#include "config_cache.h"
 #include "gesture.h"
 #include "gesture_config.h"
 #include "toml.h"
 #include <dirent.h>
+#include <pthread.h>
+#include <stdarg.h>
 #include <linux/input-event-codes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <xkbcommon/xkbcommon.h>
 struct config config = {
@@ -21,9 +26,21 @@ struct config config = {
     .border_color_active = 0x89b4faff,
     .border_color_inactive = 0x45475aff,
     .focus_follows_mouse = true,
+    .auto_reload = true,
     .default_mode = MODE_TILING,
     .resize_step = 50,
     .move_step = 50,
+    .keyboard =
+        {
+            .repeat_rate = 25,
+            .repeat_delay = 600,
+        },
+    .xwayland =
+        {
+            .enabled = true,
+            .lazy = true,
+            .idle_timeout = 10,
+        },
     .master_ratio = 0.55f,
     .master_count = 1,
     .keybind_count = 0,
@@ -75,6 +92,185 @@ struct config config = {
 static char config_path[512] = {0};
 static int include_depth = 0;
 
+/*
+ * The parse_* helpers fill in cfg, which is the live config during the
+ * first load and a private copy during reloads. Reloads may parse on a
+ * worker thread, so parses are serialized by parse_lock.
+ */
+static struct config *cfg = &config;
+static pthread_mutex_t parse_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Problems with the config being parsed. A parse that reported any is not
+ * cached, since a cache hit would replay none of them.
+ */
+static int parse_warnings = 0;
+
+static void config_warn(const char *fmt, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void config_warn(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  parse_warnings++;
+}
+
+/*
+ * STRING POOL
+ * Interned strings live in chunks that never move, so table entries point
+ * straight at them. Repeats (the same spawn command on several keys, the
+ * same pattern in several rules) are stored once.
+ */
+struct string_chunk {
+  struct string_chunk *next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+struct string_pool {
+  struct string_chunk *chunks;
+  const char **set; // open-addressed, NULL marks an empty slot
+  uint32_t set_mask;
+  uint32_t count;
+};
+
+#define STRING_CHUNK_MIN 4096
+#define STRING_CHUNK_MAX (1 << 20)
+
+static uint32_t string_hash(const char *str, size_t len) {
+  uint32_t h = 2166136261u; // FNV-1a
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ (uint8_t)str[i]) * 16777619u;
+  return h;
+}
+
+static void string_pool_free(struct string_pool *pool) {
+  if (!pool)
+    return;
+  struct string_chunk *chunk = pool->chunks;
+  while (chunk) {
+    struct string_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(pool->set);
+  free(pool);
+}
+
+static bool string_set_grow(struct string_pool *pool) {
+  uint32_t size = pool->set ? (pool->set_mask + 1) * 2 : 64;
+  const char **set = calloc(size, sizeof(*set));
+  if (!set)
+    return false;
+
+  if (pool->set) {
+    for (uint32_t i = 0; i <= pool->set_mask; i++) {
+      const char *str = pool->set[i];
+      if (!str)
+        continue;
+      uint32_t slot = string_hash(str, strlen(str)) & (size - 1);
+      while (set[slot])
+        slot = (slot + 1) & (size - 1);
+      set[slot] = str;
+    }
+  }
+  free(pool->set);
+  pool->set = set;
+  pool->set_mask = size - 1;
+  return true;
+}
+
+const char *config_intern(struct config *c, const char *str, size_t len) {
+  struct string_pool *pool = c->strings;
+  if (!pool && !(pool = c->strings = calloc(1, sizeof(*pool))))
+    return NULL;
+
+  // Keep the set at most half full
+  if ((!pool->set || (pool->count + 1) * 2 > pool->set_mask + 1) &&
+      !string_set_grow(pool))
+    return NULL;
+
+  uint32_t slot = string_hash(str, len) & pool->set_mask;
+  for (; pool->set[slot]; slot = (slot + 1) & pool->set_mask) {
+    const char *other = pool->set[slot];
+    if (strncmp(other, str, len) == 0 && other[len] == '\0')
+      return other;
+  }
+
+  struct string_chunk *chunk = pool->chunks;
+  if (!chunk || chunk->size - chunk->used < len + 1) {
+    size_t size = chunk ? chunk->size * 2 : STRING_CHUNK_MIN;
+    if (size > STRING_CHUNK_MAX)
+      size = STRING_CHUNK_MAX;
+    while (size < len + 1)
+      size *= 2;
+    if (!(chunk = malloc(sizeof(*chunk) + size)))
+      return NULL;
+    chunk->used = 0;
+    chunk->size = size;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+  }
+
+  char *copy = chunk->data + chunk->used;
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  chunk->used += len + 1;
+
+  pool->set[slot] = copy;
+  pool->count++;
+  return copy;
+}
+
+// Intern into the config being parsed; "" rather than NULL if memory ran out
+static const char *intern(const char *str) {
+  const char *copy = config_intern(cfg, str, strlen(str));
+  if (!copy) {
+    config_warn("Config: out of memory interning \"%s\"\n", str);
+    return "";
+  }
+  return copy;
+}
+
+/*
+ * Grow a table to hold at least `needed` entries. Capacity doubles, so
+ * appending one entry at a time stays linear; callers that know the count
+ * up front (a TOML array) reserve it in one go.
+ */
+static bool table_reserve(void **items, int *capacity, int needed,
+                          size_t size) {
+  if (needed <= *capacity)
+    return true;
+
+  int grown_capacity = *capacity ? *capacity : 8;
+  while (grown_capacity < needed)
+    grown_capacity *= 2;
+
+  void *grown = realloc(*items, (size_t)grown_capacity * size);
+  if (!grown) {
+    config_warn("Config: out of memory growing a table to %d entries\n",
+                needed);
+    return false;
+  }
+  *items = grown;
+  *capacity = grown_capacity;
+  return true;
+}
+
+#define TABLE_RESERVE(items, capacity, needed)                                 \
+  table_reserve((void **)&(items), &(capacity), (needed), sizeof(*(items)))
+
+// Copy into a fixed-size field, loudly rather than silently cutting it short
+static void copy_string(char *dst, size_t size, const char *src,
+                        const char *what) {
+  if (snprintf(dst, size, "%s", src) >= (int)size)
+    config_warn("Config: %s is longer than %zu bytes and was truncated: %s\n",
+                what, size - 1, src);
+}
+
 /*
  * ACTION STRING MAP
  */
@@ -129,6 +325,8 @@ static struct {
                   {"swap_right", ACTION_SWAP_RIGHT},
                   {"swap_up", ACTION_SWAP_UP},
                   {"swap_down", ACTION_SWAP_DOWN},
+                  {"mode", ACTION_BINDING_MODE},
+                  {"layout_next", ACTION_LAYOUT_NEXT},
                   {NULL, ACTION_NONE}};
 
 static enum gesture_direction parse_gesture_direction(const char *str) {
@@ -217,13 +415,13 @@ static void parse_background(toml_table_t *bg_table) {
 
   if (!bg_table) {
     // Only set defaults if background hasn't been configured yet
-    if (config.background.image_path[0] == '\0') {
+    if (cfg->background.image_path[0] == '\0') {
       fprintf(stderr, "[CONFIG] No [background] section, using defaults (first "
                       "time only)\n");
-      config.background.enabled = true;
-      config.background.color = 0x1e1e2eff;
-      config.background.image_path[0] = '\0';
-      config.background.mode = BG_FILL;
+      cfg->background.enabled = true;
+      cfg->background.color = 0x1e1e2eff;
+      cfg->background.image_path[0] = '\0';
+      cfg->background.mode = BG_FILL;
     } else {
       fprintf(stderr,
               "[CONFIG] No [background] section, keeping existing config\n");
@@ -235,26 +433,24 @@ static void parse_background(toml_table_t *bg_table) {
 
   v = toml_bool_in(bg_table, "enabled");
   if (v.ok) {
-    config.background.enabled = v.u.b;
+    cfg->background.enabled = v.u.b;
     fprintf(stderr, "[CONFIG] background.enabled = %d\n", v.u.b);
   }
 
   v = toml_string_in(bg_table, "color");
   if (v.ok) {
-    config.background.color = parse_color(v.u.s);
+    cfg->background.color = parse_color(v.u.s);
     fprintf(stderr, "[CONFIG] background.color = %s -> 0x%08x\n", v.u.s,
-            config.background.color);
+            cfg->background.color);
     free(v.u.s);
   }
 
   v = toml_string_in(bg_table, "image");
   if (v.ok) {
-    strncpy(config.background.image_path, v.u.s,
-            sizeof(config.background.image_path) - 1);
-    config.background.image_path[sizeof(config.background.image_path) - 1] =
-        '\0';
+    copy_string(cfg->background.image_path,
+                sizeof(cfg->background.image_path), v.u.s, "background.image");
     fprintf(stderr, "[CONFIG] background.image = '%s'\n",
-            config.background.image_path);
+            cfg->background.image_path);
     free(v.u.s);
   } else {
     fprintf(stderr, "[CONFIG] No background.image in config\n");
@@ -262,25 +458,28 @@ static void parse_background(toml_table_t *bg_table) {
 
   v = toml_string_in(bg_table, "mode");
   if (v.ok) {
-    config.background.mode = parse_bg_mode(v.u.s);
+    cfg->background.mode = parse_bg_mode(v.u.s);
     fprintf(stderr, "[CONFIG] background.mode = %s (%d)\n", v.u.s,
-            config.background.mode);
+            cfg->background.mode);
     free(v.u.s);
   }
 
   fprintf(stderr,
           "[CONFIG] Final background: enabled=%d, path='%s', mode=%d, "
           "color=0x%08x\n",
-          config.background.enabled, config.background.image_path,
-          config.background.mode, config.background.color);
+          cfg->background.enabled, cfg->background.image_path,
+          cfg->background.mode, cfg->background.color);
 }
 
 static void parse_gesture_touchpad(toml_array_t *arr) {
   if (!arr)
     return;
 
+  // Several files may each add gestures
   int len = toml_array_nelem(arr);
-  config.gesture_touchpad = calloc(len, sizeof(struct gesture_touchpad));
+  if (!TABLE_RESERVE(cfg->gesture_touchpad, cfg->gesture_touchpad_capacity,
+                     cfg->gesture_touchpad_count + len))
+    return;
 
   for (int i = 0; i < len; i++) {
     toml_table_t *g = toml_table_at(arr, i);
@@ -288,7 +487,9 @@ static void parse_gesture_touchpad(toml_array_t *arr) {
       continue;
 
     struct gesture_touchpad *gt =
-        &config.gesture_touchpad[config.gesture_touchpad_count];
+        &cfg->gesture_touchpad[cfg->gesture_touchpad_count];
+    memset(gt, 0, sizeof(*gt));
+    gt->action.arg = "";
 
     toml_datum_t v;
 
@@ -313,7 +514,7 @@ static void parse_gesture_touchpad(toml_array_t *arr) {
         strncpy(action_str, v.u.s, len);
         action_str[len] = '\0';
         gt->action.type = parse_gesture_action_type(action_str);
-        strncpy(gt->action.arg, space + 1, sizeof(gt->action.arg) - 1);
+        gt->action.arg = intern(space + 1);
       } else {
         gt->action.type = parse_gesture_action_type(v.u.s);
       }
@@ -322,7 +523,7 @@ static void parse_gesture_touchpad(toml_array_t *arr) {
 
     if (gt->fingers > 0 && gt->direction != GESTURE_DIR_NONE &&
         gt->action.type != GESTURE_ACTION_NONE) {
-      config.gesture_touchpad_count++;
+      cfg->gesture_touchpad_count++;
     }
   }
 }
@@ -331,8 +532,11 @@ static void parse_gesture_mouse(toml_array_t *arr) {
   if (!arr)
     return;
 
+  // Several files may each add gestures
   int len = toml_array_nelem(arr);
-  config.gesture_mouse = calloc(len, sizeof(struct gesture_mouse));
+  if (!TABLE_RESERVE(cfg->gesture_mouse, cfg->gesture_mouse_capacity,
+                     cfg->gesture_mouse_count + len))
+    return;
 
   for (int i = 0; i < len; i++) {
     toml_table_t *g = toml_table_at(arr, i);
@@ -340,7 +544,9 @@ static void parse_gesture_mouse(toml_array_t *arr) {
       continue;
 
     struct gesture_mouse *gm =
-        &config.gesture_mouse[config.gesture_mouse_count];
+        &cfg->gesture_mouse[cfg->gesture_mouse_count];
+    memset(gm, 0, sizeof(*gm));
+    gm->action.arg = "";
 
     toml_datum_t v;
 
@@ -380,7 +586,7 @@ static void parse_gesture_mouse(toml_array_t *arr) {
         strncpy(action_str, v.u.s, len);
         action_str[len] = '\0';
         gm->action.type = parse_gesture_action_type(action_str);
-        strncpy(gm->action.arg, space + 1, sizeof(gm->action.arg) - 1);
+        gm->action.arg = intern(space + 1);
       } else {
         gm->action.type = parse_gesture_action_type(v.u.s);
       }
@@ -389,15 +595,17 @@ static void parse_gesture_mouse(toml_array_t *arr) {
 
     if (gm->button > 0 && gm->direction != GESTURE_DIR_NONE &&
         gm->action.type != GESTURE_ACTION_NONE) {
-      config.gesture_mouse_count++;
+      cfg->gesture_mouse_count++;
     }
   }
 }
 
-static enum keybind_action parse_action(const char *str, char *arg_out) {
-  arg_out[0] = '\0';
-
+// *arg_out points into str: past the first space, or at its terminator
+static enum keybind_action parse_action(const char *str,
+                                        const char **arg_out) {
   const char *space = strchr(str, ' ');
+  const char *arg_str = space ? space + 1 : str + strlen(str);
+  *arg_out = arg_str;
 
   char action_str[64];
   if (space) {
@@ -406,8 +614,6 @@ static enum keybind_action parse_action(const char *str, char *arg_out) {
       len = sizeof(action_str) - 1;
     strncpy(action_str, str, len);
     action_str[len] = '\0';
-    strncpy(arg_out, space + 1, 127);
-    arg_out[127] = '\0';
   } else {
     strncpy(action_str, str, sizeof(action_str) - 1);
     action_str[sizeof(action_str) - 1] = '\0';
@@ -417,29 +623,29 @@ static enum keybind_action parse_action(const char *str, char *arg_out) {
     if (strcasecmp(action_str, action_map[i].name) == 0) {
       enum keybind_action action = action_map[i].action;
 
-      if (action == ACTION_NONE && arg_out[0]) {
+      if (action == ACTION_NONE && arg_str[0]) {
         if (strcasecmp(action_str, "focus") == 0) {
-          if (strcasecmp(arg_out, "left") == 0)
+          if (strcasecmp(arg_str, "left") == 0)
             return ACTION_FOCUS_LEFT;
-          if (strcasecmp(arg_out, "right") == 0)
+          if (strcasecmp(arg_str, "right") == 0)
             return ACTION_FOCUS_RIGHT;
-          if (strcasecmp(arg_out, "up") == 0)
+          if (strcasecmp(arg_str, "up") == 0)
             return ACTION_FOCUS_UP;
-          if (strcasecmp(arg_out, "down") == 0)
+          if (strcasecmp(arg_str, "down") == 0)
             return ACTION_FOCUS_DOWN;
-          if (strcasecmp(arg_out, "next") == 0)
+          if (strcasecmp(arg_str, "next") == 0)
             return ACTION_FOCUS_NEXT;
-          if (strcasecmp(arg_out, "prev") == 0)
+          if (strcasecmp(arg_str, "prev") == 0)
             return ACTION_FOCUS_PREV;
         }
         if (strcasecmp(action_str, "move") == 0) {
-          if (strcasecmp(arg_out, "left") == 0)
+          if (strcasecmp(arg_str, "left") == 0)
             return ACTION_MOVE_LEFT;
-          if (strcasecmp(arg_out, "right") == 0)
+          if (strcasecmp(arg_str, "right") == 0)
             return ACTION_MOVE_RIGHT;
-          if (strcasecmp(arg_out, "up") == 0)
+          if (strcasecmp(arg_str, "up") == 0)
             return ACTION_MOVE_UP;
-          if (strcasecmp(arg_out, "down") == 0)
+          if (strcasecmp(arg_str, "down") == 0)
             return ACTION_MOVE_DOWN;
         }
       }
@@ -448,7 +654,7 @@ static enum keybind_action parse_action(const char *str, char *arg_out) {
     }
   }
 
-  fprintf(stderr, "Unknown action: %s\n", action_str);
+  config_warn("Unknown action: %s\n", action_str);
   return ACTION_NONE;
 }
 
@@ -476,8 +682,10 @@ bool parse_keybind(const char *str, uint32_t *mods, uint32_t *keysym) {
   *keysym = 0;
 
   char buf[128];
-  strncpy(buf, str, sizeof(buf) - 1);
-  buf[sizeof(buf) - 1] = '\0';
+  if (snprintf(buf, sizeof(buf), "%s", str) >= (int)sizeof(buf)) {
+    config_warn("Key combination too long: %s\n", str);
+    return false;
+  }
 
   char *saveptr;
   char *token = strtok_r(buf, "+", &saveptr);
@@ -511,7 +719,7 @@ bool parse_keybind(const char *str, uint32_t *mods, uint32_t *keysym) {
   if (last_token) {
     *keysym = xkb_keysym_from_name(last_token, XKB_KEYSYM_CASE_INSENSITIVE);
     if (*keysym == XKB_KEY_NoSymbol) {
-      fprintf(stderr, "Unknown key: %s\n", last_token);
+      config_warn("Unknown key: %s\n", last_token);
       return false;
     }
 
@@ -523,48 +731,299 @@ bool parse_keybind(const char *str, uint32_t *mods, uint32_t *keysym) {
   return *keysym != 0;
 }
 
-static void parse_keybinds(toml_table_t *keybinds_table) {
-  if (!keybinds_table)
+/*
+ * BINDING MODES
+ */
+static int binding_mode_index(const struct config *c, const char *name) {
+  for (int i = 0; i < c->binding_mode_count; i++) {
+    if (strcmp(c->binding_modes[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+int binding_mode_find(const char *name) {
+  return binding_mode_index(&config, name);
+}
+
+static int binding_mode_add(const char *name, bool oneshot) {
+  int mode = binding_mode_index(cfg, name);
+  if (mode >= 0)
+    return mode;
+
+  if (!TABLE_RESERVE(cfg->binding_modes, cfg->binding_mode_capacity,
+                     cfg->binding_mode_count + 1))
+    return -1;
+
+  cfg->binding_modes[cfg->binding_mode_count].name = intern(name);
+  cfg->binding_modes[cfg->binding_mode_count].oneshot = oneshot;
+  return cfg->binding_mode_count++;
+}
+
+static struct keybind *keybind_add(int mode, uint32_t mods, uint32_t keysym) {
+  if (!TABLE_RESERVE(cfg->keybinds, cfg->keybind_capacity,
+                     cfg->keybind_count + 1))
+    return NULL;
+
+  struct keybind *kb = &cfg->keybinds[cfg->keybind_count];
+  memset(kb, 0, sizeof(*kb));
+  kb->mode = mode;
+  kb->modifiers = mods;
+  kb->keysym = keysym;
+  kb->arg = "";
+  return kb;
+}
+
+/*
+ * KEYBIND INDEX
+ * Bindings are compiled into an open-addressed table keyed by
+ * (mode, modifiers, keysym) so every key press, bound or not, costs one
+ * probe sequence instead of a scan over all bindings.
+ */
+
+// Lock state must not stop Super+1 from matching with NumLock on
+#define KEYBIND_IGNORED_MODS (WLR_MODIFIER_CAPS | WLR_MODIFIER_MOD2)
+
+static int *keybind_index;
+static uint32_t keybind_index_mask;
+
+static uint32_t keybind_hash(int mode, uint32_t mods, uint32_t keysym) {
+  uint64_t key = ((uint64_t)(uint32_t)mode << 40) ^ ((uint64_t)mods << 32) ^
+                 (uint64_t)keysym;
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static void keybind_index_build(void) {
+  uint32_t size = 16;
+  while (size < (uint32_t)config.keybind_count * 2)
+    size <<= 1;
+
+  int *index = realloc(keybind_index, size * sizeof(*index));
+  if (!index) {
+    config_warn("Out of memory building keybind index\n");
+    return;
+  }
+  for (uint32_t i = 0; i < size; i++)
+    index[i] = -1;
+  keybind_index = index;
+  keybind_index_mask = size - 1;
+
+  for (int k = 0; k < config.keybind_count; k++) {
+    struct keybind *kb = &config.keybinds[k];
+    uint32_t slot =
+        keybind_hash(kb->mode, kb->modifiers, kb->keysym) & keybind_index_mask;
+    while (index[slot] >= 0) {
+      struct keybind *other = &config.keybinds[index[slot]];
+      // Later definitions (e.g. from includes) override earlier ones
+      if (other->mode == kb->mode && other->modifiers == kb->modifiers &&
+          other->keysym == kb->keysym)
+        break;
+      slot = (slot + 1) & keybind_index_mask;
+    }
+    index[slot] = k;
+  }
+}
+
+const struct keybind *keybind_lookup(int mode, uint32_t mods, uint32_t keysym) {
+  if (!keybind_index)
+    return NULL;
+
+  mods &= ~KEYBIND_IGNORED_MODS;
+  uint32_t slot = keybind_hash(mode, mods, keysym) & keybind_index_mask;
+  while (keybind_index[slot] >= 0) {
+    const struct keybind *kb = &config.keybinds[keybind_index[slot]];
+    if (kb->mode == mode && kb->modifiers == mods && kb->keysym == keysym)
+      return kb;
+    slot = (slot + 1) & keybind_index_mask;
+  }
+  return NULL;
+}
+
+/*
+ * A key of the form "Super+k, c" is a chord. Every step but the last
+ * switches into a hidden one-shot mode named after the keys so far.
+ */
+static int parse_chord_prefix(int mode, char *steps, char **last_step) {
+  char *saveptr;
+  char *step = strtok_r(steps, ",", &saveptr);
+  char *next;
+  char name[128];
+  snprintf(name, sizeof(name), "%s", cfg->binding_modes[mode].name);
+
+  while ((next = strtok_r(NULL, ",", &saveptr)) != NULL) {
+    uint32_t mods, keysym;
+    if (!parse_keybind(step, &mods, &keysym))
+      return -1;
+
+    size_t len = strlen(name);
+    if (snprintf(name + len, sizeof(name) - len, ":%s", step) >=
+        (int)(sizeof(name) - len)) {
+      config_warn("Chord too long: %s\n", steps);
+      return -1;
+    }
+
+    int chord_mode = binding_mode_add(name, true);
+    if (chord_mode < 0)
+      return -1;
+
+    struct keybind *kb = keybind_add(mode, mods, keysym);
+    if (!kb)
+      return -1;
+    kb->action = ACTION_BINDING_MODE;
+    kb->arg = intern(name);
+    cfg->keybind_count++;
+
+    mode = chord_mode;
+    step = next;
+  }
+
+  *last_step = step;
+  return mode;
+}
+
+static void parse_keybinds(toml_table_t *keybinds_table, int mode) {
+  if (!keybinds_table || mode < 0)
     return;
 
   int i = 0;
   const char *key;
   while ((key = toml_key_in(keybinds_table, i++)) != NULL) {
-    if (config.keybind_count >= MAX_KEYBINDS)
-      break;
-
     toml_datum_t val = toml_string_in(keybinds_table, key);
     if (!val.ok)
       continue;
 
-    struct keybind *kb = &config.keybinds[config.keybind_count];
+    char steps[256];
+    if (snprintf(steps, sizeof(steps), "%s", key) >= (int)sizeof(steps)) {
+      config_warn("Keybind too long, skipped: %s\n", key);
+      free(val.u.s);
+      continue;
+    }
+    char *last_step = steps;
+    int kb_mode = mode;
+    if (strchr(steps, ','))
+      kb_mode = parse_chord_prefix(mode, steps, &last_step);
 
-    if (!parse_keybind(key, &kb->modifiers, &kb->keysym)) {
+    uint32_t mods, keysym;
+    if (kb_mode < 0 || !parse_keybind(last_step, &mods, &keysym)) {
       free(val.u.s);
       continue;
     }
 
-    kb->action = parse_action(val.u.s, kb->arg);
+    struct keybind *kb = keybind_add(kb_mode, mods, keysym);
+    if (!kb) {
+      free(val.u.s);
+      break;
+    }
+
+    const char *arg;
+    kb->action = parse_action(val.u.s, &arg);
 
     if (kb->action == ACTION_NONE) {
       free(val.u.s);
       continue;
     }
 
-    config.keybind_count++;
+    kb->arg = intern(arg);
+    cfg->keybind_count++;
     free(val.u.s);
   }
 }
 
+// [modes.<name>] tables hold the bindings active in that mode
+static void parse_binding_modes(toml_table_t *modes_table) {
+  if (!modes_table)
+    return;
+
+  int i = 0;
+  const char *name;
+  while ((name = toml_key_in(modes_table, i++)) != NULL) {
+    toml_table_t *table = toml_table_in(modes_table, name);
+    if (!table)
+      continue;
+    parse_keybinds(table, binding_mode_add(name, false));
+  }
+}
+
+static void parse_xwayland(toml_table_t *xw) {
+  if (!xw)
+    return;
+
+  toml_datum_t v = toml_bool_in(xw, "enabled");
+  if (v.ok)
+    cfg->xwayland.enabled = v.u.b;
+
+  v = toml_bool_in(xw, "lazy");
+  if (v.ok)
+    cfg->xwayland.lazy = v.u.b;
+
+  v = toml_int_in(xw, "idle_timeout");
+  if (v.ok) {
+    // wlroots only goes back to lazy listening if Xwayland lived > 5 s
+    if (v.u.i <= 0)
+      cfg->xwayland.idle_timeout = 0;
+    else if (v.u.i < XWAYLAND_IDLE_TIMEOUT_MIN)
+      cfg->xwayland.idle_timeout = XWAYLAND_IDLE_TIMEOUT_MIN;
+    else
+      cfg->xwayland.idle_timeout = v.u.i;
+  }
+}
+
+static void parse_keyboard(toml_table_t *kb) {
+  if (!kb)
+    return;
+
+  static const struct {
+    const char *key;
+    size_t offset;
+    size_t size;
+  } names[] = {
+      {"xkb_rules", offsetof(struct keyboard_config, rules),
+       sizeof(cfg->keyboard.rules)},
+      {"xkb_model", offsetof(struct keyboard_config, model),
+       sizeof(cfg->keyboard.model)},
+      {"xkb_layout", offsetof(struct keyboard_config, layout),
+       sizeof(cfg->keyboard.layout)},
+      {"xkb_variant", offsetof(struct keyboard_config, variant),
+       sizeof(cfg->keyboard.variant)},
+      {"xkb_options", offsetof(struct keyboard_config, options),
+       sizeof(cfg->keyboard.options)},
+  };
+
+  toml_datum_t v;
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    v = toml_string_in(kb, names[i].key);
+    if (v.ok) {
+      char *dst = (char *)&cfg->keyboard + names[i].offset;
+      char what[32];
+      snprintf(what, sizeof(what), "keyboard.%s", names[i].key);
+      copy_string(dst, names[i].size, v.u.s, what);
+      free(v.u.s);
+    }
+  }
+
+  v = toml_int_in(kb, "repeat_rate");
+  if (v.ok)
+    cfg->keyboard.repeat_rate = v.u.i;
+
+  v = toml_int_in(kb, "repeat_delay");
+  if (v.ok)
+    cfg->keyboard.repeat_delay = v.u.i;
+}
+
 static void parse_autostart(toml_array_t *arr) {
   if (!arr)
     return;
 
   int len = toml_array_nelem(arr);
-  for (int i = 0; i < len && config.autostart_count < 32; i++) {
+  if (!TABLE_RESERVE(cfg->autostart, cfg->autostart_capacity,
+                     cfg->autostart_count + len))
+    return;
+
+  for (int i = 0; i < len; i++) {
     toml_datum_t val = toml_string_at(arr, i);
     if (val.ok) {
-      config.autostart[config.autostart_count++] = val.u.s;
+      cfg->autostart[cfg->autostart_count++] = intern(val.u.s);
+      free(val.u.s);
     }
   }
 }
@@ -667,143 +1126,143 @@ void parse_decoration(toml_table_t *decor) {
 
   v = toml_bool_in(decor, "enabled");
   if (v.ok)
-    config.decor.enabled = v.u.b;
+    cfg->decor.enabled = v.u.b;
 
   v = toml_int_in(decor, "height");
   if (v.ok)
-    config.decor.height = v.u.i;
+    cfg->decor.height = v.u.i;
 
   v = toml_int_in(decor, "button_size");
   if (v.ok)
-    config.decor.button_size = v.u.i;
+    cfg->decor.button_size = v.u.i;
 
   v = toml_int_in(decor, "button_spacing");
   if (v.ok)
-    config.decor.button_spacing = v.u.i;
+    cfg->decor.button_spacing = v.u.i;
 
   v = toml_int_in(decor, "corner_radius");
   if (v.ok)
-    config.decor.corner_radius = v.u.i;
+    cfg->decor.corner_radius = v.u.i;
 
   v = toml_string_in(decor, "bg_image");
   if (v.ok) {
-    strncpy(config.decor.bg_image_path, v.u.s,
-            sizeof(config.decor.bg_image_path) - 1);
-    config.decor.bg_image_path[sizeof(config.decor.bg_image_path) - 1] = '\0';
+    copy_string(cfg->decor.bg_image_path, sizeof(cfg->decor.bg_image_path),
+                v.u.s, "decoration.bg_image");
     free(v.u.s);
   }
 
   v = toml_bool_in(decor, "bg_image_tile");
   if (v.ok)
-    config.decor.bg_image_tile = v.u.b;
+    cfg->decor.bg_image_tile = v.u.b;
 
   v = toml_string_in(decor, "icon_close");
   if (v.ok) {
-    strncpy(config.decor.icon_close_path, v.u.s,
-            sizeof(config.decor.icon_close_path) - 1);
+    copy_string(cfg->decor.icon_close_path, sizeof(cfg->decor.icon_close_path),
+                v.u.s, "decoration.icon_close");
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "icon_maximize");
   if (v.ok) {
-    strncpy(config.decor.icon_maximize_path, v.u.s,
-            sizeof(config.decor.icon_maximize_path) - 1);
+    copy_string(cfg->decor.icon_maximize_path, sizeof(cfg->decor.icon_maximize_path),
+                v.u.s, "decoration.icon_maximize");
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "icon_minimize");
   if (v.ok) {
-    strncpy(config.decor.icon_minimize_path, v.u.s,
-            sizeof(config.decor.icon_minimize_path) - 1);
+    copy_string(cfg->decor.icon_minimize_path, sizeof(cfg->decor.icon_minimize_path),
+                v.u.s, "decoration.icon_minimize");
     free(v.u.s);
   }
 
   v = toml_int_in(decor, "font_weight");
   if (v.ok)
-    config.decor.font_weight = v.u.i;
+    cfg->decor.font_weight = v.u.i;
 
   v = toml_bool_in(decor, "font_italic");
   if (v.ok)
-    config.decor.font_italic = v.u.b;
+    cfg->decor.font_italic = v.u.b;
   // Colors - parse hex strings to uint32_t
   v = toml_string_in(decor, "bg_color");
   if (v.ok) {
-    config.decor.bg_color = parse_color_hex(v.u.s);
+    cfg->decor.bg_color = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "bg_color_inactive");
   if (v.ok) {
-    config.decor.bg_color_inactive = parse_color_hex(v.u.s);
+    cfg->decor.bg_color_inactive = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "title_color");
   if (v.ok) {
-    config.decor.title_color = parse_color_hex(v.u.s);
+    cfg->decor.title_color = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "title_color_inactive");
   if (v.ok) {
-    config.decor.title_color_inactive = parse_color_hex(v.u.s);
+    cfg->decor.title_color_inactive = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   // Button colors
   v = toml_string_in(decor, "close_color");
   if (v.ok) {
-    config.decor.btn_close_color = parse_color_hex(v.u.s);
+    cfg->decor.btn_close_color = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "close_hover");
   if (v.ok) {
-    config.decor.btn_close_hover = parse_color_hex(v.u.s);
+    cfg->decor.btn_close_hover = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "maximize_color");
   if (v.ok) {
-    config.decor.btn_max_color = parse_color_hex(v.u.s);
+    cfg->decor.btn_max_color = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "maximize_hover");
   if (v.ok) {
-    config.decor.btn_max_hover = parse_color_hex(v.u.s);
+    cfg->decor.btn_max_hover = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "minimize_color");
   if (v.ok) {
-    config.decor.btn_min_color = parse_color_hex(v.u.s);
+    cfg->decor.btn_min_color = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(decor, "minimize_hover");
   if (v.ok) {
-    config.decor.btn_min_hover = parse_color_hex(v.u.s);
+    cfg->decor.btn_min_hover = parse_color_hex(v.u.s);
     free(v.u.s);
   }
 
   // Font
   v = toml_string_in(decor, "font");
   if (v.ok) {
-    strncpy(config.decor.font, v.u.s, sizeof(config.decor.font) - 1);
+    copy_string(cfg->decor.font, sizeof(cfg->decor.font), v.u.s,
+                "decoration.font");
     free(v.u.s);
   }
 
   v = toml_int_in(decor, "font_size");
   if (v.ok)
-    config.decor.font_size = v.u.i;
+    cfg->decor.font_size = v.u.i;
 
   v = toml_bool_in(decor, "buttons_left");
   if (v.ok)
-    config.decor.buttons_left = v.u.b;
+    cfg->decor.buttons_left = v.u.b;
 
   toml_table_t *shadow_table = toml_table_in(decor, "shadow");
-  parse_shadow_config(shadow_table, &config.decor.shadow);
+  parse_shadow_config(shadow_table, &cfg->decor.shadow);
 }
 
 static void parse_animation(toml_table_t *anim) {
@@ -814,59 +1273,59 @@ static void parse_animation(toml_table_t *anim) {
 
   v = toml_bool_in(anim, "enabled");
   if (v.ok)
-    config.anim.enabled = v.u.b;
+    cfg->anim.enabled = v.u.b;
 
   v = toml_int_in(anim, "duration");
   if (v.ok)
-    config.anim.duration_ms = v.u.i;
+    cfg->anim.duration_ms = v.u.i;
 
   v = toml_int_in(anim, "speed"); // alias
   if (v.ok)
-    config.anim.duration_ms = v.u.i;
+    cfg->anim.duration_ms = v.u.i;
 
   v = toml_string_in(anim, "window_open");
   if (v.ok) {
-    config.anim.window_open = parse_anim_type(v.u.s);
+    cfg->anim.window_open = parse_anim_type(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(anim, "window_close");
   if (v.ok) {
-    config.anim.window_close = parse_anim_type(v.u.s);
+    cfg->anim.window_close = parse_anim_type(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(anim, "window_move");
   if (v.ok) {
-    config.anim.window_move = parse_anim_type(v.u.s);
+    cfg->anim.window_move = parse_anim_type(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(anim, "window_resize");
   if (v.ok) {
-    config.anim.window_resize = parse_anim_type(v.u.s);
+    cfg->anim.window_resize = parse_anim_type(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(anim, "workspace_switch");
   if (v.ok) {
-    config.anim.workspace_switch = parse_anim_type(v.u.s);
+    cfg->anim.workspace_switch = parse_anim_type(v.u.s);
     free(v.u.s);
   }
 
   v = toml_string_in(anim, "curve");
   if (v.ok) {
-    config.anim.curve = parse_anim_curve(v.u.s);
+    cfg->anim.curve = parse_anim_curve(v.u.s);
     free(v.u.s);
   }
 
   v = toml_double_in(anim, "fade_min");
   if (v.ok)
-    config.anim.fade_min = v.u.d;
+    cfg->anim.fade_min = v.u.d;
 
   v = toml_double_in(anim, "zoom_min");
   if (v.ok)
-    config.anim.zoom_min = v.u.d;
+    cfg->anim.zoom_min = v.u.d;
 }
 
 static void parse_window_rules(toml_array_t *rules) {
@@ -874,27 +1333,33 @@ static void parse_window_rules(toml_array_t *rules) {
     return;
 
   int len = toml_array_nelem(rules);
-  for (int i = 0; i < len && config.rule_count < MAX_WINDOW_RULES; i++) {
+  if (!TABLE_RESERVE(cfg->rules, cfg->rule_capacity, cfg->rule_count + len))
+    return;
+
+  for (int i = 0; i < len; i++) {
     toml_table_t *rule = toml_table_at(rules, i);
     if (!rule)
       continue;
 
-    struct window_rule *r = &config.rules[config.rule_count];
+    struct window_rule *r = &cfg->rules[cfg->rule_count];
     memset(r, 0, sizeof(*r));
     r->opacity = 1.0f;
     r->workspace = -1;
 
     toml_datum_t v;
 
+    // An empty pattern has always meant "any", same as leaving it out
     v = toml_string_in(rule, "app_id");
     if (v.ok) {
-      strncpy(r->app_id, v.u.s, sizeof(r->app_id) - 1);
+      if (v.u.s[0])
+        r->app_id = intern(v.u.s);
       free(v.u.s);
     }
 
     v = toml_string_in(rule, "title");
     if (v.ok) {
-      strncpy(r->title, v.u.s, sizeof(r->title) - 1);
+      if (v.u.s[0])
+        r->title = intern(v.u.s);
       free(v.u.s);
     }
 
@@ -940,12 +1405,25 @@ static void parse_window_rules(toml_array_t *rules) {
       r->has_opacity = true;
     }
 
-    config.rule_count++;
+    cfg->rule_count++;
   }
 }
 
 static int load_config_file(const char *path);
 
+// Remember every file and directory read, for the auto-reload watcher
+static void config_source_add(const char *path) {
+  char **sources =
+      realloc(cfg->sources, (cfg->source_count + 1) * sizeof(*sources));
+  if (!sources)
+    return;
+  cfg->sources = sources;
+
+  char *copy = strdup(path);
+  if (copy)
+    sources[cfg->source_count++] = copy;
+}
+
 static int compare_strings(const void *a, const void *b) {
   return strcmp(*(const char **)a, *(const char **)b);
 }
@@ -954,13 +1432,15 @@ static void load_config_dir(const char *dirpath) {
   DIR *dir = opendir(dirpath);
   if (!dir)
     return;
+  config_source_add(dirpath);
 
   // Collect .toml files
-  char *files[128];
+  char **files = NULL;
   int file_count = 0;
+  int file_capacity = 0;
 
   struct dirent *entry;
-  while ((entry = readdir(dir)) != NULL && file_count < 128) {
+  while ((entry = readdir(dir)) != NULL) {
     if (entry->d_name[0] == '.')
       continue;
 
@@ -969,11 +1449,23 @@ static void load_config_dir(const char *dirpath) {
       continue;
 
     char fullpath[512];
-    snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath, entry->d_name);
+    if (snprintf(fullpath, sizeof(fullpath), "%s/%s", dirpath,
+                 entry->d_name) >= (int)sizeof(fullpath)) {
+      config_warn("Config path too long, skipped: %s/%s\n", dirpath,
+                  entry->d_name);
+      continue;
+    }
 
     struct stat st;
     if (stat(fullpath, &st) == 0 && S_ISREG(st.st_mode)) {
-      files[file_count++] = strdup(fullpath);
+      char *copy = strdup(fullpath);
+      if (!copy || !TABLE_RESERVE(files, file_capacity, file_count + 1)) {
+        config_warn("Config: out of memory listing %s, skipped: %s\n",
+                    dirpath, entry->d_name);
+        free(copy);
+        continue;
+      }
+      files[file_count++] = copy;
     }
   }
   closedir(dir);
@@ -986,21 +1478,23 @@ static void load_config_dir(const char *dirpath) {
     load_config_file(files[i]);
     free(files[i]);
   }
+  free(files);
 }
 
 static int load_config_file(const char *path) {
   if (include_depth >= MAX_INCLUDE_DEPTH) {
-    fprintf(stderr, "Config include depth exceeded\n");
+    config_warn("Config include depth exceeded\n");
     return -1;
   }
 
   FILE *fp = fopen(path, "r");
   if (!fp) {
-    fprintf(stderr, "Cannot open config: %s\n", path);
+    config_warn("Cannot open config: %s\n", path);
     return -1;
   }
 
   printf("Loading config: %s\n", path);
+  config_source_add(path);
   include_depth++;
 
   char errbuf[256];
@@ -1008,7 +1502,7 @@ static int load_config_file(const char *path) {
   fclose(fp);
 
   if (!root) {
-    fprintf(stderr, "Config parse error in %s: %s\n", path, errbuf);
+    config_warn("Config parse error in %s: %s\n", path, errbuf);
     include_depth--;
     return -1;
   }
@@ -1023,11 +1517,17 @@ static int load_config_file(const char *path) {
         continue;
 
       char fullpath[512];
+      int n;
       if (inc.u.s[0] == '/') {
-        strncpy(fullpath, inc.u.s, sizeof(fullpath) - 1);
+        n = snprintf(fullpath, sizeof(fullpath), "%s", inc.u.s);
       } else {
-        snprintf(fullpath, sizeof(fullpath), "%s/%s", config.config_dir,
-                 inc.u.s);
+        n = snprintf(fullpath, sizeof(fullpath), "%s/%s", cfg->config_dir,
+                     inc.u.s);
+      }
+      if (n >= (int)sizeof(fullpath)) {
+        config_warn("Include path too long, skipped: %s\n", inc.u.s);
+        free(inc.u.s);
+        continue;
       }
 
       struct stat st;
@@ -1037,6 +1537,9 @@ static int load_config_file(const char *path) {
         } else {
           load_config_file(fullpath);
         }
+      } else {
+        // Creating it later must still count as a change
+        config_source_add(fullpath);
       }
       free(inc.u.s);
     }
@@ -1048,15 +1551,15 @@ static int load_config_file(const char *path) {
 
     v = toml_double_in(gestures, "swipe_threshold");
     if (v.ok)
-      config.gesture_swipe_threshold = v.u.d;
+      cfg->gesture_swipe_threshold = v.u.d;
 
     v = toml_double_in(gestures, "pinch_threshold");
     if (v.ok)
-      config.gesture_pinch_threshold = v.u.d;
+      cfg->gesture_pinch_threshold = v.u.d;
 
     v = toml_double_in(gestures, "mouse_threshold");
     if (v.ok)
-      config.gesture_mouse_threshold = v.u.d;
+      cfg->gesture_mouse_threshold = v.u.d;
   }
 
   // [[gesture_touchpad]]
@@ -1071,49 +1574,57 @@ static int load_config_file(const char *path) {
 
     v = toml_int_in(general, "gaps_inner");
     if (v.ok)
-      config.gaps_inner = v.u.i;
+      cfg->gaps_inner = v.u.i;
 
     v = toml_int_in(general, "gaps_outer");
     if (v.ok)
-      config.gaps_outer = v.u.i;
+      cfg->gaps_outer = v.u.i;
 
     v = toml_int_in(general, "border_width");
     if (v.ok)
-      config.border_width = v.u.i;
+      cfg->border_width = v.u.i;
 
     v = toml_string_in(general, "border_color_active");
     if (v.ok) {
-      config.border_color_active = parse_color(v.u.s);
+      cfg->border_color_active = parse_color(v.u.s);
       free(v.u.s);
     }
 
     v = toml_string_in(general, "border_color_inactive");
     if (v.ok) {
-      config.border_color_inactive = parse_color(v.u.s);
+      cfg->border_color_inactive = parse_color(v.u.s);
       free(v.u.s);
     }
 
     v = toml_bool_in(general, "focus_follows_mouse");
     if (v.ok)
-      config.focus_follows_mouse = v.u.b;
+      cfg->focus_follows_mouse = v.u.b;
+
+    v = toml_bool_in(general, "auto_reload");
+    if (v.ok)
+      cfg->auto_reload = v.u.b;
+
+    v = toml_bool_in(general, "systemd_scope");
+    if (v.ok)
+      cfg->systemd_scope = v.u.b;
 
     v = toml_string_in(general, "default_mode");
     if (v.ok) {
       if (strcasecmp(v.u.s, "floating") == 0) {
-        config.default_mode = MODE_FLOATING;
+        cfg->default_mode = MODE_FLOATING;
       } else {
-        config.default_mode = MODE_TILING;
+        cfg->default_mode = MODE_TILING;
       }
       free(v.u.s);
     }
 
     v = toml_int_in(general, "resize_step");
     if (v.ok)
-      config.resize_step = v.u.i;
+      cfg->resize_step = v.u.i;
 
     v = toml_int_in(general, "move_step");
     if (v.ok)
-      config.move_step = v.u.i;
+      cfg->move_step = v.u.i;
   }
 
   // [decoration]
@@ -1129,15 +1640,22 @@ static int load_config_file(const char *path) {
 
     v = toml_double_in(tiling, "master_ratio");
     if (v.ok)
-      config.master_ratio = v.u.d;
+      cfg->master_ratio = v.u.d;
 
     v = toml_int_in(tiling, "master_count");
     if (v.ok)
-      config.master_count = v.u.i;
+      cfg->master_count = v.u.i;
   }
 
+  // [keyboard]
+  parse_keyboard(toml_table_in(root, "keyboard"));
+
+  // [xwayland]
+  parse_xwayland(toml_table_in(root, "xwayland"));
+
   // [keybinds]
-  parse_keybinds(toml_table_in(root, "keybinds"));
+  parse_keybinds(toml_table_in(root, "keybinds"), BINDING_MODE_DEFAULT);
+  parse_binding_modes(toml_table_in(root, "modes"));
 
   // [[rules]]
   parse_window_rules(toml_array_in(root, "rules"));
@@ -1151,7 +1669,313 @@ static int load_config_file(const char *path) {
   return 0;
 }
 
-int config_load(const char *path) {
+/*
+ * RELOAD
+ * A reload parses into a fresh config built from the compiled-in defaults
+ * and compares it with the previous parse section by section. Only the
+ * sections that changed replace the live ones, so runtime adjustments
+ * (master ratio, gaps set from scripts) survive an unrelated edit and
+ * config_apply_live() can skip the work for everything else.
+ */
+
+// Compiled-in defaults, captured before the first parse
+static struct config config_defaults;
+static bool config_defaults_saved;
+
+// What the files said last time; only its scalar sections are ever read
+static struct config config_parsed;
+
+static void config_sources_release(struct config *c) {
+  for (int i = 0; i < c->source_count; i++)
+    free(c->sources[i]);
+  free(c->sources);
+  c->sources = NULL;
+  c->source_count = 0;
+}
+
+// Free every table and the strings they point to; scalars are untouched
+static void config_release(struct config *c) {
+  free(c->keybinds);
+  c->keybinds = NULL;
+  c->keybind_count = c->keybind_capacity = 0;
+  free(c->binding_modes);
+  c->binding_modes = NULL;
+  c->binding_mode_count = c->binding_mode_capacity = 0;
+
+  free(c->rules);
+  c->rules = NULL;
+  c->rule_count = c->rule_capacity = 0;
+
+  free(c->autostart);
+  c->autostart = NULL;
+  c->autostart_count = c->autostart_capacity = 0;
+
+  free(c->gesture_touchpad);
+  c->gesture_touchpad = NULL;
+  c->gesture_touchpad_count = c->gesture_touchpad_capacity = 0;
+  free(c->gesture_mouse);
+  c->gesture_mouse = NULL;
+  c->gesture_mouse_count = c->gesture_mouse_capacity = 0;
+
+  string_pool_free(c->strings);
+  c->strings = NULL;
+}
+
+void config_free(struct config *c) {
+  config_release(c);
+  config_sources_release(c);
+}
+
+/*
+ * Every config starts as a byte copy of the defaults and parse_* only writes
+ * named fields, so padding and string tails compare equal for equal input.
+ * A false "changed" only costs a redundant apply.
+ */
+#define SECTION_DIFFERS(a, b, member)                                          \
+  (memcmp(&(a)->member, &(b)->member, sizeof((a)->member)) != 0)
+
+/*
+ * Table entries point into their config's string pool, so they compare by
+ * field and by string contents rather than bytewise.
+ */
+static bool string_equal(const char *a, const char *b) {
+  return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static bool keybinds_equal(const struct config *a, const struct config *b) {
+  if (a->keybind_count != b->keybind_count ||
+      a->binding_mode_count != b->binding_mode_count)
+    return false;
+
+  for (int i = 0; i < a->keybind_count; i++) {
+    const struct keybind *x = &a->keybinds[i], *y = &b->keybinds[i];
+    if (x->mode != y->mode || x->modifiers != y->modifiers ||
+        x->keysym != y->keysym || x->action != y->action ||
+        !string_equal(x->arg, y->arg))
+      return false;
+  }
+  for (int i = 0; i < a->binding_mode_count; i++) {
+    if (a->binding_modes[i].oneshot != b->binding_modes[i].oneshot ||
+        !string_equal(a->binding_modes[i].name, b->binding_modes[i].name))
+      return false;
+  }
+  return true;
+}
+
+static bool rules_equal(const struct config *a, const struct config *b) {
+  if (a->rule_count != b->rule_count)
+    return false;
+
+  for (int i = 0; i < a->rule_count; i++) {
+    const struct window_rule *x = &a->rules[i], *y = &b->rules[i];
+    if (!string_equal(x->app_id, y->app_id) ||
+        !string_equal(x->title, y->title) || x->floating != y->floating ||
+        x->fullscreen != y->fullscreen || x->workspace != y->workspace ||
+        x->x != y->x || x->y != y->y || x->width != y->width ||
+        x->height != y->height || x->opacity != y->opacity ||
+        x->has_position != y->has_position || x->has_size != y->has_size ||
+        x->has_opacity != y->has_opacity)
+      return false;
+  }
+  return true;
+}
+
+static bool gesture_action_equal(const struct gesture_action *x,
+                                 const struct gesture_action *y) {
+  return x->type == y->type && string_equal(x->arg, y->arg);
+}
+
+static bool gestures_equal(const struct config *a, const struct config *b) {
+  if (a->gesture_touchpad_count != b->gesture_touchpad_count ||
+      a->gesture_mouse_count != b->gesture_mouse_count)
+    return false;
+
+  for (int i = 0; i < a->gesture_touchpad_count; i++) {
+    const struct gesture_touchpad *x = &a->gesture_touchpad[i];
+    const struct gesture_touchpad *y = &b->gesture_touchpad[i];
+    if (x->fingers != y->fingers || x->direction != y->direction ||
+        !gesture_action_equal(&x->action, &y->action))
+      return false;
+  }
+  for (int i = 0; i < a->gesture_mouse_count; i++) {
+    const struct gesture_mouse *x = &a->gesture_mouse[i];
+    const struct gesture_mouse *y = &b->gesture_mouse[i];
+    if (x->button != y->button || x->modifiers != y->modifiers ||
+        x->direction != y->direction ||
+        !gesture_action_equal(&x->action, &y->action))
+      return false;
+  }
+  return true;
+}
+
+static uint32_t config_diff(const struct config *next) {
+  const struct config *old = &config_parsed;
+  uint32_t changed = 0;
+
+  if (next->gaps_inner != old->gaps_inner ||
+      next->gaps_outer != old->gaps_outer ||
+      next->focus_follows_mouse != old->focus_follows_mouse ||
+      next->auto_reload != old->auto_reload ||
+      next->systemd_scope != old->systemd_scope ||
+      next->resize_step != old->resize_step ||
+      next->move_step != old->move_step)
+    changed |= CONFIG_SECTION_GENERAL;
+
+  if (next->border_width != old->border_width ||
+      next->border_color_active != old->border_color_active ||
+      next->border_color_inactive != old->border_color_inactive)
+    changed |= CONFIG_SECTION_BORDERS;
+
+  if (next->default_mode != old->default_mode)
+    changed |= CONFIG_SECTION_MODE;
+  if (SECTION_DIFFERS(next, old, keyboard))
+    changed |= CONFIG_SECTION_KEYBOARD;
+  if (SECTION_DIFFERS(next, old, background))
+    changed |= CONFIG_SECTION_BACKGROUND;
+  if (SECTION_DIFFERS(next, old, decor))
+    changed |= CONFIG_SECTION_DECOR;
+  if (SECTION_DIFFERS(next, old, anim))
+    changed |= CONFIG_SECTION_ANIM;
+  if (SECTION_DIFFERS(next, old, xwayland))
+    changed |= CONFIG_SECTION_XWAYLAND;
+
+  if (next->master_ratio != old->master_ratio ||
+      next->master_count != old->master_count)
+    changed |= CONFIG_SECTION_TILING;
+
+  // Tables are never modified at runtime, so compare them with the live ones
+  const struct config *live = &config;
+
+  if (!keybinds_equal(next, live))
+    changed |= CONFIG_SECTION_KEYBINDS;
+  if (!rules_equal(next, live))
+    changed |= CONFIG_SECTION_RULES;
+
+  bool autostart_differs = next->autostart_count != live->autostart_count;
+  for (int i = 0; !autostart_differs && i < next->autostart_count; i++)
+    autostart_differs = strcmp(next->autostart[i], live->autostart[i]) != 0;
+  if (autostart_differs)
+    changed |= CONFIG_SECTION_AUTOSTART;
+
+  if (next->gesture_swipe_threshold != old->gesture_swipe_threshold ||
+      next->gesture_pinch_threshold != old->gesture_pinch_threshold ||
+      next->gesture_mouse_threshold != old->gesture_mouse_threshold ||
+      !gestures_equal(next, live))
+    changed |= CONFIG_SECTION_GESTURES;
+
+  return changed;
+}
+
+/*
+ * Move the changed sections of next into the live config; next is consumed.
+ * An unchanged table in next is identical to the live one, so the tables
+ * and the pool they point into are always taken from next as a unit.
+ * changed only decides which scalars are copied.
+ */
+static void config_adopt(struct config *next, uint32_t changed) {
+  config_release(&config);
+
+  config.keybinds = next->keybinds;
+  config.keybind_count = next->keybind_count;
+  config.keybind_capacity = next->keybind_capacity;
+  config.binding_modes = next->binding_modes;
+  config.binding_mode_count = next->binding_mode_count;
+  config.binding_mode_capacity = next->binding_mode_capacity;
+  config.rules = next->rules;
+  config.rule_count = next->rule_count;
+  config.rule_capacity = next->rule_capacity;
+  config.autostart = next->autostart;
+  config.autostart_count = next->autostart_count;
+  config.autostart_capacity = next->autostart_capacity;
+  config.gesture_touchpad = next->gesture_touchpad;
+  config.gesture_touchpad_count = next->gesture_touchpad_count;
+  config.gesture_touchpad_capacity = next->gesture_touchpad_capacity;
+  config.gesture_mouse = next->gesture_mouse;
+  config.gesture_mouse_count = next->gesture_mouse_count;
+  config.gesture_mouse_capacity = next->gesture_mouse_capacity;
+  config.strings = next->strings;
+
+  if (changed & CONFIG_SECTION_GENERAL) {
+    config.gaps_inner = next->gaps_inner;
+    config.gaps_outer = next->gaps_outer;
+    config.focus_follows_mouse = next->focus_follows_mouse;
+    config.auto_reload = next->auto_reload;
+    config.systemd_scope = next->systemd_scope;
+    config.resize_step = next->resize_step;
+    config.move_step = next->move_step;
+  }
+  if (changed & CONFIG_SECTION_BORDERS) {
+    config.border_width = next->border_width;
+    config.border_color_active = next->border_color_active;
+    config.border_color_inactive = next->border_color_inactive;
+  }
+  if (changed & CONFIG_SECTION_MODE)
+    config.default_mode = next->default_mode;
+  if (changed & CONFIG_SECTION_KEYBOARD)
+    config.keyboard = next->keyboard;
+  if (changed & CONFIG_SECTION_BACKGROUND)
+    config.background = next->background;
+  if (changed & CONFIG_SECTION_DECOR)
+    config.decor = next->decor;
+  if (changed & CONFIG_SECTION_ANIM)
+    config.anim = next->anim;
+  if (changed & CONFIG_SECTION_XWAYLAND)
+    config.xwayland = next->xwayland;
+  if (changed & CONFIG_SECTION_TILING) {
+    config.master_ratio = next->master_ratio;
+    config.master_count = next->master_count;
+  }
+  if (changed & CONFIG_SECTION_GESTURES) {
+    config.gesture_swipe_threshold = next->gesture_swipe_threshold;
+    config.gesture_pinch_threshold = next->gesture_pinch_threshold;
+    config.gesture_mouse_threshold = next->gesture_mouse_threshold;
+  }
+}
+
+// Parse the config tree into target, which must be fresh
+static int config_parse(struct config *target, const char *path) {
+  pthread_mutex_lock(&parse_lock);
+
+  // Unchanged sources: take the resolved snapshot instead of parsing
+  if (config_cache_load(target, &config_defaults, path) == 0) {
+    printf("Config loaded from cache: %d keybinds (%d modes), %d rules, "
+           "%d autostart\n",
+           target->keybind_count, target->binding_mode_count,
+           target->rule_count, target->autostart_count);
+    pthread_mutex_unlock(&parse_lock);
+    return 0;
+  }
+
+  cfg = target;
+  include_depth = 0;
+  time_t parse_start = time(NULL);
+
+  parse_warnings = 0;
+  binding_mode_add("default", false);
+  int ret = load_config_file(path);
+
+  printf("Config loaded: %d keybinds (%d modes), %d rules, %d autostart\n",
+         cfg->keybind_count, cfg->binding_mode_count, cfg->rule_count,
+         cfg->autostart_count);
+
+  // Warnings must show on the next start too, so only clean parses are cached
+  if (ret == 0 && parse_warnings == 0)
+    config_cache_store(target, &config_defaults, path, parse_start);
+  else if (ret == 0)
+    printf("Config: %d warning%s, not cached\n", parse_warnings,
+           parse_warnings == 1 ? "" : "s");
+
+  cfg = &config;
+  pthread_mutex_unlock(&parse_lock);
+  return ret;
+}
+
+struct config *config_load_begin(const char *path) {
+  if (!config_defaults_saved) {
+    memcpy(&config_defaults, &config, sizeof(config));
+    config_defaults_saved = true;
+  }
+
   strncpy(config_path, path, sizeof(config_path) - 1);
 
   // Extract config directory
@@ -1164,35 +1988,86 @@ int config_load(const char *path) {
     strcpy(config.config_dir, ".");
   }
 
-  int ret = load_config_file(path);
+  struct config *next = malloc(sizeof(*next));
+  if (!next)
+    return NULL;
+  memcpy(next, &config, sizeof(*next));
+  return next;
+}
 
-  printf("Config loaded: %d keybinds, %d rules, %d autostart\n",
-         config.keybind_count, config.rule_count, config.autostart_count);
+int config_load_parse(struct config *next) {
+  return config_parse(next, config_path);
+}
 
-  return ret;
+int config_load_finish(struct config *next, int parse_ret) {
+  // A failed parse still keeps whatever the readable files set
+  memcpy(&config, next, sizeof(config));
+  free(next);
+  keybind_index_build();
+  memcpy(&config_parsed, &config, sizeof(config));
+  return parse_ret;
 }
 
-int config_reload(void) {
-  if (config_path[0] == '\0')
+int config_load(const char *path) {
+  struct config *next = config_load_begin(path);
+  if (!next)
     return -1;
+  return config_load_finish(next, config_load_parse(next));
+}
 
-  free(config.gesture_touchpad);
-  config.gesture_touchpad = NULL;
-  config.gesture_touchpad_count = 0;
+struct config *config_reload_begin(void) {
+  if (config_path[0] == '\0')
+    return NULL;
+
+  struct config *next = malloc(sizeof(*next));
+  if (!next)
+    return NULL;
+  memcpy(next, &config_defaults, sizeof(*next));
+  memcpy(next->config_dir, config.config_dir, sizeof(next->config_dir));
+  return next;
+}
+
+int config_reload_parse(struct config *next) {
+  printf("Reloading config...\n");
+  return config_parse(next, config_path);
+}
 
-  free(config.gesture_mouse);
-  config.gesture_mouse = NULL;
-  config.gesture_mouse_count = 0;
+int config_reload_finish(struct config *next, int parse_ret,
+                         uint32_t *changed) {
+  if (changed)
+    *changed = 0;
 
-  // Clear autostart
-  for (int i = 0; i < config.autostart_count; i++) {
-    free(config.autostart[i]);
-    config.autostart[i] = NULL;
+  if (parse_ret < 0) {
+    config_free(next);
+    free(next);
+    fprintf(stderr, "Config reload failed, keeping the running config\n");
+    return -1;
   }
-  config.autostart_count = 0;
-  config.keybind_count = 0;
-  config.rule_count = 0;
 
-  printf("Reloading config...\n");
-  return config_load(config_path);
+  uint32_t diff = config_diff(next);
+  memcpy(&config_parsed, next, sizeof(*next));
+
+  // The include tree may have changed even when no section did
+  config_sources_release(&config);
+  config.sources = next->sources;
+  config.source_count = next->source_count;
+
+  config_adopt(next, diff);
+  free(next);
+  keybind_index_build();
+
+  printf("Config reloaded: changed sections 0x%03x\n", diff);
+  if (changed)
+    *changed = diff;
+  return 0;
+}
+
+int config_reload(uint32_t *changed) {
+  struct config *next = config_reload_begin();
+  if (!next) {
+    if (changed)
+      *changed = 0;
+    return -1;
+  }
+  return config_reload_finish(next, config_reload_parse(next), changed);
 }
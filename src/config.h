@@ -4,11 +4,10 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-#define MAX_KEYBINDS 128
 #define MAX_WORKSPACES 10
-#define MAX_WINDOW_RULES 64
 #define MAX_INCLUDE_DEPTH 8
 struct decor_config;
 /*
@@ -102,21 +101,37 @@ enum keybind_action {
   ACTION_SWAP_RIGHT,
   ACTION_SWAP_UP,
   ACTION_SWAP_DOWN,
+  ACTION_BINDING_MODE,
+  ACTION_LAYOUT_NEXT,
 };
 
 struct keybind {
+  int mode;
   uint32_t modifiers;
   uint32_t keysym;
   enum keybind_action action;
-  char arg[128];
+  const char *arg; // never NULL; "" for none
+};
+
+/*
+ * BINDING MODES
+ * Mode 0 is always "default". One-shot modes are the hidden intermediate
+ * steps of a chord: any key pressed in them drops back to the default mode.
+ */
+#define BINDING_MODE_DEFAULT 0
+
+struct binding_mode {
+  const char *name;
+  bool oneshot;
 };
 
 /*
  * WINDOW RULES
+ * Patterns are fnmatch() globs; NULL matches anything.
  */
 struct window_rule {
-  char app_id[64];
-  char title[128];
+  const char *app_id;
+  const char *title;
   bool floating;
   bool fullscreen;
   int workspace;
@@ -226,7 +241,7 @@ enum gesture_action_type {
 
 struct gesture_action {
   enum gesture_action_type type;
-  char arg[256];
+  const char *arg; // never NULL; "" for none
 };
 
 struct gesture_touchpad {
@@ -254,6 +269,40 @@ enum background_mode {
   BG_TILE,
 };
 
+/*
+ * KEYBOARD
+ * xkb RMLVO names; empty strings fall back to the xkbcommon defaults.
+ * Several layouts ("us,de") compile into one keymap, so switching between
+ * them is a group change rather than a recompile.
+ */
+struct keyboard_config {
+  char rules[64];
+  char model[64];
+  char layout[128];
+  char variant[128];
+  char options[256];
+  int repeat_rate;
+  int repeat_delay;
+};
+
+/*
+ * XWAYLAND
+ * In lazy mode Xwayland is only started when an X11 client first connects
+ * to DISPLAY, and stops again idle_timeout seconds after the last one has
+ * gone (0 keeps it running). Read once at startup.
+ *
+ * wlroots only re-arms lazy mode when Xwayland ran for more than 5 s, and
+ * otherwise treats the exit as a crash and stops listening on DISPLAY, so
+ * a non-zero idle_timeout is raised to XWAYLAND_IDLE_TIMEOUT_MIN.
+ */
+#define XWAYLAND_IDLE_TIMEOUT_MIN 6
+
+struct xwayland_config {
+  bool enabled;
+  bool lazy;
+  int idle_timeout;
+};
+
 struct background_config {
   bool enabled;
   uint32_t color;
@@ -263,7 +312,13 @@ struct background_config {
 
 /*
  * CONFIG STRUCT
+ * Every table is sized from the parsed files. The strings the tables point
+ * to (keybind and gesture arguments, rule patterns, autostart commands,
+ * mode names) are interned in one pool owned by the config, so a table and
+ * its strings are always released and replaced together.
  */
+struct string_pool;
+
 struct config {
   // [general]
   int gaps_inner;
@@ -272,11 +327,19 @@ struct config {
   uint32_t border_color_active;
   uint32_t border_color_inactive;
   bool focus_follows_mouse;
+  bool auto_reload;
+  bool systemd_scope;   // start programs in their own systemd scope
   enum window_mode default_mode;
   
+  // [keyboard]
+  struct keyboard_config keyboard;
+
   // [background]
   struct background_config background;
 
+  // [xwayland]
+  struct xwayland_config xwayland;
+
   // [decoration]
   struct decor_config decor;
 
@@ -292,22 +355,30 @@ struct config {
   int move_step;
 
   // Keybinds
-  struct keybind keybinds[MAX_KEYBINDS];
+  struct keybind *keybinds;
   int keybind_count;
+  int keybind_capacity;
+  struct binding_mode *binding_modes;
+  int binding_mode_count;
+  int binding_mode_capacity;
 
   // Window rules
-  struct window_rule rules[MAX_WINDOW_RULES];
+  struct window_rule *rules;
   int rule_count;
+  int rule_capacity;
 
   // Startup
-  char *autostart[32];
+  const char **autostart;
   int autostart_count;
+  int autostart_capacity;
 
   // Gestures
   struct gesture_touchpad *gesture_touchpad;
   int gesture_touchpad_count;
+  int gesture_touchpad_capacity;
   struct gesture_mouse *gesture_mouse;
   int gesture_mouse_count;
+  int gesture_mouse_capacity;
 
   double gesture_swipe_threshold;
   double gesture_pinch_threshold;
@@ -315,13 +386,68 @@ struct config {
 
   // Include paths
   char config_dir[256];
+
+  // Files and directories the config was read from
+  char **sources;
+  int source_count;
+
+  struct string_pool *strings;
+};
+
+/*
+ * RELOAD SECTIONS
+ * config_reload() reports which parts of the config differ from the
+ * previous load, so config_apply_live() only redoes the work they need.
+ */
+enum config_section {
+  CONFIG_SECTION_GENERAL = (1 << 0),    // gaps, focus, auto_reload, scope, steps
+  CONFIG_SECTION_BORDERS = (1 << 1),
+  CONFIG_SECTION_MODE = (1 << 2),       // general.default_mode
+  CONFIG_SECTION_KEYBOARD = (1 << 3),
+  CONFIG_SECTION_BACKGROUND = (1 << 4),
+  CONFIG_SECTION_DECOR = (1 << 5),
+  CONFIG_SECTION_ANIM = (1 << 6),
+  CONFIG_SECTION_TILING = (1 << 7),
+  CONFIG_SECTION_KEYBINDS = (1 << 8),   // keybinds and binding modes
+  CONFIG_SECTION_RULES = (1 << 9),
+  CONFIG_SECTION_AUTOSTART = (1 << 10),
+  CONFIG_SECTION_GESTURES = (1 << 11),
+  CONFIG_SECTION_XWAYLAND = (1 << 12),
+  CONFIG_SECTION_ALL = (1 << 13) - 1,
 };
 
 extern struct config config;
 
 int config_load(const char *path);
-int config_reload(void);
+int config_reload(uint32_t *changed);
+
+/*
+ * config_load() in three steps, so startup can parse on a worker thread
+ * while the backend comes up. The live config must not be read between
+ * begin and finish; finish consumes the config returned by begin.
+ */
+struct config *config_load_begin(const char *path);
+int config_load_parse(struct config *next);
+int config_load_finish(struct config *next, int parse_ret);
+
+/*
+ * config_reload() in three steps, so the parse can run off the main thread:
+ * begin and finish must be called from the main loop, parse from anywhere.
+ * finish consumes the config returned by begin.
+ */
+struct config *config_reload_begin(void);
+int config_reload_parse(struct config *next);
+int config_reload_finish(struct config *next, int parse_ret, uint32_t *changed);
 uint32_t parse_color(const char *str);
 bool parse_keybind(const char *str, uint32_t *mods, uint32_t *keysym);
+const struct keybind *keybind_lookup(int mode, uint32_t mods, uint32_t keysym);
+int binding_mode_find(const char *name);
+
+/*
+ * For building a config outside the parser (config_cache.c): intern a
+ * string in c's pool, and free every table, string and source of c.
+ */
+const char *config_intern(struct config *c, const char *str, size_t len);
+void config_free(struct config *c);
 
 #endif
@@ -0,0 +1,562 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "config_cache.h"
+#include "config.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * ============================================================================
+ * Config snapshot cache
+ * The resolved config (keysyms looked up, colors parsed, includes flattened)
+ * is written next to a fingerprint of every file and directory it came from.
+ * A load maps the snapshot, checks the fingerprints and copies the tables
+ * out; anything unexpected is a miss and the caller parses the TOML instead.
+ *
+ * The format is host-local and native-endian. The struct sizes in the
+ * header catch most layout changes, CONFIG_CACHE_VERSION the rest: bump it
+ * whenever struct config or the meaning of a parsed value changes. Values
+ * the files leave unset come from the compiled-in defaults, so a hash of
+ * those is kept too and a rebuild that changes any of them is a miss.
+ * ============================================================================
+ */
+
+#define CONFIG_CACHE_MAGIC "SVCONFIG"
+#define CONFIG_CACHE_VERSION 3
+
+struct cache_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t config_size;
+  uint32_t keybind_size;
+  uint32_t rule_size;
+  uint32_t touchpad_size;
+  uint32_t mouse_size;
+  uint32_t source_count;
+  uint32_t keybind_count;
+  uint32_t mode_count;
+  uint32_t rule_count;
+  uint32_t autostart_count;
+  uint32_t touchpad_count;
+  uint32_t mouse_count;
+  uint64_t payload_size;
+  uint64_t payload_hash;
+  uint64_t defaults_hash;
+  char path[512];
+};
+
+enum cache_source_kind {
+  CACHE_SOURCE_FILE,
+  CACHE_SOURCE_DIR,
+  CACHE_SOURCE_MISSING, // an include that did not exist at parse time
+};
+
+// Followed by path_len bytes of path
+struct cache_source {
+  uint32_t kind;
+  uint32_t path_len;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  int64_t size;
+  uint64_t ino;
+  uint64_t hash;
+};
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len) {
+  const unsigned char *p = data;
+  for (size_t i = 0; i < len; i++)
+    h = (h ^ p[i]) * 1099511628211ull; // FNV-1a
+  return h;
+}
+
+#define HASH_SEED 14695981039346656037ull
+
+static bool hash_file(const char *path, uint64_t *out) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  char buf[65536];
+  uint64_t h = HASH_SEED;
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    h = hash_bytes(h, buf, n);
+  close(fd);
+
+  *out = h;
+  return n == 0;
+}
+
+// The scalars of c with the table pointers cleared. memcpy keeps the
+// padding as it was, which a struct assignment need not.
+static void config_image(struct config *image, const struct config *c) {
+  memcpy(image, c, sizeof(*image));
+  image->keybinds = NULL;
+  image->binding_modes = NULL;
+  image->rules = NULL;
+  image->autostart = NULL;
+  image->gesture_touchpad = NULL;
+  image->gesture_mouse = NULL;
+  image->sources = NULL;
+  image->strings = NULL;
+}
+
+// Pointers are left out, they differ from run to run
+static uint64_t defaults_hash(const struct config *defaults) {
+  struct config image;
+  config_image(&image, defaults);
+  return hash_bytes(HASH_SEED, &image, sizeof(image));
+}
+
+static bool cache_file_path(const char *path, char *out, size_t size,
+                            bool create) {
+  char dir[PATH_MAX];
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+
+  // The spec says relative XDG paths are invalid and must be ignored
+  if (xdg && xdg[0] == '/')
+    snprintf(dir, sizeof(dir), "%s", xdg);
+  else if (home && home[0])
+    snprintf(dir, sizeof(dir), "%s/.cache", home);
+  else
+    return false;
+
+  if (create)
+    mkdir(dir, 0700);
+  size_t len = strlen(dir);
+  snprintf(dir + len, sizeof(dir) - len, "/starview");
+  if (create)
+    mkdir(dir, 0700);
+
+  int n = snprintf(out, size, "%s/config-%016" PRIx64 ".bin", dir,
+                   hash_bytes(HASH_SEED, path, strlen(path)));
+  return n > 0 && (size_t)n < size;
+}
+
+/*
+ * WRITING
+ */
+struct cache_buf {
+  char *data;
+  size_t len;
+  size_t cap;
+  bool failed;
+};
+
+static void buf_put(struct cache_buf *b, const void *p, size_t n) {
+  if (b->failed || n == 0)
+    return;
+  if (b->len + n > b->cap) {
+    size_t cap = b->cap ? b->cap * 2 : 16384;
+    while (cap < b->len + n)
+      cap *= 2;
+    char *data = realloc(b->data, cap);
+    if (!data) {
+      b->failed = true;
+      return;
+    }
+    b->data = data;
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+}
+
+// Length-prefixed; NULL is stored as length NO_STRING
+#define NO_STRING UINT32_MAX
+
+static void buf_put_str(struct cache_buf *b, const char *s) {
+  uint32_t len = s ? strlen(s) : NO_STRING;
+  buf_put(b, &len, sizeof(len));
+  if (s)
+    buf_put(b, s, len);
+}
+
+static bool source_fingerprint(const char *path, struct cache_source *src) {
+  memset(src, 0, sizeof(*src));
+  src->path_len = strlen(path);
+
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    src->kind = CACHE_SOURCE_MISSING;
+    return errno == ENOENT || errno == ENOTDIR;
+  }
+
+  src->mtime_sec = st.st_mtim.tv_sec;
+  src->mtime_nsec = st.st_mtim.tv_nsec;
+  if (S_ISDIR(st.st_mode)) {
+    src->kind = CACHE_SOURCE_DIR;
+    return true;
+  }
+
+  src->kind = CACHE_SOURCE_FILE;
+  src->size = st.st_size;
+  src->ino = st.st_ino;
+  return S_ISREG(st.st_mode) && hash_file(path, &src->hash);
+}
+
+void config_cache_store(const struct config *c,
+                        const struct config *defaults, const char *path,
+                        time_t parse_start) {
+  char file[PATH_MAX];
+  if (strlen(path) >= sizeof(((struct cache_header *)0)->path) ||
+      !cache_file_path(path, file, sizeof(file), true))
+    return;
+
+  struct cache_header header = {
+      .version = CONFIG_CACHE_VERSION,
+      .config_size = sizeof(struct config),
+      .keybind_size = sizeof(struct keybind),
+      .rule_size = sizeof(struct window_rule),
+      .touchpad_size = sizeof(struct gesture_touchpad),
+      .mouse_size = sizeof(struct gesture_mouse),
+      .source_count = c->source_count,
+      .keybind_count = c->keybind_count,
+      .mode_count = c->binding_mode_count,
+      .rule_count = c->rule_count,
+      .autostart_count = c->autostart_count,
+      .touchpad_count = c->gesture_touchpad_count,
+      .mouse_count = c->gesture_mouse_count,
+      .defaults_hash = defaults_hash(defaults),
+  };
+  memcpy(header.magic, CONFIG_CACHE_MAGIC, sizeof(header.magic));
+  strcpy(header.path, path);
+
+  struct cache_buf buf = {0};
+  buf_put(&buf, &header, sizeof(header));
+
+  for (int i = 0; i < c->source_count; i++) {
+    struct cache_source src;
+    if (!source_fingerprint(c->sources[i], &src))
+      goto out;
+
+    // mtimes are coarse: an edit racing the parse could look older than it
+    if (src.kind != CACHE_SOURCE_MISSING && src.mtime_sec >= parse_start - 1)
+      goto out;
+
+    buf_put(&buf, &src, sizeof(src));
+    buf_put(&buf, c->sources[i], src.path_len);
+  }
+
+  // Scalars as-is; the tables follow with their strings written inline
+  struct config image;
+  config_image(&image, c);
+  buf_put(&buf, &image, sizeof(image));
+
+  for (int i = 0; i < c->keybind_count; i++) {
+    struct keybind kb = c->keybinds[i];
+    kb.arg = NULL;
+    buf_put(&buf, &kb, sizeof(kb));
+    buf_put_str(&buf, c->keybinds[i].arg);
+  }
+  for (int i = 0; i < c->binding_mode_count; i++) {
+    uint32_t oneshot = c->binding_modes[i].oneshot;
+    buf_put(&buf, &oneshot, sizeof(oneshot));
+    buf_put_str(&buf, c->binding_modes[i].name);
+  }
+  for (int i = 0; i < c->rule_count; i++) {
+    struct window_rule rule = c->rules[i];
+    rule.app_id = rule.title = NULL;
+    buf_put(&buf, &rule, sizeof(rule));
+    buf_put_str(&buf, c->rules[i].app_id);
+    buf_put_str(&buf, c->rules[i].title);
+  }
+  for (int i = 0; i < c->autostart_count; i++)
+    buf_put_str(&buf, c->autostart[i]);
+  for (int i = 0; i < c->gesture_touchpad_count; i++) {
+    struct gesture_touchpad g = c->gesture_touchpad[i];
+    g.action.arg = NULL;
+    buf_put(&buf, &g, sizeof(g));
+    buf_put_str(&buf, c->gesture_touchpad[i].action.arg);
+  }
+  for (int i = 0; i < c->gesture_mouse_count; i++) {
+    struct gesture_mouse g = c->gesture_mouse[i];
+    g.action.arg = NULL;
+    buf_put(&buf, &g, sizeof(g));
+    buf_put_str(&buf, c->gesture_mouse[i].action.arg);
+  }
+
+  if (buf.failed)
+    goto out;
+
+  struct cache_header *h = (struct cache_header *)buf.data;
+  h->payload_size = buf.len - sizeof(header);
+  h->payload_hash =
+      hash_bytes(HASH_SEED, buf.data + sizeof(header), h->payload_size);
+
+  // Write aside and rename, so readers never map a partial snapshot
+  char tmp[PATH_MAX + 8];
+  snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file);
+  int fd = mkstemp(tmp);
+  if (fd < 0)
+    goto out;
+
+  size_t off = 0;
+  while (off < buf.len) {
+    ssize_t n = write(fd, buf.data + off, buf.len - off);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    off += n;
+  }
+  if (close(fd) != 0 || off != buf.len || rename(tmp, file) != 0) {
+    fprintf(stderr, "Config cache: cannot write %s\n", file);
+    unlink(tmp);
+  }
+
+out:
+  free(buf.data);
+}
+
+/*
+ * READING
+ */
+struct cache_cursor {
+  const char *p;
+  const char *end;
+};
+
+static const void *cursor_take(struct cache_cursor *cur, size_t n) {
+  if ((size_t)(cur->end - cur->p) < n)
+    return NULL;
+  const void *p = cur->p;
+  cur->p += n;
+  return p;
+}
+
+// Copy a struct out of the map; the map has no alignment guarantees
+static bool cursor_copy(struct cache_cursor *cur, void *dst, size_t n) {
+  const void *p = cursor_take(cur, n);
+  if (p)
+    memcpy(dst, p, n);
+  return p != NULL;
+}
+
+// Intern a stored string into c's pool; *out is NULL for a stored NULL
+static bool cursor_take_str(struct cache_cursor *cur, struct config *c,
+                            const char **out) {
+  uint32_t len;
+  if (!cursor_copy(cur, &len, sizeof(len)))
+    return false;
+  if (len == NO_STRING) {
+    *out = NULL;
+    return true;
+  }
+
+  const char *s = cursor_take(cur, len);
+  return s && (*out = config_intern(c, s, len)) != NULL;
+}
+
+static bool source_unchanged(const struct cache_source *src, const char *path) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return src->kind == CACHE_SOURCE_MISSING &&
+           (errno == ENOENT || errno == ENOTDIR);
+
+  switch (src->kind) {
+  case CACHE_SOURCE_DIR:
+    // Adding, removing or renaming an entry bumps the directory mtime
+    return S_ISDIR(st.st_mode) && st.st_mtim.tv_sec == src->mtime_sec &&
+           st.st_mtim.tv_nsec == src->mtime_nsec;
+  case CACHE_SOURCE_FILE: {
+    if (!S_ISREG(st.st_mode) || st.st_size != src->size)
+      return false;
+    if (st.st_mtim.tv_sec == src->mtime_sec &&
+        st.st_mtim.tv_nsec == src->mtime_nsec && st.st_ino == src->ino)
+      return true;
+
+    // Touched or rewritten: only the contents matter
+    uint64_t hash;
+    return hash_file(path, &hash) && hash == src->hash;
+  }
+  default:
+    return false;
+  }
+}
+
+static int cache_read(struct config *target, const struct config *defaults,
+                      const char *path, const char *data, size_t size) {
+  struct cache_header h;
+  memcpy(&h, data, sizeof(h));
+
+  if (memcmp(h.magic, CONFIG_CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+      h.version != CONFIG_CACHE_VERSION ||
+      h.config_size != sizeof(struct config) ||
+      h.keybind_size != sizeof(struct keybind) ||
+      h.rule_size != sizeof(struct window_rule) ||
+      h.touchpad_size != sizeof(struct gesture_touchpad) ||
+      h.mouse_size != sizeof(struct gesture_mouse) ||
+      h.payload_size != size - sizeof(h) ||
+      h.defaults_hash != defaults_hash(defaults) ||
+      strncmp(h.path, path, sizeof(h.path)) != 0)
+    return -1;
+
+  // Every entry takes at least a byte, which also keeps counts within int
+  if (h.source_count > h.payload_size || h.keybind_count > h.payload_size ||
+      h.mode_count > h.payload_size || h.rule_count > h.payload_size ||
+      h.autostart_count > h.payload_size ||
+      h.touchpad_count > h.payload_size || h.mouse_count > h.payload_size)
+    return -1;
+
+  struct cache_cursor cur = {data + sizeof(h), data + size};
+  if (hash_bytes(HASH_SEED, cur.p, h.payload_size) != h.payload_hash)
+    return -1;
+
+  // Zeroed pointers so config_free() works at every step
+  struct config c = {0};
+  c.sources = calloc(h.source_count ? h.source_count : 1, sizeof(char *));
+  if (!c.sources)
+    return -1;
+
+  for (uint32_t i = 0; i < h.source_count; i++) {
+    struct cache_source src;
+    const void *p = cursor_take(&cur, sizeof(src));
+    if (!p)
+      goto miss;
+    memcpy(&src, p, sizeof(src));
+
+    const char *name = cursor_take(&cur, src.path_len);
+    if (!name || !(c.sources[i] = strndup(name, src.path_len)))
+      goto miss;
+    c.source_count++;
+
+    if (!source_unchanged(&src, c.sources[i]))
+      goto miss;
+  }
+
+  // Every source is as it was: take the snapshot
+  char **sources = c.sources;
+  int source_count = c.source_count;
+  bool ok = cursor_copy(&cur, &c, sizeof(c));
+
+  // Only the scalars of the image are meaningful
+  c.keybinds = NULL;
+  c.keybind_count = c.keybind_capacity = 0;
+  c.binding_modes = NULL;
+  c.binding_mode_count = c.binding_mode_capacity = 0;
+  c.rules = NULL;
+  c.rule_count = c.rule_capacity = 0;
+  c.autostart = NULL;
+  c.autostart_count = c.autostart_capacity = 0;
+  c.gesture_touchpad = NULL;
+  c.gesture_touchpad_count = c.gesture_touchpad_capacity = 0;
+  c.gesture_mouse = NULL;
+  c.gesture_mouse_count = c.gesture_mouse_capacity = 0;
+  c.strings = NULL;
+  c.sources = sources;
+  c.source_count = source_count;
+  if (!ok)
+    goto miss;
+
+  // Tables are allocated at their exact size, one extra to avoid malloc(0)
+  if (!(c.keybinds = calloc(h.keybind_count + 1, sizeof(*c.keybinds))))
+    goto miss;
+  c.keybind_capacity = h.keybind_count + 1;
+  for (uint32_t i = 0; i < h.keybind_count; i++) {
+    struct keybind *kb = &c.keybinds[i];
+    if (!cursor_copy(&cur, kb, sizeof(*kb)) ||
+        !cursor_take_str(&cur, &c, &kb->arg) || !kb->arg)
+      goto miss;
+    c.keybind_count++;
+  }
+
+  if (!(c.binding_modes = calloc(h.mode_count + 1, sizeof(*c.binding_modes))))
+    goto miss;
+  c.binding_mode_capacity = h.mode_count + 1;
+  for (uint32_t i = 0; i < h.mode_count; i++) {
+    uint32_t oneshot;
+    struct binding_mode *mode = &c.binding_modes[i];
+    if (!cursor_copy(&cur, &oneshot, sizeof(oneshot)) ||
+        !cursor_take_str(&cur, &c, &mode->name) || !mode->name)
+      goto miss;
+    mode->oneshot = oneshot;
+    c.binding_mode_count++;
+  }
+
+  if (!(c.rules = calloc(h.rule_count + 1, sizeof(*c.rules))))
+    goto miss;
+  c.rule_capacity = h.rule_count + 1;
+  for (uint32_t i = 0; i < h.rule_count; i++) {
+    struct window_rule *rule = &c.rules[i];
+    if (!cursor_copy(&cur, rule, sizeof(*rule)) ||
+        !cursor_take_str(&cur, &c, &rule->app_id) ||
+        !cursor_take_str(&cur, &c, &rule->title))
+      goto miss;
+    c.rule_count++;
+  }
+
+  if (!(c.autostart = calloc(h.autostart_count + 1, sizeof(*c.autostart))))
+    goto miss;
+  c.autostart_capacity = h.autostart_count + 1;
+  for (uint32_t i = 0; i < h.autostart_count; i++) {
+    if (!cursor_take_str(&cur, &c, &c.autostart[i]) || !c.autostart[i])
+      goto miss;
+    c.autostart_count++;
+  }
+
+  if (!(c.gesture_touchpad =
+            calloc(h.touchpad_count + 1, sizeof(*c.gesture_touchpad))))
+    goto miss;
+  c.gesture_touchpad_capacity = h.touchpad_count + 1;
+  for (uint32_t i = 0; i < h.touchpad_count; i++) {
+    struct gesture_touchpad *g = &c.gesture_touchpad[i];
+    if (!cursor_copy(&cur, g, sizeof(*g)) ||
+        !cursor_take_str(&cur, &c, &g->action.arg) || !g->action.arg)
+      goto miss;
+    c.gesture_touchpad_count++;
+  }
+
+  if (!(c.gesture_mouse = calloc(h.mouse_count + 1, sizeof(*c.gesture_mouse))))
+    goto miss;
+  c.gesture_mouse_capacity = h.mouse_count + 1;
+  for (uint32_t i = 0; i < h.mouse_count; i++) {
+    struct gesture_mouse *g = &c.gesture_mouse[i];
+    if (!cursor_copy(&cur, g, sizeof(*g)) ||
+        !cursor_take_str(&cur, &c, &g->action.arg) || !g->action.arg)
+      goto miss;
+    c.gesture_mouse_count++;
+  }
+
+  if (cur.p != cur.end)
+    goto miss;
+
+  *target = c;
+  return 0;
+
+miss:
+  config_free(&c);
+  return -1;
+}
+
+int config_cache_load(struct config *target, const struct config *defaults,
+                      const char *path) {
+  char file[PATH_MAX];
+  if (!cache_file_path(path, file, sizeof(file), false))
+    return -1;
+
+  int fd = open(file, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct cache_header))
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  int ret = cache_read(target, defaults, path, map, st.st_size);
+  munmap(map, st.st_size);
+  return ret;
+}
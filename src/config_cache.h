@@ -0,0 +1,26 @@
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+#include <time.h>
+
+struct config;
+
+/*
+ * Binary snapshot of a fully parsed config in $XDG_CACHE_HOME/starview,
+ * keyed by the config path, the state of every source it was read from and
+ * the defaults the parse started from. Both calls are made from config_parse() under its lock.
+ */
+
+/* Fill target from the cache if every source is unchanged. 0 on a hit. */
+int config_cache_load(struct config *target, const struct config *defaults,
+                      const char *path);
+
+/*
+ * Snapshot a config parsed from path. Skipped if any source was modified
+ * after (or too close to) parse_start, since the parse may predate it.
+ */
+void config_cache_store(const struct config *c,
+                        const struct config *defaults, const char *path,
+                        time_t parse_start);
+
+#endif
@@ -6,55 +6,96 @@
 #include "background.h"
 #include "titlebar_render.h"
 #include "config_live.h"
+#include "ipc.h"
 #include <stdio.h>
 
-void config_apply_live(struct server *server) {
+void config_apply_live(struct server *server, uint32_t changed) {
     if (!server) return;
 
-    printf("[LIVE] Applying config changes...\n");
+    // The include tree may have changed even when no setting did
+    config_watch_sync();
 
-    /* 1. Update titlebar theme */
-    struct titlebar_theme *theme = titlebar_get_global_theme();
-    if (theme) {
-        titlebar_theme_load_from_config(theme, &config.decor);
-        printf("[LIVE] Titlebar theme updated\n");
+    // Every reload replaces the rule table, changed or not
+    window_rules_reset();
+
+    if (!changed) {
+        printf("[LIVE] Config unchanged\n");
+        return;
+    }
+    printf("[LIVE] Applying config changes (0x%03x)...\n", changed);
+
+    /* 1. Update titlebar theme; bumps the generation so titlebars redraw */
+    if (changed & CONFIG_SECTION_DECOR) {
+        struct titlebar_theme *theme = titlebar_get_global_theme();
+        if (theme) {
+            titlebar_theme_load_from_config(theme, &config.decor);
+            printf("[LIVE] Titlebar theme updated\n");
+        }
     }
 
     /* 2. Update all decorations */
-    struct toplevel *toplevel;
-    wl_list_for_each(toplevel, &server->toplevels, link) {
-        bool focused = (toplevel == get_focused_toplevel(server));
-        if (config.decor.enabled && !toplevel->decor.tree)
-            decor_create(toplevel);
-        else if (!config.decor.enabled && toplevel->decor.tree)
-            decor_destroy(toplevel);
-        if (toplevel->decor.tree) {
-            struct wlr_box geo;
-            wlr_xdg_surface_get_geometry(toplevel->xdg_toplevel->base, &geo);
-            decor_set_size(toplevel, geo.width);
-            decor_update(toplevel, focused);
+    if (changed & (CONFIG_SECTION_DECOR | CONFIG_SECTION_BORDERS)) {
+        struct toplevel *focused = get_focused_toplevel(server);
+        struct toplevel *toplevel;
+        wl_list_for_each(toplevel, &server->toplevels, link) {
+            if (config.decor.enabled && !toplevel->decor.tree)
+                decor_create(toplevel);
+            else if (!config.decor.enabled && toplevel->decor.tree)
+                decor_destroy(toplevel);
+            if (toplevel->decor.tree) {
+                struct wlr_box geo;
+                wlr_xdg_surface_get_geometry(toplevel->xdg_toplevel->base, &geo);
+                decor_set_size(toplevel, geo.width);
+                decor_update(toplevel, toplevel == focused);
+            }
         }
+        printf("[LIVE] Decorations updated\n");
     }
-    printf("[LIVE] Decorations updated\n");
 
     /* 3. Update backgrounds */
-    struct output *output;
-    wl_list_for_each(output, &server->outputs, link) {
-        if (config.background.enabled) {
-            int w = output->wlr_output->width;
-            int h = output->wlr_output->height;
-            if (output->background)
-                background_update(output->background, w, h, &config.background);
-            else
-                output->background = background_create(server->layer_bg, w, h, &config.background);
-        } else if (output->background) {
-            wlr_scene_node_set_enabled(&output->background->node, false);
+    if (changed & CONFIG_SECTION_BACKGROUND) {
+        struct output *output;
+        wl_list_for_each(output, &server->outputs, link) {
+            if (config.background.enabled) {
+                int w = output->wlr_output->width;
+                int h = output->wlr_output->height;
+                if (output->background)
+                    background_update(output->background, w, h, &config.background);
+                else
+                    output->background = background_create(server->layer_bg, w, h, &config.background);
+                if (output->background)
+                    wlr_scene_node_set_enabled(&output->background->node, true);
+            } else if (output->background) {
+                wlr_scene_node_set_enabled(&output->background->node, false);
+            }
         }
+        printf("[LIVE] Backgrounds updated\n");
+    }
+
+    /* 4. Keymap and repeat (cached keymaps make this free when unchanged) */
+    if (changed & CONFIG_SECTION_KEYBOARD) {
+        struct keyboard *keyboard;
+        wl_list_for_each(keyboard, &server->keyboards, link)
+            keyboard_apply_config(keyboard->wlr_keyboard);
+        keymap_cache_prune(server);
+    }
+
+    /* 5. Binding mode indices are only stable while the table is */
+    if (changed & CONFIG_SECTION_KEYBINDS)
+        server->binding_mode = BINDING_MODE_DEFAULT;
+
+    /* 6. Mode + layout */
+    if (changed & CONFIG_SECTION_MODE && server->mode != config.default_mode) {
+        server->mode = config.default_mode;
+        ipc_event_mode(server);
     }
-    printf("[LIVE] Backgrounds updated\n");
+    if (changed & (CONFIG_SECTION_GENERAL | CONFIG_SECTION_BORDERS |
+                   CONFIG_SECTION_DECOR | CONFIG_SECTION_MODE |
+                   CONFIG_SECTION_TILING))
+        arrange_windows(server);
 
-    /* 4. Mode + layout */
-    server->mode = config.default_mode;
-    arrange_windows(server);
+    /* 7. Restarting Xwayland would drop every X11 client and DISPLAY */
+    if (changed & CONFIG_SECTION_XWAYLAND)
+        printf("[LIVE] XWayland settings take effect on the next start\n");
     printf("[LIVE] Done\n");
 }
@@ -1,9 +1,16 @@
 #ifndef CONFIG_LIVE_H
 #define CONFIG_LIVE_H
 
+#include <stdint.h>
+
 struct server;
 
-/* Apply config changes live after config_reload(). */
-void config_apply_live(struct server *server);
+/* Apply the sections config_reload() reported as changed. */
+void config_apply_live(struct server *server, uint32_t changed);
+
+/* config_watch.c: reload automatically when a config source changes. */
+int config_watch_init(struct server *server);
+void config_watch_sync(void);
+void config_watch_finish(void);
 
 #endif
@@ -0,0 +1,279 @@
+#define _GNU_SOURCE
+#define WLR_USE_UNSTABLE
+
+#include "background.h"
+#include "config.h"
+#include "config_live.h"
+#include "core.h"
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+/*
+ * ============================================================================
+ * Automatic config reload
+ * Every file and directory the last parse read is watched through its
+ * directory, since editors usually save by writing a temporary file and
+ * renaming it over the original. Bursts of events are debounced, the parse
+ * runs on a worker thread, and the result is diffed and applied back on the
+ * main loop, so saving the config never stalls input or rendering.
+ * ============================================================================
+ */
+
+#define CONFIG_WATCH_DEBOUNCE_MS 150
+#define CONFIG_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE)
+
+struct watched_dir {
+    int wd;
+    char *path;
+};
+
+static struct {
+    struct server *server;
+    int inotify_fd;
+    struct wl_event_source *inotify_source;
+    struct wl_event_source *debounce;
+
+    struct watched_dir *dirs;
+    int dir_count;
+
+    // Worker state; result and parse_ret are handed over through done_fd
+    pthread_t worker;
+    bool running;
+    bool again;
+    int done_fd;
+    struct wl_event_source *done_source;
+    struct config *result;
+    int parse_ret;
+} watch = { .inotify_fd = -1, .done_fd = -1 };
+
+static bool is_config_dir(const char *path) {
+    for (int i = 0; i < config.source_count; i++) {
+        struct stat st;
+        if (strcmp(config.sources[i], path) == 0)
+            return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+    return false;
+}
+
+// Does a change to dir/name affect the config?
+static bool is_relevant(const char *dir, const char *name) {
+    if (!name[0]) return false;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    for (int i = 0; i < config.source_count; i++) {
+        if (strcmp(config.sources[i], path) == 0) return true;
+    }
+
+    // Any visible .toml in an included directory; skips swap and backup files
+    size_t len = strlen(name);
+    return name[0] != '.' && len > 5 && strcmp(name + len - 5, ".toml") == 0 &&
+           is_config_dir(dir);
+}
+
+static void *config_watch_worker(void *data) {
+    struct config *next = data;
+    watch.parse_ret = config_reload_parse(next);
+    // A new wallpaper decodes here rather than in config_apply_live()
+    if (watch.parse_ret == 0) background_preload(&next->background);
+    watch.result = next;
+
+    uint64_t one = 1;
+    ssize_t n = write(watch.done_fd, &one, sizeof(one));
+    (void)n;
+    return NULL;
+}
+
+static int config_watch_start_parse(void *data) {
+    (void)data;
+    if (!config.auto_reload) return 0;
+
+    // One parse at a time; a change during the parse triggers another
+    if (watch.running) {
+        watch.again = true;
+        return 0;
+    }
+
+    struct config *next = config_reload_begin();
+    if (!next) return 0;
+
+    watch.running = true;
+    watch.again = false;
+    if (pthread_create(&watch.worker, NULL, config_watch_worker, next) != 0) {
+        // No thread available: parse inline rather than not at all
+        watch.running = false;
+        uint32_t changed;
+        if (config_reload_finish(next, config_reload_parse(next), &changed) == 0)
+            config_apply_live(watch.server, changed);
+    }
+    return 0;
+}
+
+static int config_watch_handle_done(int fd, uint32_t mask, void *data) {
+    (void)mask;
+    (void)data;
+
+    uint64_t count;
+    ssize_t n = read(fd, &count, sizeof(count));
+    (void)n;
+    if (!watch.running) return 0;
+
+    pthread_join(watch.worker, NULL);
+    watch.running = false;
+
+    uint32_t changed;
+    if (config_reload_finish(watch.result, watch.parse_ret, &changed) == 0)
+        config_apply_live(watch.server, changed);
+    watch.result = NULL;
+
+    if (watch.again)
+        wl_event_source_timer_update(watch.debounce, CONFIG_WATCH_DEBOUNCE_MS);
+    return 0;
+}
+
+static int config_watch_handle_inotify(int fd, uint32_t mask, void *data) {
+    (void)mask;
+    (void)data;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool relevant = false;
+
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *ptr = buf; ptr < buf + len;) {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(*event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                relevant = true;
+                continue;
+            }
+            for (int i = 0; i < watch.dir_count && !relevant; i++) {
+                if (watch.dirs[i].wd == event->wd)
+                    relevant = is_relevant(watch.dirs[i].path, event->len ? event->name : "");
+            }
+        }
+    }
+
+    // Trailing-edge debounce: every event pushes the parse back
+    if (relevant && config.auto_reload)
+        wl_event_source_timer_update(watch.debounce, CONFIG_WATCH_DEBOUNCE_MS);
+    return 0;
+}
+
+static void watched_dir_add(struct watched_dir **dirs, int *count, const char *path) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp((*dirs)[i].path, path) == 0) return;
+    }
+
+    int wd = inotify_add_watch(watch.inotify_fd, path, CONFIG_WATCH_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        // A missing include's directory may not exist yet either
+        if (errno != ENOENT)
+            fprintf(stderr, "Config watch: %s: %s\n", path, strerror(errno));
+        return;
+    }
+
+    struct watched_dir *grown = realloc(*dirs, (*count + 1) * sizeof(*grown));
+    if (!grown) return;
+    *dirs = grown;
+    grown[*count].wd = wd;
+    grown[*count].path = strdup(path);
+    (*count)++;
+}
+
+void config_watch_sync(void) {
+    if (watch.inotify_fd < 0) return;
+
+    struct watched_dir *dirs = NULL;
+    int count = 0;
+    for (int i = 0; i < config.source_count; i++) {
+        const char *source = config.sources[i];
+        struct stat st;
+        if (stat(source, &st) == 0 && S_ISDIR(st.st_mode)) {
+            watched_dir_add(&dirs, &count, source);
+            continue;
+        }
+
+        char parent[PATH_MAX];
+        snprintf(parent, sizeof(parent), "%s", source);
+        char *slash = strrchr(parent, '/');
+        if (slash == parent) slash[1] = '\0';
+        else if (slash) *slash = '\0';
+        else snprintf(parent, sizeof(parent), ".");
+        watched_dir_add(&dirs, &count, parent);
+    }
+
+    // inotify hands out the same wd for a directory watched twice, so only
+    // directories that fell out of the include tree are dropped
+    for (int i = 0; i < watch.dir_count; i++) {
+        bool kept = false;
+        for (int j = 0; j < count && !kept; j++)
+            kept = dirs[j].wd == watch.dirs[i].wd;
+        if (!kept) inotify_rm_watch(watch.inotify_fd, watch.dirs[i].wd);
+        free(watch.dirs[i].path);
+    }
+    free(watch.dirs);
+    watch.dirs = dirs;
+    watch.dir_count = count;
+}
+
+int config_watch_init(struct server *server) {
+    watch.server = server;
+
+    watch.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch.inotify_fd < 0) {
+        perror("Config watch: inotify_init1");
+        return -1;
+    }
+    watch.done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (watch.done_fd < 0) {
+        perror("Config watch: eventfd");
+        close(watch.inotify_fd);
+        watch.inotify_fd = -1;
+        return -1;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    watch.inotify_source = wl_event_loop_add_fd(loop, watch.inotify_fd,
+        WL_EVENT_READABLE, config_watch_handle_inotify, NULL);
+    watch.done_source = wl_event_loop_add_fd(loop, watch.done_fd,
+        WL_EVENT_READABLE, config_watch_handle_done, NULL);
+    watch.debounce = wl_event_loop_add_timer(loop, config_watch_start_parse, NULL);
+
+    config_watch_sync();
+    printf("Config watch: %d directories\n", watch.dir_count);
+    return 0;
+}
+
+void config_watch_finish(void) {
+    if (watch.running) {
+        pthread_join(watch.worker, NULL);
+        watch.running = false;
+        // Passing a failed status just frees the unapplied result
+        config_reload_finish(watch.result, -1, NULL);
+        watch.result = NULL;
+    }
+
+    if (watch.debounce) wl_event_source_remove(watch.debounce);
+    if (watch.inotify_source) wl_event_source_remove(watch.inotify_source);
+    if (watch.done_source) wl_event_source_remove(watch.done_source);
+    watch.debounce = watch.inotify_source = watch.done_source = NULL;
+
+    for (int i = 0; i < watch.dir_count; i++) free(watch.dirs[i].path);
+    free(watch.dirs);
+    watch.dirs = NULL;
+    watch.dir_count = 0;
+
+    if (watch.inotify_fd >= 0) close(watch.inotify_fd);
+    if (watch.done_fd >= 0) close(watch.done_fd);
+    watch.inotify_fd = watch.done_fd = -1;
+}
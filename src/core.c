@@ -1,7 +1,10 @@
 #include "core.h"
 #include "background.h"
+#include "ipc.h"
+#include "startup.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
@@ -13,6 +16,7 @@
 #include "core.h"
 #include <stdlib.h>
 #include <wlr/xwayland.h>
+#include <wlr/xwayland/server.h>
 #include <wlr/xwayland/shell.h>
 #include <wlr/types/wlr_text_input_v3.h>
 #include <wlr/types/wlr_input_method_v2.h>
@@ -246,17 +250,22 @@ static void xwayland_surface_associate(struct wl_listener *listener, void *data)
 }
 
 static void xwayland_surface_dissociate(struct wl_listener *listener, void *data) {
-  struct xwayland_surface *xsurface = wl_container_of(listener, xsurface, unmap);
+  struct xwayland_surface *xsurface =
+      wl_container_of(listener, xsurface, dissociate);
   (void)data;
   
   printf("XWayland surface dissociated\n");
-  
-  // Remove listeners for map/unmap if they were added
+
+  // When Xwayland exits every surface goes at once, possibly still mapped
+  if (xsurface->scene_tree) {
+    xwayland_surface_unmap(&xsurface->unmap, NULL);
+  }
+
+  // The wlr_surface may outlive the association, so stop listening to it
   wl_list_remove(&xsurface->surface_map.link);
   wl_list_init(&xsurface->surface_map.link);
-  
-  // The unmap listener removal is tricky - only remove if it was added
-  // during associate (not during creation)
+  wl_list_remove(&xsurface->unmap.link);
+  wl_list_init(&xsurface->unmap.link);
 }
 
 static void xwayland_surface_map(struct wl_listener *listener, void *data) {
@@ -302,8 +311,10 @@ static void xwayland_surface_map(struct wl_listener *listener, void *data) {
                               xsurface->xwayland_surface->y);
 
   // Create decorations for non-OR windows
+  bool placed = false;
   if (!xsurface->override_redirect) {
     xwayland_decor_create(xsurface);
+    placed = apply_xwayland_rules(xsurface);
   }
 
   // For dialogs with a parent, position relative to parent
@@ -332,7 +343,7 @@ static void xwayland_surface_map(struct wl_listener *listener, void *data) {
   if (!xsurface->floating && !xsurface->override_redirect &&
       xsurface->server->mode == MODE_TILING) {
     arrange_windows(xsurface->server);
-  } else if (xsurface->floating) {
+  } else if (xsurface->floating && !placed) {
     // Center floating windows
     struct output *output;
     wl_list_for_each(output, &xsurface->server->outputs, link) {
@@ -356,6 +367,11 @@ static void xwayland_surface_map(struct wl_listener *listener, void *data) {
     }
   }
 
+  if (!xsurface->override_redirect) {
+    ipc_xwayland_mark_dirty(xsurface);
+    ipc_event_xwindow(xsurface->server, xsurface, "new");
+  }
+
   printf("XWayland surface mapped: %s (%s) at %d,%d [OR=%d popup=%d dialog=%d]\n",
          xsurface->xwayland_surface->title ? xsurface->xwayland_surface->title : "null",
          xsurface->xwayland_surface->class ? xsurface->xwayland_surface->class : "null",
@@ -381,9 +397,18 @@ static void xwayland_surface_unmap(struct wl_listener *listener, void *data) {
     cursor_state.toplevel = NULL;
   }
 
+  // The close event describes the window as it was shown
+  if (!xsurface->override_redirect) {
+    ipc_xwayland_mark_dirty(xsurface);
+    ipc_event_xwindow(xsurface->server, xsurface, "close");
+  }
+
   // Destroy decorations first
   xwayland_decor_destroy(xsurface);
 
+  // Rules apply afresh if the window is mapped again
+  rule_history_finish(&xsurface->rules_applied);
+
   // The scene_tree for XWayland is managed by wlroots
   // It gets destroyed automatically when the surface is unmapped
   // We just clear our pointer
@@ -402,6 +427,8 @@ static void xwayland_surface_destroy(struct wl_listener *listener, void *data) {
 
   printf("XWayland surface destroying: %p\n", (void*)xsurface->xwayland_surface);
 
+  ipc_xwayland_destroy(xsurface);
+
   // Clear any cursor state references
   if (cursor_state.xwayland == xsurface) {
     cursor_state.mode = CURSOR_NORMAL;
@@ -415,8 +442,18 @@ static void xwayland_surface_destroy(struct wl_listener *listener, void *data) {
   // Scene tree is managed by wlroots
   xsurface->scene_tree = NULL;
 
+  // Dialogs of this window outlive it
+  struct xwayland_surface *child;
+  wl_list_for_each(child, &xsurface->server->xwayland_surfaces, link) {
+    if (child->parent == xsurface) {
+      child->parent = NULL;
+      child->is_dialog = false;
+    }
+  }
+
   // Remove all listeners safely
   wl_list_remove(&xsurface->map.link);
+  wl_list_remove(&xsurface->dissociate.link);
   wl_list_remove(&xsurface->destroy.link);
   wl_list_remove(&xsurface->request_configure.link);
   wl_list_remove(&xsurface->request_fullscreen.link);
@@ -440,6 +477,7 @@ static void xwayland_surface_destroy(struct wl_listener *listener, void *data) {
     wl_list_remove(&xsurface->surface_map.link);
   }
 
+  rule_history_finish(&xsurface->rules_applied);
   free(xsurface);
 }
 
@@ -477,13 +515,10 @@ static void xwayland_surface_request_configure(struct wl_listener *listener,
   }
 }
 
-static void xwayland_surface_request_fullscreen(struct wl_listener *listener,
-                                                void *data) {
-  struct xwayland_surface *xsurface =
-      wl_container_of(listener, xsurface, request_fullscreen);
-
-  bool fullscreen = xsurface->xwayland_surface->fullscreen;
+void xwayland_surface_set_fullscreen(struct xwayland_surface *xsurface,
+                                      bool fullscreen) {
   xsurface->fullscreen = fullscreen;
+  wlr_xwayland_surface_set_fullscreen(xsurface->xwayland_surface, fullscreen);
 
   if (fullscreen) {
     // Save current state
@@ -528,6 +563,16 @@ static void xwayland_surface_request_fullscreen(struct wl_listener *listener,
   }
 }
 
+static void xwayland_surface_request_fullscreen(struct wl_listener *listener,
+                                                void *data) {
+  struct xwayland_surface *xsurface =
+      wl_container_of(listener, xsurface, request_fullscreen);
+  (void)data;
+
+  xwayland_surface_set_fullscreen(xsurface,
+                                  xsurface->xwayland_surface->fullscreen);
+}
+
 static void xwayland_surface_request_minimize(struct wl_listener *listener,
                                               void *data) {
   struct xwayland_surface *xsurface =
@@ -556,6 +601,7 @@ static void xwayland_surface_request_activate(struct wl_listener *listener,
     return;
   }
 
+  bool changed = xsurface != xwayland_get_focused(xsurface->server);
   wlr_xwayland_surface_activate(xwayland_surface, true);
   
   if (xsurface->server->seat) {
@@ -563,6 +609,9 @@ static void xwayland_surface_request_activate(struct wl_listener *listener,
                                     xwayland_surface->surface,
                                     NULL, 0, NULL);
   }
+  if (changed) {
+    ipc_event_xwindow(xsurface->server, xsurface, "focus");
+  }
   
   // Update decoration focus
   xwayland_decor_update(xsurface, true);
@@ -585,6 +634,12 @@ static void xwayland_surface_set_title(struct wl_listener *listener,
     printf("XWayland title changed: %s\n", xsurface->xwayland_surface->title);
     xwayland_decor_update(xsurface, true);
   }
+
+  if (xsurface->scene_tree && !xsurface->override_redirect) {
+    ipc_xwayland_mark_dirty(xsurface);
+    ipc_event_xwindow(xsurface->server, xsurface, "title");
+    xwayland_rules_changed(xsurface);
+  }
 }
 
 static void xwayland_surface_set_class(struct wl_listener *listener,
@@ -596,6 +651,11 @@ static void xwayland_surface_set_class(struct wl_listener *listener,
   if (xsurface->xwayland_surface->class) {
     printf("XWayland class changed: %s\n", xsurface->xwayland_surface->class);
   }
+
+  if (xsurface->scene_tree && !xsurface->override_redirect) {
+    ipc_xwayland_mark_dirty(xsurface);
+    xwayland_rules_changed(xsurface);
+  }
 }
 
 static void xwayland_surface_set_parent(struct wl_listener *listener,
@@ -773,10 +833,8 @@ static void server_new_xwayland_surface(struct wl_listener *listener,
   xsurface->map.notify = xwayland_surface_associate;
   wl_signal_add(&xwayland_surface->events.associate, &xsurface->map);
 
-  // dissociate listener uses unmap member
-  struct wl_listener dissociate_listener;
-  dissociate_listener.notify = xwayland_surface_dissociate;
-  wl_signal_add(&xwayland_surface->events.dissociate, &dissociate_listener);
+  xsurface->dissociate.notify = xwayland_surface_dissociate;
+  wl_signal_add(&xwayland_surface->events.dissociate, &xsurface->dissociate);
 
   xsurface->destroy.notify = xwayland_surface_destroy;
   wl_signal_add(&xwayland_surface->events.destroy, &xsurface->destroy);
@@ -855,11 +913,40 @@ static void xwayland_ready(struct wl_listener *listener, void *data) {
 int xwayland_init(struct server *server) {
   wl_list_init(&server->xwayland_surfaces);
 
-  server->xwayland =
-      wlr_xwayland_create(server->display, server->compositor, true);
+  if (!config.xwayland.enabled) {
+    // Don't let clients reach an X server this session doesn't own
+    unsetenv("DISPLAY");
+    printf("XWayland disabled\n");
+    return 0;
+  }
+
+  /*
+   * In lazy mode wlroots only holds the DISPLAY sockets and starts Xwayland
+   * when a client connects. Xwayland's -terminate delay shuts it down once
+   * it has had no clients for idle_timeout seconds, and wlroots listens on
+   * the same sockets again, so DISPLAY stays valid and the wlr_xwayland
+   * and its listeners below survive every restart. Surfaces do not; they
+   * are destroyed with the X server.
+   */
+  struct wlr_xwayland_server_options options = {
+      .lazy = config.xwayland.lazy,
+      .enable_wm = true,
+      .terminate_delay = config.xwayland.lazy ? config.xwayland.idle_timeout : 0,
+  };
+  server->xwayland_server =
+      wlr_xwayland_server_create(server->display, &options);
+  if (!server->xwayland_server) {
+    fprintf(stderr, "Failed to create XWayland server\n");
+    return -1;
+  }
+
+  server->xwayland = wlr_xwayland_create_with_server(
+      server->display, server->compositor, server->xwayland_server);
 
   if (!server->xwayland) {
     fprintf(stderr, "Failed to create XWayland server\n");
+    wlr_xwayland_server_destroy(server->xwayland_server);
+    server->xwayland_server = NULL;
     return -1;
   }
 
@@ -893,8 +980,9 @@ int xwayland_init(struct server *server) {
     setenv("GDK_DPI_SCALE", "1", true);
   }
 
-  printf("XWayland initialized on DISPLAY=%s (scale=%.1f)\n",
-         server->xwayland->display_name, max_scale);
+  printf("XWayland initialized on DISPLAY=%s (scale=%.1f, %s)\n",
+         server->xwayland->display_name, max_scale,
+         options.lazy ? "lazy" : "eager");
 
   return 0;
 }
@@ -906,6 +994,11 @@ void xwayland_finish(struct server *server) {
     wlr_xwayland_destroy(server->xwayland);
     server->xwayland = NULL;
   }
+  // Not owned by the wlr_xwayland when passed in through _with_server()
+  if (server->xwayland_server) {
+    wlr_xwayland_server_destroy(server->xwayland_server);
+    server->xwayland_server = NULL;
+  }
 }
 
 void xwayland_surface_raise(struct xwayland_surface *xsurface) {
@@ -1018,6 +1111,8 @@ void xwayland_surface_focus(struct xwayland_surface *xsurface) {
     return;
   }
 
+  bool changed = xsurface != xwayland_get_focused(server);
+
   // Unfocus other XWayland surfaces
   struct xwayland_surface *other;
   wl_list_for_each(other, &server->xwayland_surfaces, link) {
@@ -1040,6 +1135,26 @@ void xwayland_surface_focus(struct xwayland_surface *xsurface) {
 
   xwayland_surface_raise(xsurface);
   xwayland_decor_update(xsurface, true);
+
+  if (changed) {
+    ipc_event_xwindow(server, xsurface, "focus");
+  }
+}
+
+struct xwayland_surface *xwayland_get_focused(struct server *server) {
+  struct wlr_surface *focused = server->seat->keyboard_state.focused_surface;
+  if (!focused) {
+    return NULL;
+  }
+
+  struct xwayland_surface *xsurface;
+  wl_list_for_each(xsurface, &server->xwayland_surfaces, link) {
+    if (!xsurface->override_redirect &&
+        xsurface->xwayland_surface->surface == focused) {
+      return xsurface;
+    }
+  }
+  return NULL;
 }
 
 void xwayland_surface_configure(struct xwayland_surface *xsurface,
@@ -1122,15 +1237,40 @@ int clipboard_init(struct server *server) {
     return 0;
 }
 
+static void pointer_resolve_frame(struct server *server);
+
 static void output_frame(struct wl_listener *listener, void *data) {
   struct output *output = wl_container_of(listener, output, frame);
   (void)data;
-  wlr_scene_output_commit(output->scene_output, NULL);
   struct timespec now;
   clock_gettime(CLOCK_MONOTONIC, &now);
+  gesture_swipe_frame(output->server, &now);
+  pointer_resolve_frame(output->server);
+  ipc_sync_frame(output);
+  wlr_scene_output_commit(output->scene_output, NULL);
+  ipc_sync_frame_done(output);
   wlr_scene_output_send_frame_done(output->scene_output, &now);
 }
 
+static void output_commit(struct wl_listener *listener, void *data) {
+  struct output *output = wl_container_of(listener, output, commit);
+  struct wlr_output_event_commit *event = data;
+
+  // wlr_scene_output_commit() returns true for frames it skips, so only a
+  // commit that carried a buffer counts as the frame a SYNC waits on
+  if (event->state->committed & WLR_OUTPUT_STATE_BUFFER) {
+    ipc_sync_committed(output);
+  }
+}
+
+static void output_present(struct wl_listener *listener, void *data) {
+  struct output *output = wl_container_of(listener, output, present);
+  struct wlr_output_event_present *event = data;
+  if (event->presented)
+    startup_frame_presented();
+  ipc_sync_presented(output, data);
+}
+
 static void layer_surface_map(struct wl_listener *listener, void *data) {
   struct layer_surface *layer = wl_container_of(listener, layer, map);
   (void)data;
@@ -1260,6 +1400,7 @@ static void output_request_state(struct wl_listener *listener, void *data) {
   struct output *output = wl_container_of(listener, output, request_state);
   struct wlr_output_event_request_state *event = data;
   wlr_output_commit_state(output->wlr_output, event->state);
+  ipc_tree_mark_dirty(output->server, NULL);
 
   if (output->background && config.background.enabled) {
     background_update(output->background, output->wlr_output->width,
@@ -1271,11 +1412,16 @@ static void output_destroy(struct wl_listener *listener, void *data) {
   struct output *output = wl_container_of(listener, output, destroy);
   (void)data;
 
+  ipc_tree_mark_dirty(output->server, NULL);
+  ipc_sync_output_destroy(output);
+
   if (output->background) {
     wlr_scene_node_destroy(&output->background->node);
   }
 
   wl_list_remove(&output->frame.link);
+  wl_list_remove(&output->commit.link);
+  wl_list_remove(&output->present.link);
   wl_list_remove(&output->request_state.link);
   wl_list_remove(&output->destroy.link);
   wl_list_remove(&output->link);
@@ -1306,6 +1452,12 @@ void server_new_output(struct wl_listener *listener, void *data) {
   output->frame.notify = output_frame;
   wl_signal_add(&wlr_output->events.frame, &output->frame);
 
+  output->commit.notify = output_commit;
+  wl_signal_add(&wlr_output->events.commit, &output->commit);
+
+  output->present.notify = output_present;
+  wl_signal_add(&wlr_output->events.present, &output->present);
+
   output->request_state.notify = output_request_state;
   wl_signal_add(&wlr_output->events.request_state, &output->request_state);
 
@@ -1318,105 +1470,152 @@ void server_new_output(struct wl_listener *listener, void *data) {
   wlr_scene_output_layout_add_output(server->scene_layout, l_output,
                                      output->scene_output);
 
+  // Load the cursor theme at this output's scale once, so named cursors
+  // (including cursor-shape-v1 requests) never rasterize on the hot path
+  wlr_xcursor_manager_load(server->cursor_mgr, wlr_output->scale);
+
   if (config.background.enabled) {
     output->background =
         background_create(server->layer_bg, wlr_output->width,
                           wlr_output->height, &config.background);
   }
   wl_list_insert(&server->outputs, &output->link);
-}
-
-static struct layer_surface *layer_surface_at(struct server *server, double lx,
-                                              double ly,
-                                              struct wlr_surface **surface,
-                                              double *sx, double *sy) {
-  struct wlr_scene_node *node =
-      wlr_scene_node_at(&server->scene->tree.node, lx, ly, sx, sy);
-  if (!node || node->type != WLR_SCENE_NODE_BUFFER) {
+  ipc_tree_mark_dirty(server, NULL);
+}
+
+static const char *decor_hit_cursor(enum decor_hit hit) {
+  switch (hit) {
+  case HIT_RESIZE_TOP:
+  case HIT_RESIZE_BOTTOM:
+    return "ns-resize";
+  case HIT_RESIZE_LEFT:
+  case HIT_RESIZE_RIGHT:
+    return "ew-resize";
+  case HIT_RESIZE_TOP_LEFT:
+  case HIT_RESIZE_BOTTOM_RIGHT:
+    return "nwse-resize";
+  case HIT_RESIZE_TOP_RIGHT:
+  case HIT_RESIZE_BOTTOM_LEFT:
+    return "nesw-resize";
+  case HIT_NONE:
     return NULL;
+  default:
+    return "default";
   }
+}
 
-  struct wlr_scene_buffer *scene_buffer = wlr_scene_buffer_from_node(node);
-  struct wlr_scene_surface *scene_surface =
-      wlr_scene_surface_try_from_buffer(scene_buffer);
-  if (!scene_surface) {
-    return NULL;
-  }
+/*
+ * Pointer-derived compositor state (decoration hover, the compositor's own
+ * cursor image and focus-follows-mouse) is resolved once per output frame.
+ * Motion handlers only deliver the event to the client and mark it dirty, so
+ * a high-rate mouse costs one hit test per frame instead of one per event.
+ */
+static void pointer_mark_dirty(struct server *server) {
+  if (server->pointer_dirty)
+    return;
+  server->pointer_dirty = true;
 
-  *surface = scene_surface->surface;
+  struct wlr_output *wlr_output = wlr_output_layout_output_at(
+      server->output_layout, server->cursor->x, server->cursor->y);
+  if (wlr_output)
+    wlr_output_schedule_frame(wlr_output);
+}
 
-  struct wlr_scene_tree *tree = node->parent;
-  while (tree) {
-    if (tree->node.data) {
-      struct layer_surface *layer;
-      wl_list_for_each(layer, &server->layers, link) {
-        if (layer->scene_tree == tree) {
-          return layer;
-        }
-      }
+// Titlebar buffers are not client surfaces, so toplevel_at() skips them
+static struct toplevel *decor_toplevel_at(struct server *server, double lx,
+                                          double ly) {
+  double sx, sy;
+  struct wlr_scene_node *node =
+      wlr_scene_node_at(&server->scene->tree.node, lx, ly, &sx, &sy);
+  if (!node)
+    return NULL;
+
+  for (struct wlr_scene_tree *tree = node->parent; tree;
+       tree = tree->node.parent) {
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+      if (toplevel->decor.tree && toplevel->decor.tree == tree)
+        return toplevel;
     }
-    tree = tree->node.parent;
   }
-
   return NULL;
 }
 
-static void process_cursor_motion(struct server *server, uint32_t time) {
+static void pointer_set_cursor(struct server *server, const char *name) {
+  if (server->pointer_cursor_name &&
+      strcmp(server->pointer_cursor_name, name) == 0)
+    return;
+  wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, name);
+  server->pointer_cursor_name = name;
+}
+
+static void pointer_resolve_frame(struct server *server) {
+  if (!server->pointer_dirty)
+    return;
+  server->pointer_dirty = false;
+
+  if (cursor_state.mode != CURSOR_NORMAL)
+    return;
+
+  double lx = server->cursor->x, ly = server->cursor->y;
   double sx, sy;
   struct wlr_surface *surface = NULL;
+  struct toplevel *toplevel = toplevel_at(server, lx, ly, &surface, &sx, &sy);
+  if (!toplevel && !surface)
+    toplevel = decor_toplevel_at(server, lx, ly);
 
-  struct layer_surface *layer = layer_surface_at(
-      server, server->cursor->x, server->cursor->y, &surface, &sx, &sy);
+  struct toplevel *prev = server->pointer_hover;
+  server->pointer_hover = toplevel;
 
-  if (layer && surface) {
-    wlr_seat_pointer_notify_enter(server->seat, surface, sx, sy);
-    wlr_seat_pointer_notify_motion(server->seat, time, sx, sy);
+  // Drop hover highlights on the window the pointer just left
+  if (prev && prev != toplevel)
+    decor_update_hover(prev, -1e6, -1e6);
+
+  if (!toplevel) {
+    // Layer and X11 surfaces own their cursor, bare background gets ours
+    if (!surface)
+      pointer_set_cursor(server, "default");
     return;
   }
 
-  struct toplevel *toplevel = toplevel_at(
-      server, server->cursor->x, server->cursor->y, &surface, &sx, &sy);
+  const char *cursor_name = NULL;
+  if (config.decor.enabled) {
+    decor_update_hover(toplevel, lx, ly);
+    cursor_name = decor_hit_cursor(decor_hit_test(toplevel, lx, ly));
+  }
 
-  if (!toplevel) {
+  if (cursor_name) {
+    pointer_set_cursor(server, cursor_name);
+  } else if (server->pointer_cursor_name) {
+    // Back over client content: reset once, the client's next
+    // set_cursor/set_shape takes over from here
     wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, "default");
-    wlr_seat_pointer_clear_focus(server->seat);
-  } else {
-    if (config.decor.enabled) {
-      decor_update_hover(toplevel, server->cursor->x, server->cursor->y);
+    server->pointer_cursor_name = NULL;
+  }
 
-      enum decor_hit hit =
-          decor_hit_test(toplevel, server->cursor->x, server->cursor->y);
-      const char *cursor_name = "default";
+  if (config.focus_follows_mouse && toplevel != prev &&
+      !server->locked_session && toplevel != get_focused_toplevel(server)) {
+    focus_toplevel(toplevel);
+  }
+}
 
-      switch (hit) {
-      case HIT_RESIZE_TOP:
-      case HIT_RESIZE_BOTTOM:
-        cursor_name = "ns-resize";
-        break;
-      case HIT_RESIZE_LEFT:
-      case HIT_RESIZE_RIGHT:
-        cursor_name = "ew-resize";
-        break;
-      case HIT_RESIZE_TOP_LEFT:
-      case HIT_RESIZE_BOTTOM_RIGHT:
-        cursor_name = "nwse-resize";
-        break;
-      case HIT_RESIZE_TOP_RIGHT:
-      case HIT_RESIZE_BOTTOM_LEFT:
-        cursor_name = "nesw-resize";
-        break;
-      default:
-        break;
-      }
+void process_cursor_motion(struct server *server, uint32_t time) {
+  double sx, sy;
+  struct wlr_surface *surface = NULL;
 
-      wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, cursor_name);
-    }
+  // Client delivery stays immediate; everything else waits for the frame
+  toplevel_at(server, server->cursor->x, server->cursor->y, &surface, &sx,
+              &sy);
 
+  if (surface) {
     wlr_seat_pointer_notify_enter(server->seat, surface, sx, sy);
     wlr_seat_pointer_notify_motion(server->seat, time, sx, sy);
+  } else {
+    wlr_seat_pointer_clear_focus(server->seat);
   }
-}
 
+  pointer_mark_dirty(server);
+}
 
 void cursor_motion_abs(struct wl_listener *listener, void *data) {
   struct server *server = wl_container_of(listener, server, cursor_motion_abs);
@@ -1447,11 +1646,17 @@ void request_cursor(struct wl_listener *listener, void *data) {
   if (focused == event->seat_client) {
     wlr_cursor_set_surface(server->cursor, event->surface, event->hotspot_x,
                            event->hotspot_y);
+    server->pointer_cursor_name = NULL;
   }
 }
 
 #include "config.h"
 
+static bool keysym_is_modifier(xkb_keysym_t sym) {
+  return (sym >= XKB_KEY_Shift_L && sym <= XKB_KEY_Hyper_R) ||
+         (sym >= XKB_KEY_ISO_Lock && sym <= XKB_KEY_ISO_Level5_Lock);
+}
+
 static void keyboard_key(struct wl_listener *listener, void *data) {
   struct keyboard *keyboard = wl_container_of(listener, keyboard, key);
   struct wlr_keyboard_key_event *event = data;
@@ -1465,14 +1670,26 @@ static void keyboard_key(struct wl_listener *listener, void *data) {
   bool handled = false;
 
   if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+    struct server *server = keyboard->server;
+    if (server->binding_mode >= config.binding_mode_count)
+      server->binding_mode = BINDING_MODE_DEFAULT;
+    int mode = server->binding_mode;
+    bool modifier_only = nsyms > 0;
+
     for (int i = 0; i < nsyms && !handled; i++) {
-      for (int k = 0; k < config.keybind_count; k++) {
-        struct keybind *kb = &config.keybinds[k];
-        if (kb->modifiers == mods && kb->keysym == syms[i]) {
-          handled = handle_keybind(keyboard->server, kb->action, kb->arg);
-          break;
-        }
-      }
+      const struct keybind *kb = keybind_lookup(mode, mods, syms[i]);
+      if (kb)
+        handled = handle_keybind(server, kb->action, kb->arg);
+      if (!keysym_is_modifier(syms[i]))
+        modifier_only = false;
+    }
+
+    // A chord step eats the next real key, whether it completes or not
+    if (!modifier_only && mode < config.binding_mode_count &&
+        config.binding_modes[mode].oneshot) {
+      if (server->binding_mode == mode)
+        server->binding_mode = BINDING_MODE_DEFAULT;
+      handled = true;
     }
   }
 
@@ -1501,6 +1718,128 @@ static void keyboard_destroy(struct wl_listener *listener, void *data) {
   free(keyboard);
 }
 
+/*
+ * Compiled keymaps are cached per RMLVO and shared by every keyboard, so
+ * hotplugging a device (or a KVM switch replugging several) never
+ * recompiles. The cache holds one reference to each keymap. A failed
+ * compile is cached as a NULL keymap, so it is not retried and logged on
+ * every hotplug. keymap_cache_prune() drops what a reload left unused.
+ */
+struct keymap_cache_entry {
+  struct wl_list link;
+  struct keyboard_config names;
+  struct xkb_keymap *keymap; // NULL if the names did not compile
+};
+
+static struct xkb_context *xkb_ctx;
+static struct wl_list keymap_cache = {&keymap_cache, &keymap_cache};
+
+static bool keymap_names_equal(const struct keyboard_config *a,
+                               const struct keyboard_config *b) {
+  return strcmp(a->rules, b->rules) == 0 && strcmp(a->model, b->model) == 0 &&
+         strcmp(a->layout, b->layout) == 0 &&
+         strcmp(a->variant, b->variant) == 0 &&
+         strcmp(a->options, b->options) == 0;
+}
+
+static struct xkb_keymap *keymap_get(const struct keyboard_config *kc) {
+  struct keymap_cache_entry *entry;
+  wl_list_for_each(entry, &keymap_cache, link) {
+    if (keymap_names_equal(&entry->names, kc))
+      return entry->keymap;
+  }
+
+  if (!xkb_ctx) {
+    xkb_ctx = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (!xkb_ctx) {
+      fprintf(stderr, "Failed to create xkb context\n");
+      return NULL;
+    }
+  }
+
+  struct xkb_rule_names names = {
+      .rules = kc->rules[0] ? kc->rules : NULL,
+      .model = kc->model[0] ? kc->model : NULL,
+      .layout = kc->layout[0] ? kc->layout : NULL,
+      .variant = kc->variant[0] ? kc->variant : NULL,
+      .options = kc->options[0] ? kc->options : NULL,
+  };
+  struct xkb_keymap *keymap =
+      xkb_keymap_new_from_names(xkb_ctx, &names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+  if (!keymap) {
+    fprintf(stderr, "Failed to compile keymap (layout '%s', variant '%s')\n",
+            kc->layout, kc->variant);
+  }
+
+  entry = calloc(1, sizeof(*entry));
+  if (!entry) {
+    xkb_keymap_unref(keymap);
+    return NULL;
+  }
+  entry->names = *kc;
+  entry->keymap = keymap;
+  wl_list_insert(&keymap_cache, &entry->link);
+  if (keymap) {
+    printf("Compiled keymap (layout '%s')\n",
+           kc->layout[0] ? kc->layout : "default");
+  }
+  return keymap;
+}
+
+void keymap_cache_prune(struct server *server) {
+  static const struct keyboard_config defaults = {0};
+
+  struct keymap_cache_entry *entry, *tmp;
+  wl_list_for_each_safe(entry, tmp, &keymap_cache, link) {
+    // The configured names and the fallback are what the next hotplug asks for
+    bool used = keymap_names_equal(&entry->names, &config.keyboard) ||
+                keymap_names_equal(&entry->names, &defaults);
+
+    struct keyboard *keyboard;
+    wl_list_for_each(keyboard, &server->keyboards, link) {
+      if (entry->keymap && keyboard->wlr_keyboard->keymap == entry->keymap) {
+        used = true;
+      }
+    }
+    if (used) {
+      continue;
+    }
+
+    wl_list_remove(&entry->link);
+    xkb_keymap_unref(entry->keymap);
+    free(entry);
+  }
+}
+
+void keyboard_apply_config(struct wlr_keyboard *wlr_keyboard) {
+  struct xkb_keymap *keymap = keymap_get(&config.keyboard);
+  if (!keymap) {
+    // Fall back to the xkbcommon defaults rather than a dead keyboard
+    static const struct keyboard_config defaults = {0};
+    keymap = keymap_get(&defaults);
+  }
+  if (keymap && wlr_keyboard->keymap != keymap)
+    wlr_keyboard_set_keymap(wlr_keyboard, keymap);
+
+  wlr_keyboard_set_repeat_info(wlr_keyboard, config.keyboard.repeat_rate,
+                               config.keyboard.repeat_delay);
+}
+
+void keyboard_layout_next(struct server *server) {
+  struct keyboard *keyboard;
+  wl_list_for_each(keyboard, &server->keyboards, link) {
+    struct wlr_keyboard *kb = keyboard->wlr_keyboard;
+    if (!kb->keymap)
+      continue;
+    xkb_layout_index_t count = xkb_keymap_num_layouts(kb->keymap);
+    if (count < 2)
+      continue;
+    wlr_keyboard_notify_modifiers(kb, kb->modifiers.depressed,
+                                  kb->modifiers.latched, kb->modifiers.locked,
+                                  (kb->modifiers.group + 1) % count);
+  }
+}
+
 void new_input(struct wl_listener *listener, void *data) {
   struct server *server = wl_container_of(listener, server, new_input);
   struct wlr_input_device *device = data;
@@ -1510,14 +1849,7 @@ void new_input(struct wl_listener *listener, void *data) {
     keyboard->server = server;
     keyboard->wlr_keyboard = wlr_keyboard_from_input_device(device);
 
-    struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-    struct xkb_keymap *keymap =
-        xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
-    wlr_keyboard_set_keymap(keyboard->wlr_keyboard, keymap);
-    xkb_keymap_unref(keymap);
-    xkb_context_unref(context);
-
-    wlr_keyboard_set_repeat_info(keyboard->wlr_keyboard, 25, 600);
+    keyboard_apply_config(keyboard->wlr_keyboard);
 
     keyboard->key.notify = keyboard_key;
     wl_signal_add(&keyboard->wlr_keyboard->events.key, &keyboard->key);
@@ -150,6 +150,7 @@ struct wlr_session_lock_manager_v1;
 struct wlr_session_lock_v1;
 struct wlr_presentation;
 struct wlr_viewporter;
+struct wlr_cursor_shape_manager_v1;
 
 struct server {
   struct wl_display *display;
@@ -177,6 +178,7 @@ struct server {
 
   /* XWayland */
   struct wlr_xwayland *xwayland;
+  struct wlr_xwayland_server *xwayland_server;
   struct wl_listener new_xwayland_surface;
   struct wl_listener xwayland_ready;
   struct wl_list xwayland_surfaces;
@@ -251,6 +253,10 @@ struct server {
   /* Viewporter (video) */
   struct wlr_viewporter *viewporter;
 
+  /* Cursor shape (named cursors from the compositor's xcursor theme) */
+  struct wlr_cursor_shape_manager_v1 *cursor_shape_mgr;
+  struct wl_listener request_set_cursor_shape;
+
   /* === END NEW PROTOCOLS === */
 
   struct wl_listener new_output;
@@ -278,9 +284,19 @@ struct server {
   /* Unified window list (NEW - use alongside toplevels during migration) */
   struct wl_list windows;
 
+  /* Pointer state resolved once per output frame */
+  bool pointer_dirty;
+  struct toplevel *pointer_hover;
+  const char *pointer_cursor_name; /* NULL while the client owns the image */
+
   enum window_mode mode;
+  int binding_mode;
   int current_workspace;
 
+  // arrange_begin()/arrange_end() nesting; arranges inside are coalesced
+  int arrange_defer;
+  bool arrange_pending;
+
   struct wl_event_source *anim_timer;
 };
 
@@ -295,6 +311,8 @@ struct output {
   struct wlr_output *wlr_output;
   struct wlr_scene_output *scene_output;
   struct wl_listener frame;
+  struct wl_listener commit;
+  struct wl_listener present;
   struct wl_listener request_state;
   struct wl_listener destroy;
 
@@ -326,6 +344,24 @@ struct decoration {
   int cached_shadow_height;
 };
 
+/* Serialized IPC tree node and the state it was built from (ipc.c) */
+struct ipc_node_cache {
+  char *json;
+  size_t len;
+  size_t cap;
+  bool dirty;
+  struct wlr_box box;
+  int workspace;
+  uint32_t state;
+};
+
+/* Rules already applied to a window, by content hash (rules.c) */
+struct rule_history {
+  uint32_t *hashes;
+  int count;
+  int capacity;
+};
+
 struct toplevel {
   struct wl_list link;
   struct server *server;
@@ -338,9 +374,12 @@ struct toplevel {
   struct wl_listener destroy;
   struct wl_listener request_fullscreen;
   struct wl_listener request_minimize;
+  struct wl_listener set_title;
+  struct wl_listener set_app_id;
 
   struct decoration decor;
   struct animation anim;
+  struct ipc_node_cache ipc;
 
   bool floating;
   bool fullscreen;
@@ -354,6 +393,12 @@ struct toplevel {
 
   int pre_max_x, pre_max_y;
   int pre_max_width, pre_max_height;
+
+  // Set by the `mark` command; unique across windows
+  char **marks;
+  int mark_count;
+
+  struct rule_history rules_applied;
 };
 
 struct keyboard {
@@ -388,11 +433,14 @@ struct xwayland_surface {
   float opacity;
   int saved_x, saved_y, saved_width, saved_height;
   int pre_max_x, pre_max_y, pre_max_width, pre_max_height;
+  struct rule_history rules_applied;
+  struct ipc_node_cache ipc;
   
   /* Flag: set true during destroy to prevent double-free */
   bool destroying;
   
   struct wl_listener map;
+  struct wl_listener dissociate;
   struct wl_listener unmap;
   struct wl_listener surface_map;
   struct wl_listener destroy;
@@ -416,8 +464,12 @@ void cursor_motion(struct wl_listener *listener, void *data);
 void cursor_motion_abs(struct wl_listener *listener, void *data);
 void cursor_axis(struct wl_listener *listener, void *data);
 void cursor_frame(struct wl_listener *listener, void *data);
+void process_cursor_motion(struct server *server, uint32_t time);
 void request_cursor(struct wl_listener *listener, void *data);
 void new_input(struct wl_listener *listener, void *data);
+void keyboard_apply_config(struct wlr_keyboard *wlr_keyboard);
+void keymap_cache_prune(struct server *server);
+void keyboard_layout_next(struct server *server);
 void server_new_xdg_popup(struct wl_listener *listener, void *data);
 void server_new_xdg_decoration(struct wl_listener *listener, void *data);
 void server_new_layer_surface(struct wl_listener *listener, void *data);
@@ -437,8 +489,11 @@ struct xwayland_surface *xwayland_surface_at(struct server *server,
                                               struct wlr_surface **surface,
                                               double *sx, double *sy);
 void xwayland_surface_focus(struct xwayland_surface *xsurface);
+struct xwayland_surface *xwayland_get_focused(struct server *server);
 void xwayland_surface_raise(struct xwayland_surface *xsurface);
 void xwayland_surface_lower(struct xwayland_surface *xsurface);
+void xwayland_surface_set_fullscreen(struct xwayland_surface *xsurface,
+                                      bool fullscreen);
 
 struct toplevel *toplevel_at(struct server *server, double lx, double ly,
                              struct wlr_surface **surface, double *sx,
@@ -449,8 +504,12 @@ void server_new_xdg_toplevel(struct wl_listener *listener, void *data);
 void cursor_button(struct wl_listener *listener, void *data);
 bool handle_keybind(struct server *server, enum keybind_action action,
                     const char *arg);
+bool handle_action(struct server *server, struct toplevel *focused,
+                   enum keybind_action action, const char *arg);
 
 void arrange_windows(struct server *server);
+void arrange_begin(struct server *server);
+void arrange_end(struct server *server);
 void focus_toplevel(struct toplevel *toplevel);
 struct toplevel *get_focused_toplevel(struct server *server);
 
@@ -474,8 +533,26 @@ float anim_ease(float t, enum anim_curve curve);
 int64_t get_time_ms(void);
 void anim_schedule_update(struct server *server);
 
+/* command.c */
+// Runs a sway-style command string; report() is called once per command
+void command_execute(struct server *server, const char *input,
+                     void (*report)(void *data, bool success, const char *error),
+                     void *data);
+void command_toplevel_destroy(struct toplevel *toplevel);
+
+/* gesture.c */
+void gesture_swipe_frame(struct server *server, const struct timespec *now);
+void gesture_swipe_cancel(struct server *server);
+
 /* rules.c */
-void apply_window_rules(struct toplevel *toplevel);
+/* Before map; true if a rule placed the window */
+bool apply_window_rules(struct toplevel *toplevel);
+bool apply_xwayland_rules(struct xwayland_surface *xsurface);
+/* After map, when the title or app_id changes */
+void window_rules_changed(struct toplevel *toplevel);
+void xwayland_rules_changed(struct xwayland_surface *xsurface);
+void window_rules_reset(void);
+void rule_history_finish(struct rule_history *history);
 
 /* titlebar.c */
 struct titlebar_element *
@@ -3,9 +3,12 @@
 
 #include "core.h"
 #include "config.h"
+#include "ipc.h"
+#include "spawner.h"
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/input-event-codes.h>
 
@@ -179,28 +182,14 @@ static void execute_gesture_action(struct server *server, struct gesture_action
             server->mode = MODE_TILING;
         }
         arrange_windows(server);
+        ipc_event_mode(server);
         break;
     }
     
-    case GESTURE_ACTION_SPAWN: {
-        if (action->arg[0]) {
-            if (fork() == 0) {
-                execl("/bin/sh", "sh", "-c", action->arg, NULL);
-                _exit(1);
-            }
-        }
+    case GESTURE_ACTION_SPAWN:
+    case GESTURE_ACTION_EXEC:
+        spawn_command(action->arg);
         break;
-    }
-    
-    case GESTURE_ACTION_EXEC: {
-        if (action->arg[0]) {
-            if (fork() == 0) {
-                execl("/bin/sh", "sh", "-c", action->arg, NULL);
-                _exit(1);
-            }
-        }
-        break;
-    }
     
     default:
         break;
@@ -218,10 +207,240 @@ static struct gesture_action *find_touchpad_action(int fingers,
     return NULL;
 }
 
+/*
+ * Workspace swipe strip
+ *
+ * While a horizontal swipe bound to a workspace action is in progress, the
+ * windows of the current and the neighbouring workspace are moved into two
+ * scene trees that follow the fingers 1:1. Only scene node positions change,
+ * so no client is reconfigured mid-gesture. On release a spring, stepped
+ * from the output frame callback, settles on one of the two workspaces.
+ */
+#define SWIPE_STIFFNESS 400.0   // 1/s^2, critically damped below
+#define SWIPE_PROJECTION 0.2    // s of release velocity added to the offset
+#define SWIPE_RUBBER_BAND 0.25  // drag factor when nothing is bound
+
+static struct {
+    bool active;    // windows live in the strip trees
+    bool settling;  // fingers lifted, spring running
+    struct wlr_scene_tree *from, *to;
+    int to_ws;      // 0 when the swipe direction has no workspace bound
+    double width;
+    double offset, velocity, target;
+    uint32_t last_time;
+    struct timespec last_frame;
+
+    // An empty tree left where each strip node stood in layer_windows
+    struct swipe_slot {
+        struct wlr_scene_node *node;
+        struct wlr_scene_tree *marker;
+    } *slots;
+    int slot_count, slot_capacity;
+} swipe;
+
+static int swipe_workspace_for(struct server *server, enum gesture_direction dir) {
+    struct gesture_action *action = find_touchpad_action(gesture_state.fingers, dir);
+    if (!action) return 0;
+
+    int ws = 0;
+    switch (action->type) {
+    case GESTURE_ACTION_WORKSPACE_NEXT:
+        ws = server->current_workspace % MAX_WORKSPACES + 1;
+        break;
+    case GESTURE_ACTION_WORKSPACE_PREV:
+        ws = server->current_workspace > 1 ? server->current_workspace - 1 : MAX_WORKSPACES;
+        break;
+    case GESTURE_ACTION_WORKSPACE:
+        ws = atoi(action->arg);
+        if (ws < 1 || ws > MAX_WORKSPACES) ws = 0;
+        break;
+    default:
+        break;
+    }
+    return ws == server->current_workspace ? 0 : ws;
+}
+
+static bool swipe_owns(struct server *server, int ws, struct wlr_scene_node *node) {
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+        if (toplevel->workspace != ws || toplevel->minimized || !toplevel->scene_tree) continue;
+
+        struct wlr_scene_node *window = toplevel->decor.tree ?
+            &toplevel->decor.tree->node : &toplevel->scene_tree->node;
+        if (node == window) return true;
+        if (toplevel->decor.shadow && node == &toplevel->decor.shadow->node) return true;
+    }
+    return false;
+}
+
+static void swipe_slot_add(struct wlr_scene_node *node, struct wlr_scene_tree *marker) {
+    if (swipe.slot_count == swipe.slot_capacity) {
+        int capacity = swipe.slot_capacity ? swipe.slot_capacity * 2 : 16;
+        struct swipe_slot *grown = realloc(swipe.slots, capacity * sizeof(*grown));
+        if (!grown) {
+            wlr_scene_node_destroy(&marker->node);
+            return;
+        }
+        swipe.slots = grown;
+        swipe.slot_capacity = capacity;
+    }
+    swipe.slots[swipe.slot_count++] = (struct swipe_slot){ node, marker };
+}
+
+static struct wlr_scene_tree *swipe_slot_take(struct wlr_scene_node *node) {
+    for (int i = 0; i < swipe.slot_count; i++) {
+        if (swipe.slots[i].node != node) continue;
+        struct wlr_scene_tree *marker = swipe.slots[i].marker;
+        swipe.slots[i] = swipe.slots[--swipe.slot_count];
+        return marker;
+    }
+    return NULL;
+}
+
+// Walks layer_windows bottom to top, so the strip stacks windows as it did
+static void swipe_collect(struct server *server, int ws, struct wlr_scene_tree *tree) {
+    struct wlr_scene_node *node, *tmp;
+    wl_list_for_each_safe(node, tmp, &server->layer_windows->children, link) {
+        if (!swipe_owns(server, ws, node)) continue;
+
+        struct wlr_scene_tree *marker = wlr_scene_tree_create(server->layer_windows);
+        if (marker) {
+            wlr_scene_node_place_above(&marker->node, node);
+            swipe_slot_add(node, marker);
+        }
+        wlr_scene_node_reparent(node, tree);
+        // Shadows keep their state; windows of the target workspace are hidden
+        if (node->type != WLR_SCENE_NODE_BUFFER) wlr_scene_node_set_enabled(node, true);
+    }
+}
+
+// Every node goes back to the slot it was collected from
+static void swipe_release(struct server *server, struct wlr_scene_tree *tree, bool enabled) {
+    struct wlr_scene_node *node, *tmp;
+    wl_list_for_each_safe(node, tmp, &tree->children, link) {
+        wlr_scene_node_reparent(node, server->layer_windows);
+        struct wlr_scene_tree *marker = swipe_slot_take(node);
+        if (marker) {
+            wlr_scene_node_place_below(node, &marker->node);
+            wlr_scene_node_destroy(&marker->node);
+        } else if (node->type == WLR_SCENE_NODE_BUFFER) {
+            // Decoration shadow
+            wlr_scene_node_lower_to_bottom(node);
+        }
+        if (node->type != WLR_SCENE_NODE_BUFFER) wlr_scene_node_set_enabled(node, enabled);
+    }
+    wlr_scene_node_set_position(&tree->node, 0, 0);
+}
+
+static void swipe_apply(void) {
+    double side = swipe.offset < 0 ? swipe.width : -swipe.width;
+    wlr_scene_node_set_position(&swipe.from->node, (int)round(swipe.offset), 0);
+    wlr_scene_node_set_position(&swipe.to->node, (int)round(swipe.offset + side), 0);
+}
+
+static void swipe_schedule_frames(struct server *server) {
+    struct output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        wlr_output_schedule_frame(output->wlr_output);
+    }
+}
+
+static bool swipe_start(struct server *server) {
+    if (!swipe_workspace_for(server, GESTURE_DIR_LEFT) &&
+        !swipe_workspace_for(server, GESTURE_DIR_RIGHT)) {
+        return false;
+    }
+
+    struct wlr_output *wlr_output = wlr_output_layout_output_at(
+        server->output_layout, server->cursor->x, server->cursor->y);
+    struct output *primary = output_get_primary(server);
+    if (!wlr_output && primary) wlr_output = primary->wlr_output;
+    if (!wlr_output) return false;
+
+    int width, height;
+    wlr_output_effective_resolution(wlr_output, &width, &height);
+    swipe.width = width;
+
+    if (!swipe.from) {
+        swipe.from = wlr_scene_tree_create(server->layer_windows);
+        swipe.to = wlr_scene_tree_create(server->layer_windows);
+        if (!swipe.from || !swipe.to) return false;
+    }
+
+    swipe_collect(server, server->current_workspace, swipe.from);
+    swipe.to_ws = 0;
+    swipe.offset = 0;
+    swipe.velocity = 0;
+    swipe.active = true;
+    return true;
+}
+
+static void swipe_set_target(struct server *server, int ws) {
+    swipe_release(server, swipe.to, false);
+    swipe.to_ws = ws;
+    if (ws) swipe_collect(server, ws, swipe.to);
+}
+
+// Put every window back without switching workspace
+void gesture_swipe_cancel(struct server *server) {
+    if (!swipe.active) return;
+
+    swipe_release(server, swipe.from, true);
+    swipe_release(server, swipe.to, false);
+    // Slots whose node was destroyed during the swipe
+    for (int i = 0; i < swipe.slot_count; i++)
+        wlr_scene_node_destroy(&swipe.slots[i].marker->node);
+    swipe.slot_count = 0;
+    swipe.active = false;
+    swipe.settling = false;
+}
+
+static void swipe_finish(struct server *server) {
+    bool commit = swipe.target != 0;
+    int ws = swipe.to_ws;
+
+    gesture_swipe_cancel(server);
+    if (commit) workspace_show(server, ws);
+}
+
+void gesture_swipe_frame(struct server *server, const struct timespec *now) {
+    if (!swipe.settling) return;
+
+    double dt = (now->tv_sec - swipe.last_frame.tv_sec) +
+                (now->tv_nsec - swipe.last_frame.tv_nsec) / 1e9;
+    if (dt <= 0) return;
+    if (dt > 1.0 / 30) dt = 1.0 / 30;
+    swipe.last_frame = *now;
+
+    double accel = -SWIPE_STIFFNESS * (swipe.offset - swipe.target) -
+                   2.0 * sqrt(SWIPE_STIFFNESS) * swipe.velocity;
+    swipe.velocity += accel * dt;
+    swipe.offset += swipe.velocity * dt;
+
+    // Never overshoot past the neighbour into empty space
+    if (swipe.target != 0 && fabs(swipe.offset) > fabs(swipe.target)) {
+        swipe.offset = swipe.target;
+    }
+
+    if (fabs(swipe.offset - swipe.target) < 0.5 && fabs(swipe.velocity) < 20.0) {
+        swipe_finish(server);
+        return;
+    }
+
+    swipe_apply();
+    swipe_schedule_frames(server);
+}
+
 void gesture_swipe_begin(struct wl_listener *listener, void *data) {
     struct server *server = wl_container_of(listener, server, gesture_swipe_begin);
     struct wlr_pointer_swipe_begin_event *event = data;
     
+    // A new swipe lands the previous one where it was heading
+    if (swipe.settling) {
+        swipe.offset = swipe.target;
+        swipe_finish(server);
+    }
+    
     gesture_state.active = true;
     gesture_state.type = GESTURE_SWIPE;
     gesture_state.fingers = event->fingers;
@@ -237,6 +456,27 @@ void gesture_swipe_update(struct wl_listener *listener, void *data) {
     
     gesture_state.dx += event->dx;
     gesture_state.dy += event->dy;
+    
+    if (!swipe.active) {
+        if (fabs(gesture_state.dx) <= fabs(gesture_state.dy) || !swipe_start(server))
+            return;
+    } else {
+        uint32_t dt = event->time_msec - swipe.last_time;
+        if (dt > 0) {
+            double instant = event->dx * 1000.0 / dt;
+            swipe.velocity = swipe.velocity * 0.5 + instant * 0.5;
+        }
+    }
+    swipe.last_time = event->time_msec;
+    
+    int ws = swipe_workspace_for(server,
+        gesture_state.dx < 0 ? GESTURE_DIR_LEFT : GESTURE_DIR_RIGHT);
+    if (ws != swipe.to_ws) swipe_set_target(server, ws);
+    
+    swipe.offset = ws ? gesture_state.dx : gesture_state.dx * SWIPE_RUBBER_BAND;
+    if (swipe.offset > swipe.width) swipe.offset = swipe.width;
+    if (swipe.offset < -swipe.width) swipe.offset = -swipe.width;
+    swipe_apply();
 }
 
 void gesture_swipe_end(struct wl_listener *listener, void *data) {
@@ -245,6 +485,20 @@ void gesture_swipe_end(struct wl_listener *listener, void *data) {
     
     if (!gesture_state.active || gesture_state.type != GESTURE_SWIPE) return;
     
+    if (swipe.active) {
+        double projected = swipe.offset + swipe.velocity * SWIPE_PROJECTION;
+        bool commit = swipe.to_ws && !event->cancelled &&
+            projected * swipe.offset > 0 &&
+            fabs(projected) > swipe.width * config.gesture_swipe_threshold;
+        
+        swipe.target = commit ? (swipe.offset < 0 ? -swipe.width : swipe.width) : 0;
+        swipe.settling = true;
+        clock_gettime(CLOCK_MONOTONIC, &swipe.last_frame);
+        swipe_schedule_frames(server);
+        gesture_state.active = false;
+        return;
+    }
+    
     if (event->cancelled) {
         gesture_state.active = false;
         return;
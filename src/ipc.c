@@ -4,16 +4,32 @@
 #include "ipc.h"
 #include "core.h"
 #include "config.h"
-#include "config_live.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
+#include <time.h>
 #include <json-c/json.h>
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/xwayland.h>
+#include "json_writer.h"
+#include "startup.h"
+
+// One subscription; unset fields match anything
+struct ipc_filter {
+    uint32_t type;      // IPC_EVENT_*
+    char **changes;     // event subtypes ("focus", "title", ...)
+    int change_count;
+    char *app_id;       // fnmatch(3) glob
+    char *output;
+    int workspace;
+};
 
 // IPC client structure (internal to ipc.c)
 struct ipc_client {
@@ -22,13 +38,37 @@ struct ipc_client {
     struct wl_event_source *event_source;
     struct server *server;
     
-    uint32_t subscribed_events;
+    uint32_t subscribed_events;  // union of filter types, for fast rejection
+    struct ipc_filter *filters;
+    int filter_count;
     
+    // Requests are parsed in place from read_pos; the buffer only grows
     char *read_buffer;
     size_t read_buffer_size;
     size_t read_buffer_len;
+    size_t read_pos;
+    
+    // Outbound ring, only used once the socket stops taking data
+    char *out_buffer;
+    size_t out_size;
+    size_t out_head;
+    size_t out_len;
+    
+    // Killed clients linger until the idle callback frees them, so a
+    // failed send never invalidates a list walk or a read loop
+    bool dead;
+    struct wl_event_source *idle_source;
+    
+    // Change notification for the shared state page, -1 until requested
+    int state_eventfd;
 };
 
+// Larger requests are a broken or hostile client, not a long command list
+#define IPC_MAX_MESSAGE_SIZE (1024 * 1024)
+
+// A client that lets this much reply data pile up has stopped reading
+#define IPC_CLIENT_MAX_QUEUE (4 * 1024 * 1024)
+
 static struct wl_list ipc_clients;
 static int ipc_socket = -1;
 static struct wl_event_source *ipc_event_source = NULL;
@@ -48,229 +88,864 @@ static int set_nonblock(int fd) {
     return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
 }
 
-static void ipc_send_response(struct ipc_client *client, uint32_t type, const char *payload) {
-    size_t payload_len = payload ? strlen(payload) : 0;
-    size_t total_len = sizeof(struct ipc_header) + payload_len;
+void ipc_client_disconnect(struct ipc_client *client);
+
+static int ipc_client_reap(void *data) {
+    struct ipc_client *client = data;
+    client->idle_source = NULL;
+    ipc_client_disconnect(client);
+    return 0;
+}
+
+static void ipc_client_kill(struct ipc_client *client, const char *reason) {
+    if (client->dead) return;
     
-    char *buffer = malloc(total_len);
-    if (!buffer) return;
+    fprintf(stderr, "IPC: dropping client fd %d: %s\n", client->fd, reason);
+    client->dead = true;
     
-    struct ipc_header *header = (struct ipc_header *)buffer;
-    memcpy(header->magic, IPC_MAGIC, IPC_MAGIC_LEN);
-    header->size = payload_len;
-    header->type = type;
+    struct wl_event_loop *loop = wl_display_get_event_loop(client->server->display);
+    client->idle_source = wl_event_loop_add_idle(loop, ipc_client_reap, client);
+}
+
+static ssize_t ipc_writev(int fd, struct iovec *iov, int iovcnt) {
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = iovcnt,
+    };
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    return n;
+}
+
+static void ipc_client_update_mask(struct ipc_client *client) {
+    uint32_t mask = WL_EVENT_READABLE;
+    if (client->out_len > 0) mask |= WL_EVENT_WRITABLE;
+    wl_event_source_fd_update(client->event_source, mask);
+}
+
+// Append iov data, skipping the first `skip` bytes that already went out
+static bool ipc_queue_push(struct ipc_client *client, const struct iovec *iov,
+                           int iovcnt, size_t skip) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+    len -= skip;
+    
+    if (client->out_len + len > IPC_CLIENT_MAX_QUEUE) return false;
+    
+    if (client->out_len + len > client->out_size) {
+        size_t size = client->out_size ? client->out_size : 4096;
+        while (size < client->out_len + len) size *= 2;
+        
+        char *buffer = malloc(size);
+        if (!buffer) return false;
+        
+        // Linearize the old contents while growing
+        size_t first = client->out_size - client->out_head;
+        if (first > client->out_len) first = client->out_len;
+        if (client->out_len > 0) {
+            memcpy(buffer, client->out_buffer + client->out_head, first);
+            memcpy(buffer + first, client->out_buffer, client->out_len - first);
+        }
+        free(client->out_buffer);
+        client->out_buffer = buffer;
+        client->out_size = size;
+        client->out_head = 0;
+    }
     
-    if (payload_len > 0) {
-        memcpy(buffer + sizeof(struct ipc_header), payload, payload_len);
+    for (int i = 0; i < iovcnt; i++) {
+        const char *src = iov[i].iov_base;
+        size_t n = iov[i].iov_len;
+        if (skip >= n) {
+            skip -= n;
+            continue;
+        }
+        src += skip;
+        n -= skip;
+        skip = 0;
+        
+        while (n > 0) {
+            size_t tail = (client->out_head + client->out_len) % client->out_size;
+            size_t chunk = client->out_size - tail;
+            if (chunk > n) chunk = n;
+            memcpy(client->out_buffer + tail, src, chunk);
+            client->out_len += chunk;
+            src += chunk;
+            n -= chunk;
+        }
+    }
+    return true;
+}
+
+static void ipc_client_flush(struct ipc_client *client) {
+    while (client->out_len > 0) {
+        struct iovec iov[2];
+        int iovcnt = 1;
+        size_t first = client->out_size - client->out_head;
+        if (first >= client->out_len) {
+            first = client->out_len;
+        } else {
+            iov[1].iov_base = client->out_buffer;
+            iov[1].iov_len = client->out_len - first;
+            iovcnt = 2;
+        }
+        iov[0].iov_base = client->out_buffer + client->out_head;
+        iov[0].iov_len = first;
+        
+        ssize_t n = ipc_writev(client->fd, iov, iovcnt);
+        if (n < 0) {
+            ipc_client_kill(client, strerror(errno));
+            return;
+        }
+        if (n == 0) break;
+        
+        client->out_head = (client->out_head + n) % client->out_size;
+        client->out_len -= n;
     }
     
-    ssize_t written = write(client->fd, buffer, total_len);
-    (void)written;
+    if (client->out_len == 0) client->out_head = 0;
+    ipc_client_update_mask(client);
+}
+
+// Write as much as the socket takes now and queue the rest
+static void ipc_client_sendv(struct ipc_client *client, struct iovec *iov, int iovcnt,
+                             size_t total_len) {
+    if (client->dead) return;
+    
+    // Only write directly when nothing is queued, or messages would reorder
+    size_t written = 0;
+    if (client->out_len == 0) {
+        ssize_t n = ipc_writev(client->fd, iov, iovcnt);
+        if (n < 0) {
+            ipc_client_kill(client, strerror(errno));
+            return;
+        }
+        written = n;
+        if (written == total_len) return;
+    }
     
-    free(buffer);
+    if (!ipc_queue_push(client, iov, iovcnt, written)) {
+        ipc_client_kill(client, "outbound queue full");
+        return;
+    }
+    ipc_client_update_mask(client);
+}
+
+static void ipc_send_response(struct ipc_client *client, uint32_t type,
+                              const char *payload, size_t payload_len) {
+    struct ipc_header header;
+    memcpy(header.magic, IPC_MAGIC, IPC_MAGIC_LEN);
+    header.size = payload_len;
+    header.type = type;
+    
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = sizeof(header) },
+        { .iov_base = (void *)payload, .iov_len = payload_len },
+    };
+    ipc_client_sendv(client, iov, payload_len > 0 ? 2 : 1, sizeof(header) + payload_len);
+}
+
+// Every reply is built here; it only ever grows, so steady state is malloc-free
+static struct json_writer reply;
+
+static void ipc_send_reply(struct ipc_client *client, uint32_t type) {
+    ipc_send_response(client, type, reply.data, reply.len);
 }
 
-static void ipc_send_event(struct ipc_client *client, uint32_t event_type, const char *payload) {
-    if (!(client->subscribed_events & event_type)) return;
+/*
+ * ============================================================================
+ * Tree cache
+ * Every window keeps its serialized node together with the state it was
+ * built from. Workspaces and the full tree are reassembled from those
+ * strings only when something under them changed, so a bar polling an
+ * unchanged tree gets the cached reply.
+ * ============================================================================
+ */
+
+enum ipc_node_state {
+    IPC_NODE_FOCUSED = (1 << 0),
+    IPC_NODE_VISIBLE = (1 << 1),
+    IPC_NODE_FLOATING = (1 << 2),
+    IPC_NODE_FULLSCREEN = (1 << 3),
+    IPC_NODE_MINIMIZED = (1 << 4),
+};
+
+// Workspace and root ids live below any heap address used for windows
+#define IPC_ROOT_ID 1
+#define IPC_WORKSPACE_ID(ws) (100 + (ws))
+
+static struct {
+    bool dirty;
+    int current_workspace;
+    bool ws_dirty[MAX_WORKSPACES + 1];
+    struct json_writer ws[MAX_WORKSPACES + 1];
+    struct json_writer tree;
+} tree_cache = { .dirty = true };
+
+// Window nodes are built here before being copied into their cache
+static struct json_writer node_writer;
+
+// The workspace a node was cached under and the one it is on now
+static void ipc_node_mark_dirty(struct ipc_node_cache *cache, int workspace) {
+    cache->dirty = true;
+    if (cache->workspace >= 1 && cache->workspace <= MAX_WORKSPACES)
+        tree_cache.ws_dirty[cache->workspace] = true;
+    if (workspace >= 1 && workspace <= MAX_WORKSPACES)
+        tree_cache.ws_dirty[workspace] = true;
+}
+
+static void ipc_node_cache_free(struct ipc_node_cache *cache) {
+    free(cache->json);
+    cache->json = NULL;
+    cache->len = 0;
+    cache->cap = 0;
+}
+
+void ipc_tree_mark_dirty(struct server *server, struct toplevel *toplevel) {
+    ipc_state_mark_dirty(server);
+    tree_cache.dirty = true;
+    
+    if (!toplevel) {
+        for (int i = 0; i <= MAX_WORKSPACES; i++) tree_cache.ws_dirty[i] = true;
+        return;
+    }
     
-    uint32_t type = IPC_EVENT_MASK | event_type;
-    ipc_send_response(client, type, payload);
+    ipc_node_mark_dirty(&toplevel->ipc, toplevel->workspace);
+}
+
+void ipc_xwayland_mark_dirty(struct xwayland_surface *xsurface) {
+    ipc_state_mark_dirty(xsurface->server);
+    tree_cache.dirty = true;
+    ipc_node_mark_dirty(&xsurface->ipc, xsurface->workspace);
+}
+
+static void ipc_events_forget(struct server *server, struct toplevel *toplevel,
+                              struct xwayland_surface *xsurface);
+
+void ipc_toplevel_destroy(struct toplevel *toplevel) {
+    ipc_events_forget(toplevel->server, toplevel, NULL);
+    ipc_node_cache_free(&toplevel->ipc);
+}
+
+void ipc_xwayland_destroy(struct xwayland_surface *xsurface) {
+    ipc_events_forget(xsurface->server, NULL, xsurface);
+    ipc_node_cache_free(&xsurface->ipc);
+}
+
+static struct wlr_box ipc_output_box(struct server *server, struct output *output) {
+    struct wlr_box box = {0};
+    if (output) wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+    return box;
+}
+
+static void jw_kv_box(struct json_writer *w, const char *key, struct wlr_box box) {
+    jw_kv_rect(w, key, box.x, box.y, box.width, box.height);
+}
+
+static void ipc_window_snapshot(struct toplevel *toplevel, struct toplevel *focused,
+                                struct wlr_box *box, uint32_t *state) {
+    *box = toplevel_get_geometry(toplevel);
+    
+    *state = 0;
+    if (toplevel == focused) *state |= IPC_NODE_FOCUSED;
+    if (toplevel->workspace == toplevel->server->current_workspace && !toplevel->minimized)
+        *state |= IPC_NODE_VISIBLE;
+    if (toplevel->floating) *state |= IPC_NODE_FLOATING;
+    if (toplevel->fullscreen) *state |= IPC_NODE_FULLSCREEN;
+    if (toplevel->minimized) *state |= IPC_NODE_MINIMIZED;
+}
+
+// X11 windows that are nodes: mapped, and not override-redirect menus or tooltips
+static bool ipc_xwindow_listed(struct xwayland_surface *xsurface) {
+    return !xsurface->override_redirect && xsurface->scene_tree &&
+           xsurface->xwayland_surface->surface;
+}
+
+static void ipc_xwindow_snapshot(struct xwayland_surface *xsurface,
+                                 struct xwayland_surface *focused,
+                                 struct wlr_box *box, uint32_t *state) {
+    struct wlr_xwayland_surface *xs = xsurface->xwayland_surface;
+    struct wlr_scene_node *node = xsurface->decor.tree ?
+        &xsurface->decor.tree->node : &xsurface->scene_tree->node;
+    *box = (struct wlr_box){ node->x, node->y, xs->width, xs->height };
+    
+    // Workspace switches leave X11 windows alone, so report what is shown
+    *state = 0;
+    if (xsurface == focused) *state |= IPC_NODE_FOCUSED;
+    if (node->enabled && !xsurface->minimized) *state |= IPC_NODE_VISIBLE;
+    if (xsurface->floating) *state |= IPC_NODE_FLOATING;
+    if (xsurface->fullscreen) *state |= IPC_NODE_FULLSCREEN;
+    if (xsurface->minimized) *state |= IPC_NODE_MINIMIZED;
+}
+
+// xs is set for X11 windows, which also report their X11 properties like sway
+static void ipc_window_serialize(struct ipc_node_cache *cache, uintptr_t id,
+                                 const char *name, const char *app_id, pid_t pid,
+                                 struct wlr_xwayland_surface *xs, int decor_h,
+                                 char **marks, int mark_count,
+                                 struct wlr_box box, uint32_t state) {
+    struct json_writer *w = &node_writer;
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_key(w, "id");
+    jw_uint(w, id);
+    jw_kv_string(w, "type", (state & IPC_NODE_FLOATING) ? "floating_con" : "con");
+    jw_kv_string(w, "name", name);
+    jw_kv_string(w, "app_id", app_id);
+    jw_kv_int(w, "pid", pid);
+    jw_kv_string(w, "shell", xs ? "xwayland" : "xdg_shell");
+    if (xs) {
+        jw_kv_int(w, "window", xs->window_id);
+        jw_key(w, "window_properties");
+        jw_object_begin(w);
+        jw_kv_string(w, "class", xs->class);
+        jw_kv_string(w, "instance", xs->instance);
+        jw_kv_string(w, "title", xs->title);
+        jw_object_end(w);
+    }
+    jw_kv_bool(w, "focused", state & IPC_NODE_FOCUSED);
+    jw_kv_bool(w, "visible", state & IPC_NODE_VISIBLE);
+    jw_kv_bool(w, "urgent", false);
+    jw_kv_int(w, "fullscreen_mode", (state & IPC_NODE_FULLSCREEN) ? 1 : 0);
+    jw_kv_string(w, "border", decor_h ? "normal" : "none");
+    jw_kv_string(w, "layout", "none");
+    jw_kv_string(w, "orientation", "none");
+    jw_kv_rect(w, "rect", box.x, box.y, box.width, box.height + decor_h);
+    jw_kv_rect(w, "window_rect", 0, decor_h, box.width, box.height);
+    jw_kv_rect(w, "deco_rect", 0, 0, box.width, decor_h);
+    jw_kv_rect(w, "geometry", 0, 0, box.width, box.height);
+    jw_key(w, "marks");
+    jw_array_begin(w);
+    for (int i = 0; i < mark_count; i++) jw_string(w, marks[i]);
+    jw_array_end(w);
+    jw_key(w, "nodes");
+    jw_array_begin(w);
+    jw_array_end(w);
+    jw_key(w, "floating_nodes");
+    jw_array_begin(w);
+    jw_array_end(w);
+    jw_object_end(w);
+    if (w->failed) return;
+    
+    if (w->len + 1 > cache->cap) {
+        char *json = realloc(cache->json, w->len + 1);
+        if (!json) return;
+        cache->json = json;
+        cache->cap = w->len + 1;
+    }
+    memcpy(cache->json, w->data, w->len + 1);
+    cache->len = w->len;
 }
 
-// JSON builders
-char *ipc_json_describe_workspace(struct server *server, int workspace) {
-    struct json_object *obj = json_object_new_object();
+// Record what a node reports now; true if its cached JSON has to be rebuilt
+static bool ipc_node_update(struct ipc_node_cache *cache, struct wlr_box box,
+                            uint32_t state, int workspace) {
+    if (cache->json && !cache->dirty && cache->state == state &&
+        cache->workspace == workspace &&
+        memcmp(&cache->box, &box, sizeof(box)) == 0) {
+        return false;
+    }
     
-    json_object_object_add(obj, "num", json_object_new_int(workspace));
-    json_object_object_add(obj, "name", json_object_new_string(
-        workspace == 1 ? "1" :
-        workspace == 2 ? "2" :
-        workspace == 3 ? "3" :
-        workspace == 4 ? "4" : "5"));
+    if (cache->workspace >= 1 && cache->workspace <= MAX_WORKSPACES)
+        tree_cache.ws_dirty[cache->workspace] = true;
+    if (workspace >= 1 && workspace <= MAX_WORKSPACES)
+        tree_cache.ws_dirty[workspace] = true;
+    tree_cache.dirty = true;
+    
+    cache->box = box;
+    cache->state = state;
+    cache->workspace = workspace;
+    cache->dirty = false;
+    return true;
+}
+
+// Re-serialize a window if anything it reports changed; true if it did
+static bool ipc_window_refresh(struct toplevel *toplevel, struct toplevel *focused) {
+    struct wlr_box box;
+    uint32_t state;
+    ipc_window_snapshot(toplevel, focused, &box, &state);
+    if (!ipc_node_update(&toplevel->ipc, box, state, toplevel->workspace)) return false;
+    
+    struct wlr_xdg_toplevel *xdg = toplevel->xdg_toplevel;
+    pid_t pid = 0;
+    if (xdg->resource) {
+        wl_client_get_credentials(wl_resource_get_client(xdg->resource), &pid, NULL, NULL);
+    }
+    ipc_window_serialize(&toplevel->ipc, (uintptr_t)toplevel, xdg->title, xdg->app_id,
+                         pid, NULL, toplevel->decor.tree ? config.decor.height : 0,
+                         toplevel->marks, toplevel->mark_count, box, state);
+    return true;
+}
+
+// An unmapped X11 window keeps its last node, which its close event carries
+static bool ipc_xwindow_refresh(struct xwayland_surface *xsurface,
+                                struct xwayland_surface *focused) {
+    if (!ipc_xwindow_listed(xsurface)) return false;
+    
+    struct wlr_box box;
+    uint32_t state;
+    ipc_xwindow_snapshot(xsurface, focused, &box, &state);
+    if (!ipc_node_update(&xsurface->ipc, box, state, xsurface->workspace)) return false;
+    
+    struct wlr_xwayland_surface *xs = xsurface->xwayland_surface;
+    ipc_window_serialize(&xsurface->ipc, (uintptr_t)xsurface, xs->title, xs->class,
+                         xs->pid, xs, xsurface->decor.tree ? config.decor.height : 0,
+                         NULL, 0, box, state);
+    return true;
+}
+
+static bool ipc_workspace_occupied(struct server *server, int ws) {
+    if (!workspace_is_empty(server, ws)) return true;
     
-    json_object_object_add(obj, "visible", 
-        json_object_new_boolean(workspace == server->current_workspace));
-    json_object_object_add(obj, "focused", 
-        json_object_new_boolean(workspace == server->current_workspace));
-    json_object_object_add(obj, "urgent", json_object_new_boolean(false));
+    struct xwayland_surface *xsurface;
+    wl_list_for_each(xsurface, &server->xwayland_surfaces, link) {
+        if (ipc_xwindow_listed(xsurface) && xsurface->workspace == ws) return true;
+    }
+    return false;
+}
+
+static void ipc_workspace_serialize(struct server *server, int ws, struct output *output,
+                                    bool window_focused) {
+    struct json_writer *w = &tree_cache.ws[ws];
+    bool current = ws == server->current_workspace;
+    char name[8];
+    snprintf(name, sizeof(name), "%d", ws);
+    
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_kv_int(w, "id", IPC_WORKSPACE_ID(ws));
+    jw_kv_string(w, "type", "workspace");
+    jw_kv_string(w, "name", name);
+    jw_kv_int(w, "num", ws);
+    jw_kv_string(w, "output", output ? output->wlr_output->name : NULL);
+    jw_kv_bool(w, "focused", current && !window_focused);
+    jw_kv_bool(w, "visible", current);
+    jw_kv_bool(w, "urgent", false);
+    jw_kv_string(w, "layout", "splith");
+    jw_kv_string(w, "orientation", "horizontal");
+    jw_kv_box(w, "rect", ipc_output_box(server, output));
+    
+    for (int floating = 0; floating <= 1; floating++) {
+        jw_key(w, floating ? "floating_nodes" : "nodes");
+        jw_array_begin(w);
+        struct toplevel *toplevel;
+        wl_list_for_each(toplevel, &server->toplevels, link) {
+            if (toplevel->workspace != ws || toplevel->floating != floating || !toplevel->ipc.json)
+                continue;
+            jw_raw(w, toplevel->ipc.json, toplevel->ipc.len);
+        }
+        struct xwayland_surface *xsurface;
+        wl_list_for_each(xsurface, &server->xwayland_surfaces, link) {
+            if (!ipc_xwindow_listed(xsurface) || xsurface->workspace != ws ||
+                xsurface->floating != floating || !xsurface->ipc.json)
+                continue;
+            jw_raw(w, xsurface->ipc.json, xsurface->ipc.len);
+        }
+        jw_array_end(w);
+    }
+    jw_object_end(w);
     
-    struct json_object *rect = json_object_new_object();
-    json_object_object_add(rect, "x", json_object_new_int(0));
-    json_object_object_add(rect, "y", json_object_new_int(0));
-    json_object_object_add(rect, "width", json_object_new_int(1920));
-    json_object_object_add(rect, "height", json_object_new_int(1080));
-    json_object_object_add(obj, "rect", rect);
+    tree_cache.ws_dirty[ws] = false;
+}
+
+static const struct json_writer *ipc_tree_get(struct server *server) {
+    struct toplevel *focused = get_focused_toplevel(server);
+    struct xwayland_surface *xfocused = xwayland_get_focused(server);
     
-    json_object_object_add(obj, "output", json_object_new_string("HDMI-A-1"));
+    if (tree_cache.current_workspace != server->current_workspace) {
+        tree_cache.current_workspace = server->current_workspace;
+        ipc_tree_mark_dirty(server, NULL);
+    }
     
-    const char *json_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
-    char *result = strdup(json_str);
-    json_object_put(obj);
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+        ipc_window_refresh(toplevel, focused);
+    }
+    struct xwayland_surface *xsurface;
+    wl_list_for_each(xsurface, &server->xwayland_surfaces, link) {
+        ipc_xwindow_refresh(xsurface, xfocused);
+    }
+    
+    struct json_writer *w = &tree_cache.tree;
+    if (!tree_cache.dirty && w->data) return w;
+    
+    // All workspaces are global and shown on the primary output
+    struct output *primary = output_get_primary(server);
+    struct wlr_box root_box;
+    wlr_output_layout_get_box(server->output_layout, NULL, &root_box);
+    
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_kv_int(w, "id", IPC_ROOT_ID);
+    jw_kv_string(w, "type", "root");
+    jw_kv_string(w, "name", "root");
+    jw_kv_bool(w, "focused", false);
+    jw_kv_string(w, "layout", "splith");
+    jw_kv_string(w, "orientation", "horizontal");
+    jw_kv_box(w, "rect", root_box);
+    jw_key(w, "nodes");
+    jw_array_begin(w);
     
-    return result;
+    struct output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        char current[8];
+        snprintf(current, sizeof(current), "%d", server->current_workspace);
+        
+        jw_object_begin(w);
+        jw_key(w, "id");
+        jw_uint(w, (uintptr_t)output);
+        jw_kv_string(w, "type", "output");
+        jw_kv_string(w, "name", output->wlr_output->name);
+        jw_kv_bool(w, "active", true);
+        jw_kv_bool(w, "focused", false);
+        jw_kv_string(w, "layout", "output");
+        jw_kv_string(w, "current_workspace", current);
+        jw_kv_box(w, "rect", ipc_output_box(server, output));
+        jw_key(w, "nodes");
+        jw_array_begin(w);
+        
+        if (output == primary) {
+            for (int ws = 1; ws <= MAX_WORKSPACES; ws++) {
+                // Like i3, only occupied workspaces and the focused one exist
+                if (ws != server->current_workspace && !ipc_workspace_occupied(server, ws))
+                    continue;
+                if (tree_cache.ws_dirty[ws] || tree_cache.ws[ws].len == 0)
+                    ipc_workspace_serialize(server, ws, output, focused || xfocused);
+                jw_raw(w, tree_cache.ws[ws].data, tree_cache.ws[ws].len);
+            }
+        }
+        jw_array_end(w);
+        jw_key(w, "floating_nodes");
+        jw_array_begin(w);
+        jw_array_end(w);
+        jw_object_end(w);
+    }
+    jw_array_end(w);
+    jw_key(w, "floating_nodes");
+    jw_array_begin(w);
+    jw_array_end(w);
+    jw_object_end(w);
+    
+    tree_cache.dirty = w->failed;
+    return w;
 }
 
-char *ipc_json_describe_workspaces(struct server *server) {
-    struct json_object *arr = json_object_new_array();
+/*
+ * ============================================================================
+ * JSON builders
+ * All of these write into the shared reply writer.
+ * ============================================================================
+ */
+
+static void ipc_json_describe_workspaces(struct server *server) {
+    struct output *output = output_get_primary(server);
+    struct wlr_box box = ipc_output_box(server, output);
     
+    jw_reset(&reply);
+    jw_array_begin(&reply);
     for (int i = 1; i <= MAX_WORKSPACES; i++) {
-        struct json_object *ws = json_object_new_object();
-        
-        json_object_object_add(ws, "num", json_object_new_int(i));
+        bool current = i == server->current_workspace;
+        if (!current && !ipc_workspace_occupied(server, i)) continue;
         
         char name[8];
         snprintf(name, sizeof(name), "%d", i);
-        json_object_object_add(ws, "name", json_object_new_string(name));
-        
-        json_object_object_add(ws, "visible", 
-            json_object_new_boolean(i == server->current_workspace));
-        json_object_object_add(ws, "focused", 
-            json_object_new_boolean(i == server->current_workspace));
-        json_object_object_add(ws, "urgent", json_object_new_boolean(false));
         
-        struct json_object *rect = json_object_new_object();
-        json_object_object_add(rect, "x", json_object_new_int(0));
-        json_object_object_add(rect, "y", json_object_new_int(0));
-        json_object_object_add(rect, "width", json_object_new_int(1920));
-        json_object_object_add(rect, "height", json_object_new_int(1080));
-        json_object_object_add(ws, "rect", rect);
-        
-        json_object_object_add(ws, "output", json_object_new_string("HDMI-A-1"));
-        
-        json_object_array_add(arr, ws);
+        jw_object_begin(&reply);
+        jw_kv_int(&reply, "id", IPC_WORKSPACE_ID(i));
+        jw_kv_int(&reply, "num", i);
+        jw_kv_string(&reply, "name", name);
+        jw_kv_bool(&reply, "visible", current);
+        jw_kv_bool(&reply, "focused", current);
+        jw_kv_bool(&reply, "urgent", false);
+        jw_kv_box(&reply, "rect", box);
+        jw_kv_string(&reply, "output", output ? output->wlr_output->name : NULL);
+        jw_object_end(&reply);
     }
-    
-    const char *json_str = json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PLAIN);
-    char *result = strdup(json_str);
-    json_object_put(arr);
-    
-    return result;
+    jw_array_end(&reply);
 }
 
-char *ipc_json_describe_outputs(struct server *server) {
-    struct json_object *arr = json_object_new_array();
+static void ipc_json_describe_outputs(struct server *server) {
+    struct output *primary = output_get_primary(server);
+    char current[8];
+    snprintf(current, sizeof(current), "%d", server->current_workspace);
     
+    jw_reset(&reply);
+    jw_array_begin(&reply);
     struct output *output;
     wl_list_for_each(output, &server->outputs, link) {
-        struct json_object *obj = json_object_new_object();
-        
-        json_object_object_add(obj, "name", 
-            json_object_new_string(output->wlr_output->name));
-        json_object_object_add(obj, "active", json_object_new_boolean(true));
-        json_object_object_add(obj, "primary", json_object_new_boolean(true));
-        
-        struct json_object *rect = json_object_new_object();
-        json_object_object_add(rect, "x", json_object_new_int(0));
-        json_object_object_add(rect, "y", json_object_new_int(0));
-        json_object_object_add(rect, "width", 
-            json_object_new_int(output->wlr_output->width));
-        json_object_object_add(rect, "height", 
-            json_object_new_int(output->wlr_output->height));
-        json_object_object_add(obj, "rect", rect);
+        struct wlr_output *wlr_output = output->wlr_output;
         
-        json_object_object_add(obj, "current_workspace", 
-            json_object_new_string("1"));
-        
-        json_object_array_add(arr, obj);
+        jw_object_begin(&reply);
+        jw_kv_string(&reply, "name", wlr_output->name);
+        jw_kv_string(&reply, "make", wlr_output->make);
+        jw_kv_string(&reply, "model", wlr_output->model);
+        jw_kv_bool(&reply, "active", wlr_output->enabled);
+        jw_kv_bool(&reply, "primary", output == primary);
+        jw_key(&reply, "scale");
+        jw_double(&reply, wlr_output->scale);
+        jw_kv_box(&reply, "rect", ipc_output_box(server, output));
+        jw_kv_string(&reply, "current_workspace", output == primary ? current : NULL);
+        jw_object_end(&reply);
     }
-    
-    const char *json_str = json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PLAIN);
-    char *result = strdup(json_str);
-    json_object_put(arr);
-    
-    return result;
+    jw_array_end(&reply);
 }
 
-char *ipc_json_describe_tree(struct server *server) {
-    struct json_object *root = json_object_new_object();
-    
-    json_object_object_add(root, "id", json_object_new_int(1));
-    json_object_object_add(root, "type", json_object_new_string("root"));
-    json_object_object_add(root, "orientation", json_object_new_string("none"));
-    json_object_object_add(root, "focused", json_object_new_boolean(false));
-    
-    struct json_object *nodes = json_object_new_array();
-    json_object_object_add(root, "nodes", nodes);
-    
-    const char *json_str = json_object_to_json_string_ext(root, JSON_C_TO_STRING_PLAIN);
-    char *result = strdup(json_str);
-    json_object_put(root);
-    
-    return result;
+static void ipc_json_describe_version(void) {
+    jw_reset(&reply);
+    jw_object_begin(&reply);
+    jw_kv_string(&reply, "human_readable", "starview 0.1.0");
+    jw_kv_string(&reply, "variant", "starview");
+    jw_kv_int(&reply, "major", 0);
+    jw_kv_int(&reply, "minor", 1);
+    jw_kv_int(&reply, "patch", 0);
+    jw_object_end(&reply);
 }
 
-char *ipc_json_describe_version(void) {
-    struct json_object *obj = json_object_new_object();
-    
-    json_object_object_add(obj, "human_readable", 
-        json_object_new_string("starview 0.1.0"));
-    json_object_object_add(obj, "variant", json_object_new_string("starview"));
-    json_object_object_add(obj, "major", json_object_new_int(0));
-    json_object_object_add(obj, "minor", json_object_new_int(1));
-    json_object_object_add(obj, "patch", json_object_new_int(0));
-    
-    const char *json_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
-    char *result = strdup(json_str);
-    json_object_put(obj);
-    
-    return result;
+static void ipc_json_describe_stats(void);
+
+static void ipc_json_success(bool success, bool array) {
+    jw_reset(&reply);
+    if (array) jw_array_begin(&reply);
+    jw_object_begin(&reply);
+    jw_kv_bool(&reply, "success", success);
+    jw_object_end(&reply);
+    if (array) jw_array_end(&reply);
+}
+
+static void ipc_command_report(void *data, bool success, const char *error) {
+    (void)data;
+    jw_object_begin(&reply);
+    jw_kv_bool(&reply, "success", success);
+    if (error) {
+        jw_kv_bool(&reply, "parse_error", false);
+        jw_kv_string(&reply, "error", error);
+    }
+    jw_object_end(&reply);
 }
 
+// One result object per command, in order, like sway
 static void ipc_handle_command(struct ipc_client *client, const char *payload) {
     if (!payload) return;
     
-    // Parse command and execute
-    if (strncmp(payload, "workspace ", 10) == 0) {
-        int ws = atoi(payload + 10);
-        if (ws >= 1 && ws <= MAX_WORKSPACES) {
-            workspace_show(client->server, ws);
+    jw_reset(&reply);
+    jw_array_begin(&reply);
+    command_execute(client->server, payload, ipc_command_report, NULL);
+    jw_array_end(&reply);
+    
+    ipc_send_reply(client, IPC_COMMAND);
+}
+
+static void ipc_json_describe_marks(struct server *server) {
+    jw_reset(&reply);
+    jw_array_begin(&reply);
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+        for (int i = 0; i < toplevel->mark_count; i++) jw_string(&reply, toplevel->marks[i]);
+    }
+    jw_array_end(&reply);
+}
+
+static void ipc_tick_build(struct json_writer *w, bool first, const char *payload);
+static void ipc_event_tick(struct server *server, const char *payload);
+
+static void ipc_filter_free(struct ipc_filter *filter) {
+    for (int i = 0; i < filter->change_count; i++) free(filter->changes[i]);
+    free(filter->changes);
+    free(filter->app_id);
+    free(filter->output);
+}
+
+static uint32_t ipc_event_type_from_name(const char *name) {
+    if (!name) return 0;
+    if (strcmp(name, "workspace") == 0) return IPC_EVENT_WORKSPACE;
+    if (strcmp(name, "window") == 0) return IPC_EVENT_WINDOW;
+    if (strcmp(name, "mode") == 0) return IPC_EVENT_MODE;
+    if (strcmp(name, "tick") == 0) return IPC_EVENT_TICK;
+    return 0;
+}
+
+static char *ipc_json_strdup(struct json_object *obj, const char *key) {
+    struct json_object *value;
+    if (!json_object_object_get_ex(obj, key, &value)) return NULL;
+    const char *str = json_object_get_string(value);
+    return str ? strdup(str) : NULL;
+}
+
+/*
+ * Subscription items are either an event name, as in i3, or an object that
+ * narrows it down:
+ *
+ *   {"event": "window", "change": ["focus", "title"], "app_id": "firefox*",
+ *    "workspace": 2, "output": "DP-1"}
+ */
+static const char *ipc_filter_parse(struct json_object *item, struct ipc_filter *filter) {
+    memset(filter, 0, sizeof(*filter));
+    
+    if (json_object_is_type(item, json_type_string)) {
+        filter->type = ipc_event_type_from_name(json_object_get_string(item));
+        return filter->type ? NULL : "unknown event";
+    }
+    if (!json_object_is_type(item, json_type_object)) return "invalid subscription";
+    
+    struct json_object *value;
+    if (!json_object_object_get_ex(item, "event", &value)) return "missing \"event\"";
+    filter->type = ipc_event_type_from_name(json_object_get_string(value));
+    if (!filter->type) return "unknown event";
+    
+    if (json_object_object_get_ex(item, "change", &value)) {
+        bool array = json_object_is_type(value, json_type_array);
+        int count = array ? (int)json_object_array_length(value) : 1;
+        filter->changes = calloc(count, sizeof(*filter->changes));
+        if (!filter->changes) return "out of memory";
+        for (int i = 0; i < count; i++) {
+            struct json_object *change = array ? json_object_array_get_idx(value, i) : value;
+            const char *name = json_object_get_string(change);
+            if (!name) return "invalid change";
+            filter->changes[filter->change_count++] = strdup(name);
         }
-    } else if (strcmp(payload, "reload") == 0) {
-        config_reload();
-        config_apply_live(client->server);
-    } else if (strcmp(payload, "exit") == 0) {
-        wl_display_terminate(client->server->display);
     }
     
-    struct json_object *arr = json_object_new_array();
-    struct json_object *result = json_object_new_object();
-    json_object_object_add(result, "success", json_object_new_boolean(true));
-    json_object_array_add(arr, result);
-    
-    const char *json_str = json_object_to_json_string_ext(arr, JSON_C_TO_STRING_PLAIN);
-    ipc_send_response(client, IPC_COMMAND, json_str);
-    json_object_put(arr);
+    filter->app_id = ipc_json_strdup(item, "app_id");
+    filter->output = ipc_json_strdup(item, "output");
+    if (json_object_object_get_ex(item, "workspace", &value)) {
+        filter->workspace = json_object_get_int(value);
+        if (filter->workspace < 1 || filter->workspace > MAX_WORKSPACES) return "invalid workspace";
+    }
+    return NULL;
 }
 
 static void ipc_handle_subscribe(struct ipc_client *client, const char *payload) {
-    if (!payload) return;
-    
-    struct json_object *obj = json_tokener_parse(payload);
-    if (!obj) return;
+    // Every path replies; a client blocks on the answer to SUBSCRIBE
+    struct json_object *obj = payload ? json_tokener_parse(payload) : NULL;
+    if (!obj || !json_object_is_type(obj, json_type_array)) {
+        json_object_put(obj);
+        ipc_json_success(false, false);
+        ipc_send_reply(client, IPC_SUBSCRIBE);
+        return;
+    }
     
+    // All or nothing: a bad item leaves the existing subscriptions alone
     size_t len = json_object_array_length(obj);
-    for (size_t i = 0; i < len; i++) {
-        struct json_object *item = json_object_array_get_idx(obj, i);
-        const char *event = json_object_get_string(item);
-        
-        if (strcmp(event, "workspace") == 0) {
-            client->subscribed_events |= IPC_EVENT_WORKSPACE;
-        } else if (strcmp(event, "window") == 0) {
-            client->subscribed_events |= IPC_EVENT_WINDOW;
-        } else if (strcmp(event, "mode") == 0) {
-            client->subscribed_events |= IPC_EVENT_MODE;
+    struct ipc_filter *filters = realloc(client->filters,
+        (client->filter_count + len) * sizeof(*filters));
+    if (!filters && len > 0) {
+        json_object_put(obj);
+        jw_reset(&reply);
+        jw_object_begin(&reply);
+        jw_kv_bool(&reply, "success", false);
+        jw_kv_string(&reply, "error", "out of memory");
+        jw_object_end(&reply);
+        ipc_send_reply(client, IPC_SUBSCRIBE);
+        return;
+    }
+    if (filters) client->filters = filters;
+    
+    const char *error = NULL;
+    int added = 0;
+    for (size_t i = 0; i < len && !error; i++) {
+        struct ipc_filter *filter = &client->filters[client->filter_count + added];
+        error = ipc_filter_parse(json_object_array_get_idx(obj, i), filter);
+        if (error) ipc_filter_free(filter);
+        else added++;
+    }
+    json_object_put(obj);
+    
+    uint32_t before = client->subscribed_events;
+    if (error) {
+        for (int i = 0; i < added; i++) ipc_filter_free(&client->filters[client->filter_count + i]);
+    } else {
+        for (int i = 0; i < added; i++) {
+            client->subscribed_events |= client->filters[client->filter_count + i].type;
         }
+        client->filter_count += added;
     }
     
-    struct json_object *result = json_object_new_object();
-    json_object_object_add(result, "success", json_object_new_boolean(true));
+    jw_reset(&reply);
+    jw_object_begin(&reply);
+    jw_kv_bool(&reply, "success", !error);
+    if (error) jw_kv_string(&reply, "error", error);
+    jw_object_end(&reply);
+    ipc_send_reply(client, IPC_SUBSCRIBE);
+    
+    // Like i3, a new tick subscriber immediately gets a "first" tick
+    if (!(before & IPC_EVENT_TICK) && (client->subscribed_events & IPC_EVENT_TICK)) {
+        ipc_tick_build(&reply, true, "");
+        ipc_send_response(client, IPC_EVENT_MASK | IPC_EVENT_TICK, reply.data, reply.len);
+    }
+}
+
+// Reply with the state page memfd and a change eventfd attached
+static void ipc_handle_get_state_fd(struct ipc_client *client) {
+    int memfd = ipc_state_get_fd(client->server);
+    if (memfd >= 0 && client->state_eventfd < 0) {
+        client->state_eventfd = ipc_state_eventfd_new();
+    }
     
-    const char *json_str = json_object_to_json_string_ext(result, JSON_C_TO_STRING_PLAIN);
-    ipc_send_response(client, IPC_SUBSCRIBE, json_str);
-    json_object_put(result);
-    json_object_put(obj);
+    // Ancillary data rides on the first byte, so it cannot go behind a queue
+    bool ok = memfd >= 0 && client->state_eventfd >= 0 && client->out_len == 0;
+    ipc_json_success(ok, false);
+    if (!ok) {
+        ipc_send_reply(client, IPC_GET_STATE_FD);
+        return;
+    }
+    
+    struct ipc_header header;
+    memcpy(header.magic, IPC_MAGIC, IPC_MAGIC_LEN);
+    header.size = reply.len;
+    header.type = IPC_GET_STATE_FD;
+    struct iovec iov[2] = {
+        { .iov_base = &header, .iov_len = sizeof(header) },
+        { .iov_base = reply.data, .iov_len = reply.len },
+    };
+    
+    int fds[2] = { memfd, client->state_eventfd };
+    union {
+        char buf[CMSG_SPACE(sizeof(fds))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+    
+    struct msghdr msg = {
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    
+    ssize_t n;
+    do {
+        n = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ipc_client_kill(client, strerror(errno));
+            return;
+        }
+        // Nothing went out, so the fds did not either; let the client retry
+        ipc_json_success(false, false);
+        ipc_send_reply(client, IPC_GET_STATE_FD);
+        return;
+    }
+    
+    size_t total_len = sizeof(header) + reply.len;
+    if ((size_t)n < total_len && !ipc_queue_push(client, iov, 2, n)) {
+        ipc_client_kill(client, "outbound queue full");
+        return;
+    }
+    ipc_client_update_mask(client);
 }
 
+static void ipc_sync_request(struct ipc_client *client);
+
 static void ipc_client_handle_command(struct ipc_client *client, uint32_t type, const char *payload, uint32_t size) {
     (void)size;
     
@@ -281,30 +956,26 @@ static void ipc_client_handle_command(struct ipc_client *client, uint32_t type,
     }
     
     case IPC_GET_WORKSPACES: {
-        char *json = ipc_json_describe_workspaces(client->server);
-        ipc_send_response(client, IPC_GET_WORKSPACES, json);
-        free(json);
+        ipc_json_describe_workspaces(client->server);
+        ipc_send_reply(client, IPC_GET_WORKSPACES);
         break;
     }
     
     case IPC_GET_OUTPUTS: {
-        char *json = ipc_json_describe_outputs(client->server);
-        ipc_send_response(client, IPC_GET_OUTPUTS, json);
-        free(json);
+        ipc_json_describe_outputs(client->server);
+        ipc_send_reply(client, IPC_GET_OUTPUTS);
         break;
     }
     
     case IPC_GET_TREE: {
-        char *json = ipc_json_describe_tree(client->server);
-        ipc_send_response(client, IPC_GET_TREE, json);
-        free(json);
+        const struct json_writer *tree = ipc_tree_get(client->server);
+        ipc_send_response(client, IPC_GET_TREE, tree->data, tree->len);
         break;
     }
     
     case IPC_GET_VERSION: {
-        char *json = ipc_json_describe_version();
-        ipc_send_response(client, IPC_GET_VERSION, json);
-        free(json);
+        ipc_json_describe_version();
+        ipc_send_reply(client, IPC_GET_VERSION);
         break;
     }
     
@@ -313,31 +984,102 @@ static void ipc_client_handle_command(struct ipc_client *client, uint32_t type,
         break;
     }
     
+    case IPC_SEND_TICK: {
+        ipc_event_tick(client->server, payload ? payload : "");
+        ipc_json_success(true, false);
+        ipc_send_reply(client, IPC_SEND_TICK);
+        break;
+    }
+    
+    case IPC_SYNC: {
+        ipc_sync_request(client);
+        break;
+    }
+    
+    case IPC_GET_MARKS: {
+        ipc_json_describe_marks(client->server);
+        ipc_send_reply(client, IPC_GET_MARKS);
+        break;
+    }
+    
+    case IPC_GET_STATE_FD: {
+        ipc_handle_get_state_fd(client);
+        break;
+    }
+    
+    case IPC_GET_STATS: {
+        ipc_json_describe_stats();
+        ipc_send_reply(client, IPC_GET_STATS);
+        break;
+    }
+    
     default:
         break;
     }
 }
 
+static void ipc_sync_client_gone(struct ipc_client *client);
+
 void ipc_client_disconnect(struct ipc_client *client) {
+    ipc_sync_client_gone(client);
     wl_list_remove(&client->link);
     wl_event_source_remove(client->event_source);
+    if (client->idle_source) wl_event_source_remove(client->idle_source);
     close(client->fd);
+    if (client->state_eventfd >= 0) ipc_state_eventfd_release(client->state_eventfd);
+    for (int i = 0; i < client->filter_count; i++) ipc_filter_free(&client->filters[i]);
+    free(client->filters);
     free(client->read_buffer);
+    free(client->out_buffer);
     free(client);
 }
 
-static int ipc_client_handle_readable(int fd, uint32_t mask, void *data) {
-    struct ipc_client *client = data;
-    (void)mask;
+// Make room for at least `need` more bytes after the unread data
+static bool ipc_read_reserve(struct ipc_client *client, size_t need) {
+    size_t unread = client->read_buffer_len - client->read_pos;
+    
+    if (client->read_pos > 0 &&
+        client->read_buffer_size - client->read_buffer_len < need) {
+        memmove(client->read_buffer, client->read_buffer + client->read_pos, unread);
+        client->read_buffer_len = unread;
+        client->read_pos = 0;
+    }
+    
+    if (client->read_buffer_size - client->read_buffer_len >= need) return true;
     
-    if (client->read_buffer_size == 0) {
-        client->read_buffer_size = 4096;
-        client->read_buffer = malloc(client->read_buffer_size);
+    size_t size = client->read_buffer_size ? client->read_buffer_size : 4096;
+    while (size - client->read_buffer_len < need) size *= 2;
+    
+    char *buffer = realloc(client->read_buffer, size);
+    if (!buffer) return false;
+    client->read_buffer = buffer;
+    client->read_buffer_size = size;
+    return true;
+}
+
+static int ipc_client_handle_readable(int fd, struct ipc_client *client) {
+    // Always have room for a header; a known-size body gets room for all of it
+    size_t need = sizeof(struct ipc_header);
+    size_t unread = client->read_buffer_len - client->read_pos;
+    if (unread >= sizeof(struct ipc_header)) {
+        struct ipc_header header;
+        memcpy(&header, client->read_buffer + client->read_pos, sizeof(header));
+        if (header.size <= IPC_MAX_MESSAGE_SIZE)
+            need = sizeof(header) + header.size - unread;
+    }
+    if (need < 4096) need = 4096;
+    
+    if (!ipc_read_reserve(client, need)) {
+        ipc_client_kill(client, "out of memory");
+        return 0;
     }
     
     ssize_t n = read(fd, client->read_buffer + client->read_buffer_len,
                      client->read_buffer_size - client->read_buffer_len);
     
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
     if (n <= 0) {
         ipc_client_disconnect(client);
         return 0;
@@ -345,32 +1087,72 @@ static int ipc_client_handle_readable(int fd, uint32_t mask, void *data) {
     
     client->read_buffer_len += n;
     
-    while (client->read_buffer_len >= sizeof(struct ipc_header)) {
-        struct ipc_header *header = (struct ipc_header *)client->read_buffer;
+    while (client->read_buffer_len - client->read_pos >= sizeof(struct ipc_header)) {
+        char *msg = client->read_buffer + client->read_pos;
+        struct ipc_header header;
+        memcpy(&header, msg, sizeof(header));
         
-        if (memcmp(header->magic, IPC_MAGIC, IPC_MAGIC_LEN) != 0) {
-            ipc_client_disconnect(client);
+        if (memcmp(header.magic, IPC_MAGIC, IPC_MAGIC_LEN) != 0) {
+            ipc_client_kill(client, "bad magic");
+            return 0;
+        }
+        if (header.size > IPC_MAX_MESSAGE_SIZE) {
+            ipc_client_kill(client, "message too large");
             return 0;
         }
         
-        size_t total_len = sizeof(struct ipc_header) + header->size;
-        if (client->read_buffer_len < total_len) {
+        size_t total_len = sizeof(struct ipc_header) + header.size;
+        if (client->read_buffer_len - client->read_pos < total_len) {
             break;
         }
         
+        // Terminate the payload in place; the byte borrowed belongs to the
+        // next message (or is spare) and is put back right after
         char *payload = NULL;
-        if (header->size > 0) {
-            payload = malloc(header->size + 1);
-            memcpy(payload, client->read_buffer + sizeof(struct ipc_header), header->size);
-            payload[header->size] = '\0';
+        char saved = '\0';
+        if (header.size > 0) {
+            if (client->read_pos + total_len == client->read_buffer_size &&
+                !ipc_read_reserve(client, 1)) {
+                ipc_client_kill(client, "out of memory");
+                return 0;
+            }
+            msg = client->read_buffer + client->read_pos;
+            payload = msg + sizeof(struct ipc_header);
+            saved = payload[header.size];
+            payload[header.size] = '\0';
         }
         
-        ipc_client_handle_command(client, header->type, payload, header->size);
-        free(payload);
+        client->read_pos += total_len;
+        ipc_client_handle_command(client, header.type, payload, header.size);
+        if (client->dead) return 0;
         
-        memmove(client->read_buffer, client->read_buffer + total_len,
-                client->read_buffer_len - total_len);
-        client->read_buffer_len -= total_len;
+        if (payload) payload[header.size] = saved;
+    }
+    
+    if (client->read_pos == client->read_buffer_len) {
+        client->read_pos = 0;
+        client->read_buffer_len = 0;
+    }
+    
+    return 0;
+}
+
+static int ipc_client_handle_event(int fd, uint32_t mask, void *data) {
+    struct ipc_client *client = data;
+    if (client->dead) return 0;
+    
+    if (mask & (WL_EVENT_ERROR | WL_EVENT_HANGUP)) {
+        ipc_client_disconnect(client);
+        return 0;
+    }
+    
+    if (mask & WL_EVENT_WRITABLE) {
+        ipc_client_flush(client);
+        if (client->dead) return 0;
+    }
+    
+    if (mask & WL_EVENT_READABLE) {
+        return ipc_client_handle_readable(fd, client);
     }
     
     return 0;
@@ -391,10 +1173,11 @@ static int ipc_handle_connection(int fd, uint32_t mask, void *data) {
     client->fd = client_fd;
     client->server = server;
     client->subscribed_events = 0;
+    client->state_eventfd = -1;
     
     struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
     client->event_source = wl_event_loop_add_fd(loop, client_fd,
-        WL_EVENT_READABLE, ipc_client_handle_readable, client);
+        WL_EVENT_READABLE, ipc_client_handle_event, client);
     
     wl_list_insert(&ipc_clients, &client->link);
     
@@ -427,7 +1210,7 @@ int ipc_init(struct server *server) {
         return -1;
     }
     
-    if (listen(ipc_socket, 8) == -1) {
+    if (listen(ipc_socket, SOMAXCONN) == -1) {
         close(ipc_socket);
         return -1;
     }
@@ -442,6 +1225,9 @@ int ipc_init(struct server *server) {
     return 0;
 }
 
+static void ipc_events_discard(void);
+static void ipc_sync_finish(void);
+
 void ipc_finish(struct server *server) {
     (void)server;
     
@@ -457,54 +1243,705 @@ void ipc_finish(struct server *server) {
     wl_list_for_each_safe(client, tmp, &ipc_clients, link) {
         ipc_client_disconnect(client);
     }
+    
+    ipc_events_discard();
+    ipc_sync_finish();
+    ipc_state_finish();
+    jw_free(&reply);
+    jw_free(&node_writer);
+    jw_free(&tree_cache.tree);
+    for (int i = 0; i <= MAX_WORKSPACES; i++) jw_free(&tree_cache.ws[i]);
 }
 
-void ipc_event_workspace(struct server *server) {
-    struct json_object *obj = json_object_new_object();
-    json_object_object_add(obj, "change", json_object_new_string("focus"));
-    
-    struct json_object *current = json_object_new_object();
-    json_object_object_add(current, "num", json_object_new_int(server->current_workspace));
-    json_object_object_add(obj, "current", current);
+/*
+ * ============================================================================
+ * Events
+ * Events are queued rather than sent, and redundant ones are merged until
+ * the event loop goes idle: a window retitling itself a hundred times, or a
+ * re-tile that refocuses several windows, reaches a bar as one event.
+ * Payloads are built at flush time so they carry the final state.
+ * ============================================================================
+ */
+
+struct ipc_pending_event {
+    uint32_t type;              // IPC_EVENT_*
+    struct toplevel *toplevel;  // window events; NULL once the window is gone
+    struct xwayland_surface *xsurface; // the same for X11 windows
+    const char *change;
+    struct ipc_header header;
+    struct json_writer payload; // kept across batches for its buffer
+    bool ready;                 // payload already built (window destroyed)
+    
+    // What subscription filters look at, captured with the event
+    bool described;
+    bool wanted;                // some client's filters accept it
+    int workspace;
+    char app_id[128];
+    char output[32];
+};
+
+// One writev carries at most this many events (two iovecs each)
+#define IPC_EVENT_BATCH 256
+
+static struct {
+    struct ipc_pending_event *pending;
+    int count;
+    int capacity;
+    struct wl_event_source *idle_source;
+    
+    // Counters reported by GET_STATS
+    uint64_t raised;     // ipc_event_* calls with at least one subscriber
+    uint64_t coalesced;  // of those, merged into an already queued event
+    uint64_t filtered;   // deliveries dropped by subscription filters
+    uint64_t unbuilt;    // events no filter wanted, never serialized
+    uint64_t batches;
+    uint64_t sent;       // messages written to clients
+    uint64_t window_sent;
+    struct timespec window_start;
+    double sent_per_sec; // client-visible rate over the last full second
+} events;
+
+static bool ipc_has_subscribers(uint32_t event_type) {
+    struct ipc_client *client;
+    wl_list_for_each(client, &ipc_clients, link) {
+        if (client->subscribed_events & event_type) return true;
+    }
+    return false;
+}
+
+static void ipc_event_build(struct server *server, struct ipc_pending_event *pending) {
+    struct json_writer *w = &pending->payload;
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_kv_string(w, "change", pending->change);
+    
+    switch (pending->type) {
+    case IPC_EVENT_WORKSPACE:
+        jw_key(w, "current");
+        jw_object_begin(w);
+        jw_kv_int(w, "num", server->current_workspace);
+        jw_object_end(w);
+        break;
+    case IPC_EVENT_WINDOW:
+        // Shares the tree cache, so the container is only rebuilt if it changed
+        jw_key(w, "container");
+        struct ipc_node_cache *cache = NULL;
+        if (pending->toplevel) {
+            ipc_window_refresh(pending->toplevel, get_focused_toplevel(server));
+            cache = &pending->toplevel->ipc;
+        } else if (pending->xsurface) {
+            ipc_xwindow_refresh(pending->xsurface, xwayland_get_focused(server));
+            cache = &pending->xsurface->ipc;
+        }
+        if (cache && cache->json) {
+            jw_raw(w, cache->json, cache->len);
+        } else {
+            jw_null(w);
+        }
+        break;
+    default:
+        break;
+    }
+    jw_object_end(w);
     
-    const char *json_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
+    memcpy(pending->header.magic, IPC_MAGIC, IPC_MAGIC_LEN);
+    pending->header.size = w->len;
+    pending->header.type = IPC_EVENT_MASK | pending->type;
+    pending->ready = true;
+}
+
+static void ipc_event_describe(struct server *server, struct ipc_pending_event *pending) {
+    pending->described = true;
+    pending->app_id[0] = '\0';
+    pending->output[0] = '\0';
+    pending->workspace = 0;
+    
+    struct output *output = NULL;
+    if (pending->type == IPC_EVENT_WINDOW && pending->toplevel) {
+        struct toplevel *toplevel = pending->toplevel;
+        const char *app_id = toplevel->xdg_toplevel->app_id;
+        snprintf(pending->app_id, sizeof(pending->app_id), "%s", app_id ? app_id : "");
+        pending->workspace = toplevel->workspace;
+        
+        struct wlr_box box = toplevel_get_geometry(toplevel);
+        output = output_at(server, box.x + box.width / 2, box.y + box.height / 2);
+        if (!output) output = output_get_primary(server);
+    } else if (pending->type == IPC_EVENT_WINDOW && pending->xsurface) {
+        struct xwayland_surface *xsurface = pending->xsurface;
+        const char *class = xsurface->xwayland_surface->class;
+        snprintf(pending->app_id, sizeof(pending->app_id), "%s", class ? class : "");
+        pending->workspace = xsurface->workspace;
+        
+        // Once unmapped only the cached node knows where it was
+        struct wlr_box box = xsurface->ipc.box;
+        if (ipc_xwindow_listed(xsurface)) {
+            uint32_t state;
+            ipc_xwindow_snapshot(xsurface, NULL, &box, &state);
+        }
+        output = output_at(server, box.x + box.width / 2, box.y + box.height / 2);
+        if (!output) output = output_get_primary(server);
+    } else if (pending->type == IPC_EVENT_WORKSPACE) {
+        // Workspaces are global and shown on the primary output
+        pending->workspace = server->current_workspace;
+        output = output_get_primary(server);
+    }
+    if (output) snprintf(pending->output, sizeof(pending->output), "%s", output->wlr_output->name);
+}
+
+static bool ipc_filter_match(const struct ipc_filter *filter,
+                             const struct ipc_pending_event *pending) {
+    if (filter->type != pending->type) return false;
+    
+    if (filter->change_count > 0) {
+        if (!pending->change) return false;
+        bool any = false;
+        for (int i = 0; i < filter->change_count && !any; i++) {
+            any = strcmp(filter->changes[i], pending->change) == 0;
+        }
+        if (!any) return false;
+    }
+    if (filter->workspace && filter->workspace != pending->workspace) return false;
+    if (filter->output && strcmp(filter->output, pending->output) != 0) return false;
+    if (filter->app_id && fnmatch(filter->app_id, pending->app_id, 0) != 0) return false;
+    return true;
+}
+
+static bool ipc_client_wants(const struct ipc_client *client,
+                             const struct ipc_pending_event *pending) {
+    if (!(client->subscribed_events & pending->type)) return false;
+    for (int i = 0; i < client->filter_count; i++) {
+        if (ipc_filter_match(&client->filters[i], pending)) return true;
+    }
+    return false;
+}
+
+static void ipc_events_update_rate(uint64_t sent) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (events.window_start.tv_sec == 0) events.window_start = now;
+    
+    events.sent += sent;
+    events.window_sent += sent;
+    
+    double elapsed = (now.tv_sec - events.window_start.tv_sec) +
+                     (now.tv_nsec - events.window_start.tv_nsec) / 1e9;
+    if (elapsed >= 1.0) {
+        events.sent_per_sec = events.window_sent / elapsed;
+        events.window_sent = 0;
+        events.window_start = now;
+    }
+}
+
+static int ipc_events_flush(void *data) {
+    struct server *server = data;
+    events.idle_source = NULL;
     
+    // Only serialize what at least one subscriber's filters let through
     struct ipc_client *client;
+    for (int i = 0; i < events.count; i++) {
+        struct ipc_pending_event *pending = &events.pending[i];
+        if (!pending->described) ipc_event_describe(server, pending);
+        
+        pending->wanted = false;
+        wl_list_for_each(client, &ipc_clients, link) {
+            if (ipc_client_wants(client, pending)) {
+                pending->wanted = true;
+                break;
+            }
+        }
+        
+        if (!pending->wanted) events.unbuilt++;
+        else if (!pending->ready) ipc_event_build(server, pending);
+    }
+    
+    uint64_t sent = 0;
+    struct iovec iov[IPC_EVENT_BATCH * 2];
     wl_list_for_each(client, &ipc_clients, link) {
-        ipc_send_event(client, IPC_EVENT_WORKSPACE, json_str);
+        int iovcnt = 0;
+        size_t total_len = 0;
+        
+        for (int i = 0; i < events.count; i++) {
+            struct ipc_pending_event *pending = &events.pending[i];
+            if (!pending->wanted || !(client->subscribed_events & pending->type)) continue;
+            if (!ipc_client_wants(client, pending)) {
+                events.filtered++;
+                continue;
+            }
+            
+            iov[iovcnt].iov_base = &pending->header;
+            iov[iovcnt].iov_len = sizeof(pending->header);
+            iov[iovcnt + 1].iov_base = pending->payload.data;
+            iov[iovcnt + 1].iov_len = pending->payload.len;
+            iovcnt += 2;
+            total_len += sizeof(pending->header) + pending->payload.len;
+            sent++;
+            
+            if (iovcnt == IPC_EVENT_BATCH * 2) {
+                ipc_client_sendv(client, iov, iovcnt, total_len);
+                iovcnt = 0;
+                total_len = 0;
+            }
+        }
+        if (iovcnt > 0) ipc_client_sendv(client, iov, iovcnt, total_len);
     }
     
-    json_object_put(obj);
+    events.batches++;
+    ipc_events_update_rate(sent);
+    
+    for (int i = 0; i < events.count; i++) {
+        events.pending[i].ready = false;
+        events.pending[i].described = false;
+        events.pending[i].toplevel = NULL;
+    }
+    events.count = 0;
+    return 0;
 }
 
-void ipc_event_window(struct server *server, struct toplevel *toplevel, const char *change) {
-    (void)server;
-    (void)toplevel;
+static void ipc_events_discard(void) {
+    if (events.idle_source) {
+        wl_event_source_remove(events.idle_source);
+        events.idle_source = NULL;
+    }
+    for (int i = 0; i < events.capacity; i++) jw_free(&events.pending[i].payload);
+    free(events.pending);
+    events.pending = NULL;
+    events.count = 0;
+    events.capacity = 0;
+}
+
+// Drop queued events a new one makes redundant; true if it merges into one.
+// Only events queued since the last tick are candidates.
+static bool ipc_event_coalesce(uint32_t type, struct toplevel *toplevel,
+                               struct xwayland_surface *xsurface, const char *change) {
+    bool merged = false;
+    
+    int first = events.count;
+    while (first > 0 && events.pending[first - 1].type != IPC_EVENT_TICK) first--;
+    
+    for (int i = first; i < events.count; i++) {
+        struct ipc_pending_event *pending = &events.pending[i];
+        if (pending->type != type || pending->ready) continue;
+        
+        bool same;
+        if (type != IPC_EVENT_WINDOW) {
+            // Workspace and mode events only describe the final state
+            same = true;
+        } else if (strcmp(change, "focus") == 0) {
+            // Only the window that ends up focused matters
+            same = strcmp(pending->change, "focus") == 0;
+        } else if (pending->toplevel != toplevel || pending->xsurface != xsurface) {
+            continue;
+        } else if (strcmp(change, "close") == 0 && strcmp(pending->change, "new") != 0) {
+            // Title or focus updates for a window that is closing are noise
+            pending->type = 0;
+            continue;
+        } else {
+            same = strcmp(pending->change, change) == 0;
+        }
+        
+        if (same && !merged) {
+            pending->toplevel = toplevel;
+            pending->xsurface = xsurface;
+            pending->change = change;
+            merged = true;
+        } else if (same) {
+            pending->type = 0;
+        }
+    }
     
-    struct json_object *obj = json_object_new_object();
-    json_object_object_add(obj, "change", json_object_new_string(change));
+    // Compact away dropped entries, keeping payload buffers for reuse
+    int out = first;
+    for (int i = first; i < events.count; i++) {
+        if (events.pending[i].type == 0) continue;
+        if (out != i) {
+            struct ipc_pending_event tmp = events.pending[out];
+            events.pending[out] = events.pending[i];
+            events.pending[i] = tmp;
+        }
+        out++;
+    }
+    events.count = out;
+    return merged;
+}
+
+static struct ipc_pending_event *ipc_event_push(struct server *server) {
+    if (events.count == events.capacity) {
+        int capacity = events.capacity ? events.capacity * 2 : 16;
+        struct ipc_pending_event *pending =
+            realloc(events.pending, capacity * sizeof(*pending));
+        if (!pending) return NULL;
+        memset(pending + events.capacity, 0,
+               (capacity - events.capacity) * sizeof(*pending));
+        events.pending = pending;
+        events.capacity = capacity;
+    }
     
-    const char *json_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
+    if (!events.idle_source) {
+        struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+        events.idle_source = wl_event_loop_add_idle(loop, ipc_events_flush, server);
+    }
     
-    struct ipc_client *client;
-    wl_list_for_each(client, &ipc_clients, link) {
-        ipc_send_event(client, IPC_EVENT_WINDOW, json_str);
+    struct ipc_pending_event *pending = &events.pending[events.count++];
+    pending->toplevel = NULL;
+    pending->xsurface = NULL;
+    pending->change = NULL;
+    pending->ready = false;
+    pending->described = false;
+    return pending;
+}
+
+static void ipc_event_queue(struct server *server, uint32_t type, struct toplevel *toplevel,
+                            struct xwayland_surface *xsurface, const char *change) {
+    ipc_state_mark_dirty(server);
+    if (!ipc_has_subscribers(type)) return;
+    events.raised++;
+    
+    if (ipc_event_coalesce(type, toplevel, xsurface, change)) {
+        events.coalesced++;
+        return;
     }
     
-    json_object_put(obj);
+    struct ipc_pending_event *pending = ipc_event_push(server);
+    if (!pending) return;
+    pending->type = type;
+    pending->toplevel = toplevel;
+    pending->xsurface = xsurface;
+    pending->change = change;
+}
+
+static void ipc_tick_build(struct json_writer *w, bool first, const char *payload) {
+    jw_reset(w);
+    jw_object_begin(w);
+    jw_kv_bool(w, "first", first);
+    jw_kv_string(w, "payload", payload);
+    jw_object_end(w);
+}
+
+// Ticks are fences: queued in order behind earlier events and never merged
+static void ipc_event_tick(struct server *server, const char *payload) {
+    if (!ipc_has_subscribers(IPC_EVENT_TICK)) return;
+    events.raised++;
+    
+    // Events ahead of the tick carry the state from before it, not at flush
+    for (int i = 0; i < events.count; i++) {
+        struct ipc_pending_event *pending = &events.pending[i];
+        if (pending->ready) continue;
+        if (!pending->described) ipc_event_describe(server, pending);
+        ipc_event_build(server, pending);
+    }
+    
+    struct ipc_pending_event *pending = ipc_event_push(server);
+    if (!pending) return;
+    pending->type = IPC_EVENT_TICK;
+    ipc_tick_build(&pending->payload, false, payload);
+    memcpy(pending->header.magic, IPC_MAGIC, IPC_MAGIC_LEN);
+    pending->header.size = pending->payload.len;
+    pending->header.type = IPC_EVENT_MASK | IPC_EVENT_TICK;
+    pending->ready = true;
+}
+
+// A window going away takes its queued events' payloads with it now
+static void ipc_events_forget(struct server *server, struct toplevel *toplevel,
+                              struct xwayland_surface *xsurface) {
+    for (int i = 0; i < events.count; i++) {
+        struct ipc_pending_event *pending = &events.pending[i];
+        if (pending->ready) continue;
+        if (toplevel ? pending->toplevel != toplevel : pending->xsurface != xsurface) continue;
+        ipc_event_describe(server, pending);
+        ipc_event_build(server, pending);
+        pending->toplevel = NULL;
+        pending->xsurface = NULL;
+    }
+}
+
+void ipc_event_workspace(struct server *server) {
+    ipc_event_queue(server, IPC_EVENT_WORKSPACE, NULL, NULL, "focus");
+}
+
+void ipc_event_window(struct server *server, struct toplevel *toplevel, const char *change) {
+    if (!toplevel) return;
+    ipc_event_queue(server, IPC_EVENT_WINDOW, toplevel, NULL, change);
+}
+
+void ipc_event_xwindow(struct server *server, struct xwayland_surface *xsurface,
+                       const char *change) {
+    if (!xsurface || xsurface->override_redirect) return;
+    
+    // Past unmap there is nothing left to build the node from
+    if (strcmp(change, "close") == 0 && ipc_has_subscribers(IPC_EVENT_WINDOW))
+        ipc_xwindow_refresh(xsurface, xwayland_get_focused(server));
+    ipc_event_queue(server, IPC_EVENT_WINDOW, NULL, xsurface, change);
 }
 
 void ipc_event_mode(struct server *server) {
-    struct json_object *obj = json_object_new_object();
-    json_object_object_add(obj, "change", 
-        json_object_new_string(server->mode == MODE_TILING ? "tiling" : "floating"));
+    ipc_event_queue(server, IPC_EVENT_MODE, NULL, NULL,
+                    server->mode == MODE_TILING ? "tiling" : "floating");
+}
+
+static void ipc_json_describe_stats(void) {
+    jw_reset(&reply);
+    jw_object_begin(&reply);
+    jw_key(&reply, "events");
+    jw_object_begin(&reply);
+    jw_kv_int(&reply, "raised", events.raised);
+    jw_kv_int(&reply, "coalesced", events.coalesced);
+    jw_kv_int(&reply, "filtered", events.filtered);
+    jw_kv_int(&reply, "unbuilt", events.unbuilt);
+    jw_kv_int(&reply, "batches", events.batches);
+    jw_kv_int(&reply, "sent", events.sent);
+    jw_key(&reply, "sent_per_sec");
+    jw_double(&reply, events.sent_per_sec);
+    jw_kv_int(&reply, "pending", events.count);
+    jw_object_end(&reply);
+
+    const struct startup_phase *phases;
+    int count = startup_phases(&phases);
+    jw_key(&reply, "startup");
+    jw_object_begin(&reply);
+    jw_key(&reply, "first_frame_ms");
+    if (startup_first_frame_ms() >= 0) jw_double(&reply, startup_first_frame_ms());
+    else jw_null(&reply);
+    jw_key(&reply, "phases");
+    jw_array_begin(&reply);
+    for (int i = 0; i < count; i++) {
+        jw_object_begin(&reply);
+        jw_kv_string(&reply, "name", phases[i].name);
+        jw_key(&reply, "ms");
+        jw_double(&reply, phases[i].ms);
+        jw_object_end(&reply);
+    }
+    jw_array_end(&reply);
+    jw_object_end(&reply);
+    jw_object_end(&reply);
+}
+
+/*
+ * ============================================================================
+ * SYNC
+ * An extended i3 SYNC used as a fence by benchmarks: the reply is held back
+ * until every window has acked its pending configure (or SYNC_SETTLE_MS ran
+ * out), a frame containing that state has been committed, and the output
+ * reported it presented. The reply carries CLOCK_MONOTONIC timestamps for
+ * each stage, so command-to-photon latency can be measured from outside.
+ * ============================================================================
+ */
+
+// Give up waiting for clients to ack configures after this long
+#define SYNC_SETTLE_MS 100
+// Fail a sync outright if no output presents within this long
+#define SYNC_TIMEOUT_MS 1000
+
+enum ipc_sync_stage {
+    SYNC_SETTLING,   // waiting for configures to be acked
+    SYNC_ARMED,      // the frame being rendered now will carry it
+    SYNC_COMMITTED,  // waiting for that frame's presentation
+};
+
+struct ipc_sync {
+    struct wl_list link;
+    struct ipc_client *client;
+    enum ipc_sync_stage stage;
+    struct output *output;
+    bool settle_timed_out;
+    uint64_t request_usec;
+    uint64_t settled_usec;
+    uint64_t commit_usec;
+};
+
+static struct wl_list ipc_syncs = { &ipc_syncs, &ipc_syncs };
+static struct wl_event_source *sync_timer;
+
+static uint64_t timespec_usec(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+static uint64_t now_usec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespec_usec(&now);
+}
+
+static void ipc_sync_reply(struct ipc_sync *sync, bool success, const char *error,
+                           const struct wlr_output_event_present *event) {
+    jw_reset(&reply);
+    jw_object_begin(&reply);
+    jw_kv_bool(&reply, "success", success);
+    if (error) jw_kv_string(&reply, "error", error);
+    if (event) {
+        uint64_t present_usec = timespec_usec(&event->when);
+        jw_kv_string(&reply, "output", sync->output->wlr_output->name);
+        jw_kv_bool(&reply, "presented", event->presented);
+        jw_kv_bool(&reply, "settle_timed_out", sync->settle_timed_out);
+        jw_kv_int(&reply, "refresh_nsec", event->refresh);
+        jw_key(&reply, "time_usec");
+        jw_object_begin(&reply);
+        jw_kv_int(&reply, "request", sync->request_usec);
+        jw_kv_int(&reply, "settled", sync->settled_usec);
+        jw_kv_int(&reply, "commit", sync->commit_usec);
+        jw_kv_int(&reply, "present", present_usec);
+        jw_object_end(&reply);
+        jw_kv_int(&reply, "latency_usec", present_usec - sync->request_usec);
+    }
+    jw_object_end(&reply);
+    ipc_send_reply(sync->client, IPC_SYNC);
+    
+    wl_list_remove(&sync->link);
+    free(sync);
+}
+
+static bool ipc_sync_configures_pending(struct server *server) {
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+        if (!wl_list_empty(&toplevel->xdg_toplevel->base->configure_list)) return true;
+    }
+    return false;
+}
+
+static int ipc_sync_watchdog(void *data) {
+    (void)data;
+    uint64_t now = now_usec();
+    uint64_t oldest = now;
+    
+    struct ipc_sync *sync, *tmp;
+    wl_list_for_each_safe(sync, tmp, &ipc_syncs, link) {
+        if (now - sync->request_usec >= SYNC_TIMEOUT_MS * 1000) {
+            ipc_sync_reply(sync, false, "no frame was presented", NULL);
+        } else if (sync->request_usec < oldest) {
+            oldest = sync->request_usec;
+        }
+    }
+    
+    if (!wl_list_empty(&ipc_syncs)) {
+        // A zero delay would disarm the timer
+        int delay = SYNC_TIMEOUT_MS - (int)((now - oldest) / 1000);
+        wl_event_source_timer_update(sync_timer, delay > 0 ? delay : 1);
+    }
+    return 0;
+}
+
+static void ipc_sync_request(struct ipc_client *client) {
+    struct server *server = client->server;
+    if (wl_list_empty(&server->outputs)) {
+        ipc_json_success(false, false);
+        ipc_send_reply(client, IPC_SYNC);
+        return;
+    }
     
-    const char *json_str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
+    struct ipc_sync *sync = calloc(1, sizeof(*sync));
+    if (!sync) return;
+    sync->client = client;
+    sync->stage = SYNC_SETTLING;
+    sync->request_usec = now_usec();
     
-    struct ipc_client *client;
-    wl_list_for_each(client, &ipc_clients, link) {
-        ipc_send_event(client, IPC_EVENT_MODE, json_str);
+    if (wl_list_empty(&ipc_syncs)) {
+        struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+        if (!sync_timer) sync_timer = wl_event_loop_add_timer(loop, ipc_sync_watchdog, NULL);
+        wl_event_source_timer_update(sync_timer, SYNC_TIMEOUT_MS);
     }
+    wl_list_insert(ipc_syncs.prev, &sync->link);
     
-    json_object_put(obj);
+    struct output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        wlr_output_schedule_frame(output->wlr_output);
+    }
+}
+
+void ipc_sync_frame(struct output *output) {
+    if (wl_list_empty(&ipc_syncs)) return;
+    
+    uint64_t now = now_usec();
+    bool pending = ipc_sync_configures_pending(output->server);
+    bool armed = false;
+    
+    struct ipc_sync *sync;
+    wl_list_for_each(sync, &ipc_syncs, link) {
+        if (sync->stage != SYNC_SETTLING) continue;
+        
+        bool timed_out = now - sync->request_usec >= SYNC_SETTLE_MS * 1000;
+        if (pending && !timed_out) continue;
+        
+        sync->stage = SYNC_ARMED;
+        sync->output = output;
+        sync->settle_timed_out = pending;
+        sync->settled_usec = now;
+        armed = true;
+    }
+    
+    if (armed) {
+        // Damage alone doesn't make wlr_scene_output_commit() commit an idle
+        // output; needs_frame does, and the full damage repaints it all
+        wlr_output_update_needs_frame(output->wlr_output);
+        wlr_damage_ring_add_whole(&output->scene_output->damage_ring);
+    } else {
+        // Keep frames coming until the clients catch up
+        wlr_output_schedule_frame(output->wlr_output);
+    }
+}
+
+void ipc_sync_committed(struct output *output) {
+    uint64_t now = now_usec();
+    
+    struct ipc_sync *sync;
+    wl_list_for_each(sync, &ipc_syncs, link) {
+        if (sync->stage != SYNC_ARMED || sync->output != output) continue;
+        sync->stage = SYNC_COMMITTED;
+        sync->commit_usec = now;
+    }
+}
+
+void ipc_sync_frame_done(struct output *output) {
+    bool rearm = false;
+    
+    // Anything still armed rode a frame that never reached the output
+    struct ipc_sync *sync;
+    wl_list_for_each(sync, &ipc_syncs, link) {
+        if (sync->stage != SYNC_ARMED || sync->output != output) continue;
+        sync->stage = SYNC_SETTLING;
+        rearm = true;
+    }
+    
+    if (rearm) wlr_output_schedule_frame(output->wlr_output);
+}
+
+void ipc_sync_presented(struct output *output, struct wlr_output_event_present *event) {
+    struct ipc_sync *sync, *tmp;
+    wl_list_for_each_safe(sync, tmp, &ipc_syncs, link) {
+        if (sync->stage != SYNC_COMMITTED || sync->output != output) continue;
+        ipc_sync_reply(sync, true, NULL, event);
+    }
+}
+
+void ipc_sync_output_destroy(struct output *output) {
+    struct ipc_sync *sync;
+    wl_list_for_each(sync, &ipc_syncs, link) {
+        if (sync->output != output) continue;
+        sync->stage = SYNC_SETTLING;
+        sync->output = NULL;
+    }
+    
+    struct output *other;
+    wl_list_for_each(other, &output->server->outputs, link) {
+        if (other != output) wlr_output_schedule_frame(other->wlr_output);
+    }
+}
+
+static void ipc_sync_client_gone(struct ipc_client *client) {
+    struct ipc_sync *sync, *tmp;
+    wl_list_for_each_safe(sync, tmp, &ipc_syncs, link) {
+        if (sync->client != client) continue;
+        wl_list_remove(&sync->link);
+        free(sync);
+    }
+}
+
+static void ipc_sync_finish(void) {
+    struct ipc_sync *sync, *tmp;
+    wl_list_for_each_safe(sync, tmp, &ipc_syncs, link) {
+        wl_list_remove(&sync->link);
+        free(sync);
+    }
+    if (sync_timer) {
+        wl_event_source_remove(sync_timer);
+        sync_timer = NULL;
+    }
 }
@@ -3,12 +3,16 @@
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
 
 // Forward declarations
 struct server;
 struct toplevel;
+struct xwayland_surface;
+struct output;
+struct wlr_output_event_present;
 
 // i3 IPC magic string
 #define IPC_MAGIC "i3-ipc"
@@ -31,6 +35,10 @@ enum ipc_command_type {
     IPC_GET_BINDING_STATE = 12,
     IPC_GET_INPUTS = 100,
     IPC_GET_SEATS = 101,
+    
+    // StarView extensions
+    IPC_GET_STATS = 200,
+    IPC_GET_STATE_FD = 201,  // reply carries the state page fds, see starview_state.h
 };
 
 // Event types (bit flags for subscription)
@@ -53,6 +61,28 @@ int ipc_init(struct server *server);
 void ipc_finish(struct server *server);
 void ipc_event_workspace(struct server *server);
 void ipc_event_window(struct server *server, struct toplevel *toplevel, const char *change);
+void ipc_event_xwindow(struct server *server, struct xwayland_surface *xsurface,
+                       const char *change);
 void ipc_event_mode(struct server *server);
 
+// Tree cache invalidation; toplevel may be NULL for output/layout changes
+void ipc_tree_mark_dirty(struct server *server, struct toplevel *toplevel);
+void ipc_toplevel_destroy(struct toplevel *toplevel);
+void ipc_xwayland_mark_dirty(struct xwayland_surface *xsurface);
+void ipc_xwayland_destroy(struct xwayland_surface *xsurface);
+
+// SYNC fencing, driven from the output frame, commit and present handlers
+void ipc_sync_frame(struct output *output);
+void ipc_sync_frame_done(struct output *output);
+void ipc_sync_committed(struct output *output);
+void ipc_sync_presented(struct output *output, struct wlr_output_event_present *event);
+void ipc_sync_output_destroy(struct output *output);
+
+// Shared state page (ipc_state.c); publishing is deferred to an idle callback
+int ipc_state_get_fd(struct server *server);
+int ipc_state_eventfd_new(void);
+void ipc_state_eventfd_release(int fd);
+void ipc_state_mark_dirty(struct server *server);
+void ipc_state_finish(void);
+
 #endif
@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#define WLR_USE_UNSTABLE
+
+#include "ipc.h"
+#include "core.h"
+#include "config.h"
+#include "starview_state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <wlr/xwayland.h>
+
+_Static_assert(STARVIEW_STATE_MAX_WORKSPACES >= MAX_WORKSPACES,
+               "state page cannot hold every workspace");
+
+/*
+ * ============================================================================
+ * Shared state page
+ * Created on the first IPC_GET_STATE_FD request, so nothing is allocated
+ * unless some client wants it. Changes are published from an idle callback
+ * with a seqlock; subscribers are woken through their own eventfd only when
+ * the page contents actually changed.
+ * ============================================================================
+ */
+
+static struct {
+    int memfd;
+    struct starview_state_page *page;
+    struct wl_event_source *idle_source;
+
+    // Staging copy, compared against the page to skip no-op publishes
+    struct starview_state next;
+
+    int *eventfds;
+    int eventfd_count;
+    int eventfd_capacity;
+} state = { .memfd = -1 };
+
+static void copy_string(char *dst, size_t size, const char *src) {
+    snprintf(dst, size, "%s", src ? src : "");
+}
+
+static void ipc_state_collect(struct server *server, struct starview_state *next) {
+    memset(next, 0, sizeof(*next));
+    next->current_workspace = server->current_workspace;
+    next->mode = server->mode == MODE_FLOATING ? STARVIEW_MODE_FLOATING : STARVIEW_MODE_TILING;
+
+    struct toplevel *focused = get_focused_toplevel(server);
+    struct xwayland_surface *xfocused = focused ? NULL : xwayland_get_focused(server);
+    if (focused) {
+        next->focused_id = (uintptr_t)focused;
+        copy_string(next->focused_title, sizeof(next->focused_title),
+                    focused->xdg_toplevel->title);
+        copy_string(next->focused_app_id, sizeof(next->focused_app_id),
+                    focused->xdg_toplevel->app_id);
+    } else if (xfocused) {
+        next->focused_id = (uintptr_t)xfocused;
+        copy_string(next->focused_title, sizeof(next->focused_title),
+                    xfocused->xwayland_surface->title);
+        copy_string(next->focused_app_id, sizeof(next->focused_app_id),
+                    xfocused->xwayland_surface->class);
+    }
+
+    next->workspace_count = MAX_WORKSPACES;
+    for (int i = 0; i < MAX_WORKSPACES; i++) {
+        next->workspaces[i].num = i + 1;
+        if (i + 1 == server->current_workspace)
+            next->workspaces[i].flags |= STARVIEW_WORKSPACE_FOCUSED;
+    }
+    struct toplevel *toplevel;
+    wl_list_for_each(toplevel, &server->toplevels, link) {
+        if (toplevel->workspace < 1 || toplevel->workspace > MAX_WORKSPACES) continue;
+        struct starview_state_workspace *ws = &next->workspaces[toplevel->workspace - 1];
+        ws->windows++;
+        ws->flags |= STARVIEW_WORKSPACE_OCCUPIED;
+    }
+    struct xwayland_surface *xsurface;
+    wl_list_for_each(xsurface, &server->xwayland_surfaces, link) {
+        if (xsurface->override_redirect || !xsurface->scene_tree) continue;
+        if (xsurface->workspace < 1 || xsurface->workspace > MAX_WORKSPACES) continue;
+        struct starview_state_workspace *ws = &next->workspaces[xsurface->workspace - 1];
+        ws->windows++;
+        ws->flags |= STARVIEW_WORKSPACE_OCCUPIED;
+    }
+
+    struct output *primary = output_get_primary(server);
+    struct output *output;
+    wl_list_for_each(output, &server->outputs, link) {
+        if (next->output_count == STARVIEW_STATE_MAX_OUTPUTS) break;
+        struct starview_state_output *out = &next->outputs[next->output_count++];
+
+        struct wlr_box box;
+        wlr_output_layout_get_box(server->output_layout, output->wlr_output, &box);
+        copy_string(out->name, sizeof(out->name), output->wlr_output->name);
+        out->x = box.x;
+        out->y = box.y;
+        out->width = box.width;
+        out->height = box.height;
+        out->scale = output->wlr_output->scale;
+        out->primary = output == primary;
+    }
+}
+
+static int ipc_state_publish(void *data) {
+    struct server *server = data;
+    state.idle_source = NULL;
+    if (!state.page) return 0;
+
+    ipc_state_collect(server, &state.next);
+    if (memcmp(&state.next, &state.page->state, sizeof(state.next)) == 0) return 0;
+
+    struct starview_state_page *page = state.page;
+    uint32_t seq = page->seq;
+    __atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&page->state, &state.next, sizeof(state.next));
+    page->generation++;
+    __atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+
+    uint64_t one = 1;
+    for (int i = 0; i < state.eventfd_count; i++) {
+        // EAGAIN means the counter is already pending, which is just as good
+        ssize_t n = write(state.eventfds[i], &one, sizeof(one));
+        (void)n;
+    }
+    return 0;
+}
+
+void ipc_state_mark_dirty(struct server *server) {
+    if (!state.page || state.idle_source) return;
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    state.idle_source = wl_event_loop_add_idle(loop, ipc_state_publish, server);
+}
+
+int ipc_state_get_fd(struct server *server) {
+    if (state.page) return state.memfd;
+
+    int fd = memfd_create("starview-state", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        perror("IPC: memfd_create");
+        return -1;
+    }
+
+    size_t size = sizeof(struct starview_state_page);
+    if (ftruncate(fd, size) < 0) {
+        perror("IPC: ftruncate");
+        close(fd);
+        return -1;
+    }
+
+    struct starview_state_page *page = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED, fd, 0);
+    if (page == MAP_FAILED) {
+        perror("IPC: mmap state page");
+        close(fd);
+        return -1;
+    }
+
+    // Clients can map the page but never resize it or map it writable
+    int seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+#ifdef F_SEAL_FUTURE_WRITE
+    seals |= F_SEAL_FUTURE_WRITE;
+#endif
+    if (fcntl(fd, F_ADD_SEALS, seals) < 0) {
+        perror("IPC: sealing state page");
+    }
+
+    page->magic = STARVIEW_STATE_MAGIC;
+    page->version = STARVIEW_STATE_VERSION;
+    page->size = size;
+
+    state.memfd = fd;
+    state.page = page;
+    ipc_state_collect(server, &page->state);
+    return fd;
+}
+
+int ipc_state_eventfd_new(void) {
+    if (state.eventfd_count == state.eventfd_capacity) {
+        int capacity = state.eventfd_capacity ? state.eventfd_capacity * 2 : 8;
+        int *eventfds = realloc(state.eventfds, capacity * sizeof(*eventfds));
+        if (!eventfds) return -1;
+        state.eventfds = eventfds;
+        state.eventfd_capacity = capacity;
+    }
+
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0) {
+        perror("IPC: eventfd");
+        return -1;
+    }
+    state.eventfds[state.eventfd_count++] = fd;
+    return fd;
+}
+
+void ipc_state_eventfd_release(int fd) {
+    for (int i = 0; i < state.eventfd_count; i++) {
+        if (state.eventfds[i] != fd) continue;
+        state.eventfds[i] = state.eventfds[--state.eventfd_count];
+        close(fd);
+        return;
+    }
+}
+
+void ipc_state_finish(void) {
+    if (state.idle_source) {
+        wl_event_source_remove(state.idle_source);
+        state.idle_source = NULL;
+    }
+    for (int i = 0; i < state.eventfd_count; i++) close(state.eventfds[i]);
+    free(state.eventfds);
+    state.eventfds = NULL;
+    state.eventfd_count = 0;
+    state.eventfd_capacity = 0;
+
+    if (state.page) {
+        munmap(state.page, sizeof(*state.page));
+        state.page = NULL;
+    }
+    if (state.memfd >= 0) {
+        close(state.memfd);
+        state.memfd = -1;
+    }
+}
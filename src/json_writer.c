@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "json_writer.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void jw_reset(struct json_writer *w) {
+    w->len = 0;
+    w->depth = 0;
+    w->need_comma = 0;
+    w->after_key = false;
+    w->failed = false;
+    if (w->data) w->data[0] = '\0';
+}
+
+void jw_free(struct json_writer *w) {
+    free(w->data);
+    memset(w, 0, sizeof(*w));
+}
+
+static bool jw_reserve(struct json_writer *w, size_t extra) {
+    if (w->len + extra + 1 <= w->cap) return true;
+    if (w->failed) return false;
+
+    size_t cap = w->cap ? w->cap : 1024;
+    while (cap < w->len + extra + 1) cap *= 2;
+
+    char *data = realloc(w->data, cap);
+    if (!data) {
+        w->failed = true;
+        return false;
+    }
+    w->data = data;
+    w->cap = cap;
+    return true;
+}
+
+static void jw_put(struct json_writer *w, const char *str, size_t len) {
+    if (!jw_reserve(w, len)) return;
+    memcpy(w->data + w->len, str, len);
+    w->len += len;
+    w->data[w->len] = '\0';
+}
+
+// Separator handling shared by every value and key
+static void jw_value_prefix(struct json_writer *w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->need_comma & (1u << w->depth)) jw_put(w, ",", 1);
+    w->need_comma |= 1u << w->depth;
+}
+
+static void jw_escaped(struct json_writer *w, const char *str) {
+    static const char hex[] = "0123456789abcdef";
+
+    jw_put(w, "\"", 1);
+    const char *run = str;
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        char esc[6];
+        const char *rep;
+        size_t rep_len = 2;
+
+        switch (*p) {
+        case '"': rep = "\\\""; break;
+        case '\\': rep = "\\\\"; break;
+        case '\n': rep = "\\n"; break;
+        case '\r': rep = "\\r"; break;
+        case '\t': rep = "\\t"; break;
+        case '\b': rep = "\\b"; break;
+        case '\f': rep = "\\f"; break;
+        default:
+            if (*p >= 0x20) continue;
+            memcpy(esc, "\\u00", 4);
+            esc[4] = hex[*p >> 4];
+            esc[5] = hex[*p & 0xf];
+            rep = esc;
+            rep_len = 6;
+            break;
+        }
+
+        jw_put(w, run, (const char *)p - run);
+        jw_put(w, rep, rep_len);
+        run = (const char *)p + 1;
+    }
+    jw_put(w, run, strlen(run));
+    jw_put(w, "\"", 1);
+}
+
+static void jw_open(struct json_writer *w, char c) {
+    jw_value_prefix(w);
+    jw_put(w, &c, 1);
+    if (w->depth + 1 < JW_MAX_DEPTH) {
+        w->depth++;
+        w->need_comma &= ~(1u << w->depth);
+    } else {
+        w->failed = true;
+    }
+}
+
+static void jw_close(struct json_writer *w, char c) {
+    if (w->depth > 0) w->depth--;
+    jw_put(w, &c, 1);
+}
+
+void jw_object_begin(struct json_writer *w) { jw_open(w, '{'); }
+void jw_object_end(struct json_writer *w) { jw_close(w, '}'); }
+void jw_array_begin(struct json_writer *w) { jw_open(w, '['); }
+void jw_array_end(struct json_writer *w) { jw_close(w, ']'); }
+
+void jw_key(struct json_writer *w, const char *key) {
+    jw_value_prefix(w);
+    jw_escaped(w, key);
+    jw_put(w, ":", 1);
+    w->after_key = true;
+}
+
+void jw_string(struct json_writer *w, const char *str) {
+    if (!str) {
+        jw_null(w);
+        return;
+    }
+    jw_value_prefix(w);
+    jw_escaped(w, str);
+}
+
+void jw_int(struct json_writer *w, int64_t value) {
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%" PRId64, value);
+    jw_value_prefix(w);
+    jw_put(w, num, n);
+}
+
+void jw_uint(struct json_writer *w, uint64_t value) {
+    char num[24];
+    int n = snprintf(num, sizeof(num), "%" PRIu64, value);
+    jw_value_prefix(w);
+    jw_put(w, num, n);
+}
+
+void jw_double(struct json_writer *w, double value) {
+    // JSON has no NaN or Infinity
+    if (!isfinite(value)) {
+        jw_null(w);
+        return;
+    }
+    
+    // The shortest of these that reads back as the same double
+    static const char *const formats[] = { "%.15g", "%.16g", "%.17g" };
+    char num[32];
+    int n = 0;
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        n = snprintf(num, sizeof(num), formats[i], value);
+        if (strtod(num, NULL) == value) break;
+    }
+    jw_value_prefix(w);
+    jw_put(w, num, n);
+}
+
+void jw_bool(struct json_writer *w, bool value) {
+    jw_value_prefix(w);
+    if (value) jw_put(w, "true", 4);
+    else jw_put(w, "false", 5);
+}
+
+void jw_null(struct json_writer *w) {
+    jw_value_prefix(w);
+    jw_put(w, "null", 4);
+}
+
+void jw_raw(struct json_writer *w, const char *json, size_t len) {
+    jw_value_prefix(w);
+    jw_put(w, json, len);
+}
+
+void jw_kv_string(struct json_writer *w, const char *key, const char *str) {
+    jw_key(w, key);
+    jw_string(w, str);
+}
+
+void jw_kv_int(struct json_writer *w, const char *key, int64_t value) {
+    jw_key(w, key);
+    jw_int(w, value);
+}
+
+void jw_kv_bool(struct json_writer *w, const char *key, bool value) {
+    jw_key(w, key);
+    jw_bool(w, value);
+}
+
+void jw_kv_rect(struct json_writer *w, const char *key,
+                int x, int y, int width, int height) {
+    jw_key(w, key);
+    jw_object_begin(w);
+    jw_kv_int(w, "x", x);
+    jw_kv_int(w, "y", y);
+    jw_kv_int(w, "width", width);
+    jw_kv_int(w, "height", height);
+    jw_object_end(w);
+}
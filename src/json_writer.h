@@ -0,0 +1,55 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming JSON emitter
+ *
+ * Writes straight into a growable buffer that is kept across uses, so once
+ * it has grown to fit the largest reply, serializing allocates nothing.
+ * Commas are inserted automatically; keys and string values are escaped.
+ */
+
+#define JW_MAX_DEPTH 32
+
+struct json_writer {
+    char *data;
+    size_t len;
+    size_t cap;
+
+    int depth;
+    uint32_t need_comma;  // bit per nesting level
+    bool after_key;
+    bool failed;          // allocation failed, output is truncated
+};
+
+void jw_reset(struct json_writer *w);
+void jw_free(struct json_writer *w);
+
+void jw_object_begin(struct json_writer *w);
+void jw_object_end(struct json_writer *w);
+void jw_array_begin(struct json_writer *w);
+void jw_array_end(struct json_writer *w);
+
+void jw_key(struct json_writer *w, const char *key);
+void jw_string(struct json_writer *w, const char *str);
+void jw_int(struct json_writer *w, int64_t value);
+void jw_uint(struct json_writer *w, uint64_t value);
+void jw_double(struct json_writer *w, double value);
+void jw_bool(struct json_writer *w, bool value);
+void jw_null(struct json_writer *w);
+
+// Splice an already serialized value (e.g. a cached subtree)
+void jw_raw(struct json_writer *w, const char *json, size_t len);
+
+// Key/value shorthands
+void jw_kv_string(struct json_writer *w, const char *key, const char *str);
+void jw_kv_int(struct json_writer *w, const char *key, int64_t value);
+void jw_kv_bool(struct json_writer *w, const char *key, bool value);
+void jw_kv_rect(struct json_writer *w, const char *key,
+                int x, int y, int width, int height);
+
+#endif
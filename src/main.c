@@ -2,10 +2,15 @@
 
 #include "background.h"
 #include "config.h"
+#include "config_live.h"
 #include "core.h"
 #include "gesture.h"
 #include "ipc.h"
+#include "spawner.h"
+#include "startup.h"
 #include "titlebar_render.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -18,9 +23,35 @@
 #include "decor_visual.h"
 #include "protocols.h"
 
+// Parses the config and starts the wallpaper decode off the main thread
+static void *config_worker(void *data) {
+  struct config *next = data;
+  int ret = config_load_parse(next);
+  startup_mark("config parsed (worker)");
+  background_preload(&next->background);
+  return (void *)(intptr_t)ret;
+}
+
 int main(void) {
+  startup_begin();
+
+  // Forked while the process is small and has no other threads
+  if (spawn_init() < 0) {
+    fprintf(stderr, "Warning: Spawn helper unavailable, spawning directly\n");
+  }
   wlr_log_init(WLR_DEBUG, NULL);
 
+  // Nothing reads the config until it is joined below, after the backend,
+  // renderer and protocols are up
+  char config_file[512];
+  snprintf(config_file, sizeof(config_file),
+           "%s/.config/starview/starview.toml", getenv("HOME"));
+  struct config *config_next = config_load_begin(config_file);
+  pthread_t config_thread;
+  bool config_threaded =
+      config_next &&
+      pthread_create(&config_thread, NULL, config_worker, config_next) == 0;
+
   struct server server = {0};
   wl_list_init(&server.outputs);
   wl_list_init(&server.toplevels);
@@ -30,6 +61,7 @@ int main(void) {
   server.current_workspace = 1;
 
   server.display = wl_display_create();
+  spawn_attach(wl_display_get_event_loop(server.display));
 
   server.backend =
       wlr_backend_autocreate(wl_display_get_event_loop(server.display), NULL);
@@ -42,6 +74,7 @@ int main(void) {
   wlr_renderer_init_wl_display(server.renderer, server.display);
 
   server.allocator = wlr_allocator_autocreate(server.backend, server.renderer);
+  startup_mark("backend and renderer");
 
   server.compositor = wlr_compositor_create(server.display, 5, server.renderer);
   wlr_subcompositor_create(server.display);
@@ -65,6 +98,8 @@ int main(void) {
   wl_signal_add(&server.layer_shell->events.new_surface,
                 &server.new_layer_surface);
 
+  startup_mark("scene");
+
   // XDG output
   wlr_xdg_output_manager_v1_create(server.display, server.output_layout);
 
@@ -125,6 +160,8 @@ int main(void) {
   if (viewporter_init(&server) < 0) {
     fprintf(stderr, "Warning: Viewporter initialization failed\n");
   }
+  startup_mark("protocols");
+
   // XDG decoration (already exists - keep it)
   server.xdg_decoration_mgr =
       wlr_xdg_decoration_manager_v1_create(server.display);
@@ -193,11 +230,25 @@ int main(void) {
   wl_signal_add(&server.seat->events.request_set_cursor,
                 &server.request_cursor);
 
-  // Load config (already exists - keep it)
-  char config_file[512];
-  snprintf(config_file, sizeof(config_file),
-           "%s/.config/starview/starview.toml", getenv("HOME"));
-  config_load(config_file);
+  if (cursor_shape_init(&server) < 0) {
+    fprintf(stderr, "Warning: Cursor shape initialization failed\n");
+  }
+
+  startup_mark("shell and input");
+
+  // Join the config parse started at the top
+  if (config_next) {
+    int ret;
+    if (config_threaded) {
+      void *result;
+      pthread_join(config_thread, &result);
+      ret = (int)(intptr_t)result;
+    } else {
+      ret = config_load_parse(config_next);
+    }
+    config_load_finish(config_next, ret);
+  }
+  startup_mark("config");
 
   // Titlebar theme (already exists - keep it)
   struct titlebar_theme *theme = titlebar_theme_create();
@@ -205,67 +256,62 @@ int main(void) {
   titlebar_set_global_theme(theme);
   printf("✓ Titlebar theme initialized from config\n");
 
+  // Reload automatically when the config or any include changes
+  if (config_watch_init(&server) < 0) {
+    fprintf(stderr, "Warning: Config auto-reload unavailable\n");
+  }
+
   // IPC (already exists - keep it)
   if (ipc_init(&server) < 0) {
     fprintf(stderr, "Warning: Failed to initialize IPC\n");
   }
 
+  startup_mark("theme, config watch and IPC");
+
   // Set mode from config (already exists - keep it)
   server.mode = config.default_mode;
   server.preselect = PRESELECT_NONE;
 
-  // Run autostart (already exists - keep it)
-  for (int i = 0; i < config.autostart_count; i++) {
-    if (fork() == 0) {
-      execl("/bin/sh", "sh", "-c", config.autostart[i], NULL);
-      _exit(1);
-    }
-  }
-
   const char *socket = wl_display_add_socket_auto(server.display);
   if (!socket) {
     fprintf(stderr, "Failed to create socket\n");
     return 1;
   }
 
+  // Outputs appear here, each rendering its background once
   if (!wlr_backend_start(server.backend)) {
     fprintf(stderr, "Failed to start backend\n");
     return 1;
   }
+  startup_mark("backend start and outputs");
 
   // *** NEW: Initialize XWayland (do this AFTER backend starts) ***
   if (xwayland_init(&server) < 0) {
     fprintf(stderr, "Warning: XWayland initialization failed\n");
   }
+  startup_mark("xwayland");
 
   setenv("WAYLAND_DISPLAY", socket, 1);
   printf("Running on WAYLAND_DISPLAY=%s\n", socket);
   printf("Mode: %s\n", server.mode == MODE_TILING ? "TILING" : "FLOATING");
   printf("Gesture support enabled\n");
 
-  // Update backgrounds (already exists - keep it)
-  struct output *output;
-  wl_list_for_each(output, &server.outputs, link) {
-    if (output->background && config.background.enabled) {
-      int width = output->wlr_output->width;
-      int height = output->wlr_output->height;
-      background_update(output->background, width, height, &config.background);
-    }
+  // Run autostart once WAYLAND_DISPLAY and DISPLAY are set
+  for (int i = 0; i < config.autostart_count; i++) {
+    spawn_command(config.autostart[i]);
   }
 
   // Launch terminal (already exists - keep it)
-  pid_t pid = fork();
-  if (pid == 0) {
-    execlp("foot", "foot", NULL);
-    execlp("kitty", "kitty", NULL);
-    _exit(1);
-  }
+  spawn_command("command -v foot >/dev/null && exec foot; exec kitty");
 
+  startup_mark("ready");
   wl_display_run(server.display);
 
   // Cleanup
+  config_watch_finish();
   ipc_finish(&server);
   xwayland_finish(&server);
+  spawn_finish();
   wl_display_destroy(server.display);
   return 0;
 }
@@ -17,6 +17,7 @@
 #include <wlr/types/wlr_session_lock_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_viewporter.h>
+#include <wlr/types/wlr_cursor_shape_v1.h>
 
 /* ============================================================================
  * Foreign Toplevel Management (wlr-foreign-toplevel-management)
@@ -535,3 +536,44 @@ int viewporter_init(struct server *server) {
     printf("Viewporter initialized\n");
     return 0;
 }
+
+/* ============================================================================
+ * Cursor Shape (cursor-shape-v1)
+ * Clients name a shape, we serve it from the cached xcursor theme instead of
+ * uploading a cursor buffer per client
+ * ============================================================================ */
+
+static void handle_cursor_shape_request(struct wl_listener *listener,
+                                        void *data) {
+    struct server *server =
+        wl_container_of(listener, server, request_set_cursor_shape);
+    struct wlr_cursor_shape_manager_v1_request_set_shape_event *event = data;
+
+    /* Tablet tools have no cursor of their own here */
+    if (event->device_type != WLR_CURSOR_SHAPE_MANAGER_V1_DEVICE_TYPE_POINTER)
+        return;
+
+    /* Same rule as wl_pointer.set_cursor: only the focused client may set it */
+    if (event->seat_client != server->seat->pointer_state.focused_client)
+        return;
+
+    wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr,
+                           wlr_cursor_shape_v1_name(event->shape));
+    server->pointer_cursor_name = NULL;
+}
+
+int cursor_shape_init(struct server *server) {
+    server->cursor_shape_mgr =
+        wlr_cursor_shape_manager_v1_create(server->display, 1);
+    if (!server->cursor_shape_mgr) {
+        fprintf(stderr, "Failed to create cursor shape manager\n");
+        return -1;
+    }
+
+    server->request_set_cursor_shape.notify = handle_cursor_shape_request;
+    wl_signal_add(&server->cursor_shape_mgr->events.request_set_shape,
+                  &server->request_set_cursor_shape);
+
+    printf("Cursor shape initialized\n");
+    return 0;
+}
@@ -34,4 +34,7 @@ int session_lock_init_v2(struct server *server);
 int presentation_time_init(struct server *server);
 int viewporter_init(struct server *server);
 
+/* Cursor shape (named cursors instead of client cursor surfaces) */
+int cursor_shape_init(struct server *server);
+
 #endif /* PROTOCOLS_H */
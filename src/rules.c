@@ -3,55 +3,485 @@
 
 #include "core.h"
 #include "config.h"
-#include <string.h>
+#include "ipc.h"
 #include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/xwayland.h>
 
-void apply_window_rules(struct toplevel *toplevel) {
-    const char *app_id = toplevel->xdg_toplevel->app_id;
-    const char *title = toplevel->xdg_toplevel->title;
-    
-    if (!app_id) app_id = "";
-    if (!title) title = "";
-    
-    for (int i = 0; i < config.rule_count; i++) {
-        struct window_rule *rule = &config.rules[i];
-        
-        // Match app_id (supports wildcards)
-        if (rule->app_id[0] && fnmatch(rule->app_id, app_id, 0) != 0) {
-            continue;
+/*
+ * ============================================================================
+ * WINDOW RULES
+ * Rules are compiled into a matcher the first time they are needed after a
+ * (re)load. Literal, "prefix*", "*suffix" and "*contains*" patterns never
+ * reach fnmatch(), and rules with a literal, prefix or suffix pattern are
+ * hashed on it, so a window only looks at the rules that can match it.
+ *
+ * A rule applies to a window once, the first time the window matches it:
+ * on map, or later when the client changes its title or app_id. Windows
+ * remember applied rules by content, so a reload doesn't re-apply rules
+ * that did not change.
+ * ============================================================================
+ */
+
+enum pattern_kind {
+    PATTERN_ANY,
+    PATTERN_EXACT,
+    PATTERN_PREFIX,
+    PATTERN_SUFFIX,
+    PATTERN_CONTAINS,
+    PATTERN_GLOB,
+};
+
+struct pattern {
+    enum pattern_kind kind;
+    const char *text;   // literal part, or the whole glob
+    size_t len;
+};
+
+enum rule_field {
+    FIELD_APP_ID,
+    FIELD_TITLE,
+    FIELD_COUNT,
+};
+
+struct compiled_rule {
+    struct pattern patterns[FIELD_COUNT];
+    uint32_t hash;      // identifies the rule across reloads
+    int next;           // next rule in the same bucket, -1 at the end
+};
+
+struct rule_bucket {
+    const char *text;   // NULL marks an empty slot
+    size_t len;
+    uint32_t hash;
+    uint8_t field;
+    uint8_t kind;
+    int first, last;
+};
+
+struct literal_lengths {
+    size_t *lengths;
+    int count;
+};
+
+static struct {
+    bool compiled;
+    struct compiled_rule *rules;
+    struct rule_bucket *buckets;
+    uint32_t bucket_mask;
+    int *unindexed;
+    int unindexed_count;
+
+    // Distinct prefix/suffix lengths, so lookups try only lengths in use
+    struct literal_lengths prefix[FIELD_COUNT];
+    struct literal_lengths suffix[FIELD_COUNT];
+
+    int *candidates;
+    int candidate_capacity;
+} matcher;
+
+static uint32_t hash_bytes(uint32_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 16777619u;     // FNV-1a
+    return h;
+}
+
+#define HASH_SEED 2166136261u
+
+static void pattern_compile(struct pattern *p, const char *glob) {
+    p->kind = PATTERN_ANY;
+    if (!glob) return;
+
+    size_t len = strlen(glob);
+    bool lead = len > 0 && glob[0] == '*';
+    bool trail = len > 1 && glob[len - 1] == '*';
+    for (size_t i = 0; i < len; i++) {
+        bool inner_star = glob[i] == '*' && !(i == 0 && lead) &&
+                          !(i == len - 1 && trail);
+        if (inner_star || glob[i] == '?' || glob[i] == '[' || glob[i] == '\\') {
+            p->kind = PATTERN_GLOB;
+            p->text = glob;
+            p->len = len;
+            return;
+        }
+    }
+
+    p->text = glob + lead;
+    p->len = len - lead - trail;
+    if (lead && p->len == 0) p->kind = PATTERN_ANY;     // "*" or "**"
+    else if (lead && trail) p->kind = PATTERN_CONTAINS;
+    else if (lead) p->kind = PATTERN_SUFFIX;
+    else if (trail) p->kind = PATTERN_PREFIX;
+    else p->kind = PATTERN_EXACT;
+}
+
+static bool contains(const char *s, size_t slen, const char *text, size_t len) {
+    for (size_t i = 0; i + len <= slen; i++) {
+        if (memcmp(s + i, text, len) == 0) return true;
+    }
+    return false;
+}
+
+static bool pattern_match(const struct pattern *p, const char *s, size_t slen) {
+    switch (p->kind) {
+    case PATTERN_ANY:
+        return true;
+    case PATTERN_EXACT:
+        return slen == p->len && memcmp(s, p->text, slen) == 0;
+    case PATTERN_PREFIX:
+        return slen >= p->len && memcmp(s, p->text, p->len) == 0;
+    case PATTERN_SUFFIX:
+        return slen >= p->len && memcmp(s + slen - p->len, p->text, p->len) == 0;
+    case PATTERN_CONTAINS:
+        return contains(s, slen, p->text, p->len);
+    case PATTERN_GLOB:
+        return fnmatch(p->text, s, 0) == 0;
+    }
+    return false;
+}
+
+static uint32_t bucket_hash(int field, int kind, const char *text, size_t len) {
+    uint8_t tag[2] = { field, kind };
+    return hash_bytes(hash_bytes(HASH_SEED, tag, sizeof(tag)), text, len);
+}
+
+static struct rule_bucket *bucket_find(int field, int kind, const char *text,
+                                       size_t len, bool insert) {
+    if (!matcher.buckets) return NULL;
+
+    uint32_t hash = bucket_hash(field, kind, text, len);
+    uint32_t slot = hash & matcher.bucket_mask;
+    for (;; slot = (slot + 1) & matcher.bucket_mask) {
+        struct rule_bucket *b = &matcher.buckets[slot];
+        if (!b->text) {
+            if (!insert) return NULL;
+            *b = (struct rule_bucket){ text, len, hash, field, kind, -1, -1 };
+            return b;
         }
-        
-        // Match title (supports wildcards)
-        if (rule->title[0] && fnmatch(rule->title, title, 0) != 0) {
+        if (b->hash == hash && b->field == field && b->kind == kind &&
+            b->len == len && memcmp(b->text, text, len) == 0)
+            return b;
+    }
+}
+
+static void lengths_add(struct literal_lengths *l, size_t len) {
+    for (int i = 0; i < l->count; i++) {
+        if (l->lengths[i] == len) return;
+    }
+    size_t *grown = realloc(l->lengths, (l->count + 1) * sizeof(*grown));
+    if (!grown) return;
+    l->lengths = grown;
+    l->lengths[l->count++] = len;
+}
+
+static uint32_t rule_hash(const struct window_rule *r) {
+    uint32_t h = HASH_SEED;
+    const char *strings[] = { r->app_id, r->title };
+    for (int i = 0; i < 2; i++) {
+        // Length-prefixed so ("ab", "c") and ("a", "bc") differ; NULL is ~0
+        uint32_t len = strings[i] ? strlen(strings[i]) : ~0u;
+        h = hash_bytes(h, &len, sizeof(len));
+        if (strings[i]) h = hash_bytes(h, strings[i], len);
+    }
+
+    int ints[] = { r->floating, r->fullscreen, r->workspace, r->x, r->y,
+                   r->width, r->height, r->has_position, r->has_size,
+                   r->has_opacity };
+    h = hash_bytes(h, ints, sizeof(ints));
+    return hash_bytes(h, &r->opacity, sizeof(r->opacity));
+}
+
+static void matcher_reset(void) {
+    free(matcher.rules);
+    free(matcher.buckets);
+    free(matcher.unindexed);
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        free(matcher.prefix[f].lengths);
+        free(matcher.suffix[f].lengths);
+    }
+    int *candidates = matcher.candidates;
+    int candidate_capacity = matcher.candidate_capacity;
+    memset(&matcher, 0, sizeof(matcher));
+    matcher.candidates = candidates;
+    matcher.candidate_capacity = candidate_capacity;
+}
+
+static void matcher_compile(void) {
+    matcher_reset();
+    matcher.compiled = true;
+    if (config.rule_count == 0) return;
+
+    int n = config.rule_count;
+    uint32_t size = 16;
+    while (size < (uint32_t)n * 2) size <<= 1;
+
+    matcher.rules = calloc(n, sizeof(*matcher.rules));
+    matcher.buckets = calloc(size, sizeof(*matcher.buckets));
+    matcher.unindexed = calloc(n, sizeof(*matcher.unindexed));
+    if (!matcher.rules || !matcher.buckets || !matcher.unindexed) {
+        fprintf(stderr, "Out of memory compiling window rules\n");
+        matcher_reset();    // retry on the next window
+        return;
+    }
+    matcher.bucket_mask = size - 1;
+
+    for (int i = 0; i < n; i++) {
+        const struct window_rule *r = &config.rules[i];
+        struct compiled_rule *c = &matcher.rules[i];
+        pattern_compile(&c->patterns[FIELD_APP_ID], r->app_id);
+        pattern_compile(&c->patterns[FIELD_TITLE], r->title);
+        c->hash = rule_hash(r);
+        c->next = -1;
+
+        // Index on app_id if it is hashable, else on title, else scan it
+        int field = -1;
+        for (int f = 0; f < FIELD_COUNT && field < 0; f++) {
+            enum pattern_kind kind = c->patterns[f].kind;
+            if (kind == PATTERN_EXACT || kind == PATTERN_PREFIX ||
+                kind == PATTERN_SUFFIX)
+                field = f;
+        }
+        if (field < 0) {
+            matcher.unindexed[matcher.unindexed_count++] = i;
             continue;
         }
-        
-        // Apply rule
-        if (rule->floating) {
-            toplevel->floating = true;
+
+        const struct pattern *p = &c->patterns[field];
+        struct rule_bucket *b = bucket_find(field, p->kind, p->text, p->len, true);
+        if (b->last >= 0) matcher.rules[b->last].next = i;
+        else b->first = i;
+        b->last = i;
+
+        if (p->kind == PATTERN_PREFIX) lengths_add(&matcher.prefix[field], p->len);
+        if (p->kind == PATTERN_SUFFIX) lengths_add(&matcher.suffix[field], p->len);
+    }
+}
+
+static void candidates_add(int *count, int rule) {
+    if (*count >= matcher.candidate_capacity) {
+        int capacity = matcher.candidate_capacity ? matcher.candidate_capacity * 2 : 32;
+        int *grown = realloc(matcher.candidates, capacity * sizeof(*grown));
+        if (!grown) return;
+        matcher.candidates = grown;
+        matcher.candidate_capacity = capacity;
+    }
+    matcher.candidates[(*count)++] = rule;
+}
+
+static void candidates_add_bucket(int *count, int field, int kind,
+                                  const char *text, size_t len) {
+    struct rule_bucket *b = bucket_find(field, kind, text, len, false);
+    for (int i = b ? b->first : -1; i >= 0; i = matcher.rules[i].next)
+        candidates_add(count, i);
+}
+
+static int compare_ints(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * Fill matcher.candidates with the rules matching app_id and title, in
+ * config order so later rules still override earlier ones. Every rule sits
+ * in exactly one bucket or the unindexed list, so there are no duplicates.
+ */
+static int rules_match(const char *app_id, const char *title) {
+    if (!matcher.compiled) matcher_compile();
+    if (!matcher.rules) return 0;
+
+    const char *values[FIELD_COUNT] = { app_id ? app_id : "", title ? title : "" };
+    size_t lens[FIELD_COUNT] = { strlen(values[0]), strlen(values[1]) };
+
+    int count = 0;
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        candidates_add_bucket(&count, f, PATTERN_EXACT, values[f], lens[f]);
+        for (int i = 0; i < matcher.prefix[f].count; i++) {
+            size_t len = matcher.prefix[f].lengths[i];
+            if (len <= lens[f])
+                candidates_add_bucket(&count, f, PATTERN_PREFIX, values[f], len);
+        }
+        for (int i = 0; i < matcher.suffix[f].count; i++) {
+            size_t len = matcher.suffix[f].lengths[i];
+            if (len <= lens[f])
+                candidates_add_bucket(&count, f, PATTERN_SUFFIX,
+                                      values[f] + lens[f] - len, len);
         }
-        
-        if (rule->fullscreen) {
-            toplevel->fullscreen = true;
+    }
+    for (int i = 0; i < matcher.unindexed_count; i++)
+        candidates_add(&count, matcher.unindexed[i]);
+
+    // The bucket only vouches for one field; check both
+    int matched = 0;
+    for (int i = 0; i < count; i++) {
+        const struct compiled_rule *c = &matcher.rules[matcher.candidates[i]];
+        if (pattern_match(&c->patterns[FIELD_APP_ID], values[0], lens[0]) &&
+            pattern_match(&c->patterns[FIELD_TITLE], values[1], lens[1]))
+            matcher.candidates[matched++] = matcher.candidates[i];
+    }
+    qsort(matcher.candidates, matched, sizeof(int), compare_ints);
+    return matched;
+}
+
+// Record rule as applied; false if it already was
+static bool rule_history_add(struct rule_history *history, uint32_t hash) {
+    for (int i = 0; i < history->count; i++) {
+        if (history->hashes[i] == hash) return false;
+    }
+    if (history->count >= history->capacity) {
+        int capacity = history->capacity ? history->capacity * 2 : 4;
+        uint32_t *grown = realloc(history->hashes, capacity * sizeof(*grown));
+        if (!grown) return true;    // apply anyway, it just may apply again
+        history->hashes = grown;
+        history->capacity = capacity;
+    }
+    history->hashes[history->count++] = hash;
+    return true;
+}
+
+// The matcher points into the rule table, which every reload replaces
+void window_rules_reset(void) {
+    matcher_reset();
+}
+
+void rule_history_finish(struct rule_history *history) {
+    free(history->hashes);
+    history->hashes = NULL;
+    history->count = history->capacity = 0;
+}
+
+/*
+ * XDG TOPLEVELS
+ */
+static struct wlr_scene_node *toplevel_node(struct toplevel *toplevel) {
+    return toplevel->decor.tree ?
+        &toplevel->decor.tree->node : &toplevel->scene_tree->node;
+}
+
+// Before map the fields are set directly; toplevel_map() acts on them
+static bool toplevel_apply_rules(struct toplevel *toplevel, bool mapped) {
+    struct server *server = toplevel->server;
+    int count = rules_match(toplevel->xdg_toplevel->app_id,
+                            toplevel->xdg_toplevel->title);
+    bool positioned = false;
+    bool applied = false;
+
+    for (int i = 0; i < count; i++) {
+        int index = matcher.candidates[i];
+        const struct window_rule *rule = &config.rules[index];
+        if (!rule_history_add(&toplevel->rules_applied, matcher.rules[index].hash))
+            continue;
+        applied = true;
+
+        if (rule->floating && !toplevel->floating) {
+            if (mapped) handle_action(server, toplevel, ACTION_TOGGLE_FLOATING, "");
+            else toplevel->floating = true;
         }
-        
-        if (rule->workspace > 0) {
-            toplevel->workspace = rule->workspace;
+
+        if (rule->fullscreen && !toplevel->fullscreen) {
+            if (mapped) handle_action(server, toplevel, ACTION_FULLSCREEN, "");
+            else toplevel->fullscreen = true;
         }
-        
+
+        if (rule->workspace > 0 && rule->workspace != toplevel->workspace) {
+            if (mapped) {
+                char ws[16];
+                snprintf(ws, sizeof(ws), "%d", rule->workspace);
+                handle_action(server, toplevel, ACTION_MOVE_TO_WORKSPACE, ws);
+            } else {
+                toplevel->workspace = rule->workspace;
+            }
+        }
+
         if (rule->has_position) {
-            struct wlr_scene_node *node = toplevel->decor.tree ? 
-                &toplevel->decor.tree->node : &toplevel->scene_tree->node;
-            wlr_scene_node_set_position(node, rule->x, rule->y);
+            wlr_scene_node_set_position(toplevel_node(toplevel), rule->x, rule->y);
+            positioned = true;
         }
-        
+
         if (rule->has_size) {
-            wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel, 
+            wlr_xdg_toplevel_set_size(toplevel->xdg_toplevel,
                 rule->width, rule->height);
         }
-        
+
         if (rule->has_opacity) {
             toplevel->opacity = rule->opacity;
         }
     }
+
+    if (mapped && applied) ipc_tree_mark_dirty(server, toplevel);
+    return positioned;
+}
+
+bool apply_window_rules(struct toplevel *toplevel) {
+    return toplevel_apply_rules(toplevel, false);
+}
+
+void window_rules_changed(struct toplevel *toplevel) {
+    toplevel_apply_rules(toplevel, true);
+}
+
+/*
+ * XWAYLAND
+ * X11 windows match their WM_CLASS class against app_id.
+ */
+static struct wlr_scene_node *xwayland_node(struct xwayland_surface *xsurface) {
+    return xsurface->decor.tree ?
+        &xsurface->decor.tree->node : &xsurface->scene_tree->node;
+}
+
+static bool xwayland_apply_rules(struct xwayland_surface *xsurface, bool mapped) {
+    struct server *server = xsurface->server;
+    struct wlr_xwayland_surface *xs = xsurface->xwayland_surface;
+    int count = rules_match(xs->class, xs->title);
+    bool positioned = false;
+    bool rearrange = false;
+
+    for (int i = 0; i < count; i++) {
+        int index = matcher.candidates[i];
+        const struct window_rule *rule = &config.rules[index];
+        if (!rule_history_add(&xsurface->rules_applied, matcher.rules[index].hash))
+            continue;
+
+        if (rule->floating && !xsurface->floating) {
+            xsurface->floating = true;
+            rearrange = true;
+        }
+
+        if (rule->fullscreen && !xsurface->fullscreen)
+            xwayland_surface_set_fullscreen(xsurface, true);
+
+        if (rule->workspace > 0 && rule->workspace != xsurface->workspace) {
+            xsurface->workspace = rule->workspace;
+            if (rule->workspace != server->current_workspace)
+                wlr_scene_node_set_enabled(xwayland_node(xsurface), false);
+            rearrange = true;
+        }
+
+        if (rule->has_position || rule->has_size) {
+            struct wlr_scene_node *node = xwayland_node(xsurface);
+            xwayland_surface_configure(xsurface,
+                rule->has_position ? rule->x : node->x,
+                rule->has_position ? rule->y : node->y,
+                rule->has_size ? rule->width : xs->width,
+                rule->has_size ? rule->height : xs->height);
+            positioned |= rule->has_position;
+        }
+
+        if (rule->has_opacity) {
+            xsurface->opacity = rule->opacity;
+        }
+    }
+
+    // Before map, xwayland_surface_map() arranges once everything is set
+    if (mapped && rearrange) arrange_windows(server);
+    return positioned;
+}
+
+bool apply_xwayland_rules(struct xwayland_surface *xsurface) {
+    return xwayland_apply_rules(xsurface, false);
+}
+
+void xwayland_rules_changed(struct xwayland_surface *xsurface) {
+    xwayland_apply_rules(xsurface, true);
 }
@@ -4,6 +4,8 @@
 #include "script.h"
 #include "core.h"
 #include "config.h"
+#include "config_live.h"
+#include "spawner.h"
 #include <magpie.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -120,10 +122,7 @@ static Val native_spawn(const Val *args) {
         return (Val){.tag = VAL_NULL};
     }
     
-    if (fork() == 0) {
-        execl("/bin/sh", "sh", "-c", args[0].u.s->data, NULL);
-        _exit(1);
-    }
+    spawn_command(args[0].u.s->data);
     return (Val){.tag = VAL_NULL};
 }
 
@@ -145,8 +144,9 @@ static Val native_reload_config(const Val *args) {
     (void)args;
     extern struct server g_server;
     
-    config_reload();
-    arrange_windows(&g_server);
+    uint32_t changed;
+    if (config_reload(&changed) == 0)
+        config_apply_live(&g_server, changed);
     return (Val){.tag = VAL_NULL};
 }
 
@@ -158,11 +158,8 @@ static Val native_notify(const Val *args) {
     }
     
     /* Use notify-send if available */
-    if (fork() == 0) {
-        execl("/usr/bin/notify-send", "notify-send", 
-              args[0].u.s->data, args[1].u.s->data, NULL);
-        _exit(1);
-    }
+    const char *argv[] = { "notify-send", args[0].u.s->data, args[1].u.s->data, NULL };
+    spawn_argv(argv);
     return (Val){.tag = VAL_NULL};
 }
 
@@ -2,6 +2,7 @@
 
 #include "core.h"
 #include "config.h"
+#include "config_live.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -9,6 +10,7 @@
 #include <linux/input-event-codes.h>
 #include "gesture_config.h"
 #include "gesture.h"
+#include "spawner.h"
 #include <wlr/types/wlr_layer_shell_v1.h>
 
 struct cursor_state cursor_state = {0};
@@ -220,6 +222,14 @@ static void tile_output(struct server *server, struct output *output) {
 }
 
 void arrange_windows(struct server *server) {
+    // Nearly every layout or workspace change ends up here
+    ipc_state_mark_dirty(server);
+    
+    if (server->arrange_defer > 0) {
+        server->arrange_pending = true;
+        return;
+    }
+    
     if (server->mode == MODE_FLOATING) {
         return;
     }
@@ -230,6 +240,18 @@ void arrange_windows(struct server *server) {
     }
 }
 
+// Batch any number of arrange_windows() calls into one at arrange_end()
+void arrange_begin(struct server *server) {
+    server->arrange_defer++;
+}
+
+void arrange_end(struct server *server) {
+    if (server->arrange_defer > 0 && --server->arrange_defer == 0 && server->arrange_pending) {
+        server->arrange_pending = false;
+        arrange_windows(server);
+    }
+}
+
 static void toggle_mode(struct server *server) {
     if (server->mode == MODE_TILING) {
         server->mode = MODE_FLOATING;
@@ -250,6 +272,7 @@ static void toggle_mode(struct server *server) {
         arrange_windows(server);
         printf("Switched to TILING mode\n");
     }
+    ipc_event_mode(server);
 }
 
 /*
@@ -276,6 +299,7 @@ void focus_toplevel(struct toplevel *toplevel) {
     
     struct server *server = toplevel->server;
     struct wlr_keyboard *kb = wlr_seat_get_keyboard(server->seat);
+    bool changed = toplevel != get_focused_toplevel(server);
     
     if (toplevel->decor.tree) {
         wlr_scene_node_raise_to_top(&toplevel->decor.tree->node);
@@ -293,6 +317,8 @@ void focus_toplevel(struct toplevel *toplevel) {
             toplevel->xdg_toplevel->base->surface,
             kb->keycodes, kb->num_keycodes, &kb->modifiers);
     }
+    
+    if (changed) ipc_event_window(server, toplevel, "focus");
 }
 
 static struct toplevel *get_toplevel_in_direction(struct server *server, 
@@ -358,7 +384,7 @@ static void toplevel_map(struct wl_listener *listener, void *data) {
         decor_create(toplevel);
     }
     
-    apply_window_rules(toplevel);
+    bool placed = apply_window_rules(toplevel);
     
     // Handle preselect for window insertion
     if (focused && !toplevel->floating && server->mode == MODE_TILING && server->preselect != PRESELECT_NONE) {
@@ -397,7 +423,7 @@ static void toplevel_map(struct wl_listener *listener, void *data) {
     
     if (!toplevel->floating) {
         arrange_windows(server);
-    } else {
+    } else if (!placed) {
         struct output *output;
         wl_list_for_each(output, &server->outputs, link) {
             int x = (output->wlr_output->width - 800) / 2;
@@ -413,6 +439,9 @@ static void toplevel_map(struct wl_listener *listener, void *data) {
     }
     
     focus_toplevel(toplevel);
+    
+    ipc_tree_mark_dirty(server, toplevel);
+    ipc_event_window(server, toplevel, "new");
 }
 
 static void toplevel_unmap(struct wl_listener *listener, void *data) {
@@ -426,6 +455,14 @@ static void toplevel_unmap(struct wl_listener *listener, void *data) {
         cursor_state.mode = CURSOR_NORMAL;
         cursor_state.toplevel = NULL;
     }
+    if (server->pointer_hover == toplevel)
+        server->pointer_hover = NULL;
+    
+    // Rules apply afresh if the window is mapped again
+    rule_history_finish(&toplevel->rules_applied);
+    
+    ipc_tree_mark_dirty(server, toplevel);
+    ipc_event_window(server, toplevel, "close");
     
     arrange_windows(server);
     
@@ -452,6 +489,8 @@ static void toplevel_commit(struct wl_listener *listener, void *data) {
 static void toplevel_destroy(struct wl_listener *listener, void *data) {
     struct toplevel *toplevel = wl_container_of(listener, toplevel, destroy);
     
+    ipc_toplevel_destroy(toplevel);
+    command_toplevel_destroy(toplevel);
     decor_destroy(toplevel);
     
     wl_list_remove(&toplevel->map.link);
@@ -460,6 +499,9 @@ static void toplevel_destroy(struct wl_listener *listener, void *data) {
     wl_list_remove(&toplevel->destroy.link);
     wl_list_remove(&toplevel->request_fullscreen.link);
     wl_list_remove(&toplevel->request_minimize.link);
+    wl_list_remove(&toplevel->set_title.link);
+    wl_list_remove(&toplevel->set_app_id.link);
+    rule_history_finish(&toplevel->rules_applied);
     free(toplevel);
 }
 
@@ -533,6 +575,25 @@ static void toplevel_request_minimize(struct wl_listener *listener, void *data)
     }
 }
 
+static void toplevel_set_title(struct wl_listener *listener, void *data) {
+    struct toplevel *toplevel = wl_container_of(listener, toplevel, set_title);
+    (void)data;
+    
+    if (!toplevel->xdg_toplevel->base->surface->mapped) return;
+    ipc_tree_mark_dirty(toplevel->server, toplevel);
+    ipc_event_window(toplevel->server, toplevel, "title");
+    window_rules_changed(toplevel);
+}
+
+static void toplevel_set_app_id(struct wl_listener *listener, void *data) {
+    struct toplevel *toplevel = wl_container_of(listener, toplevel, set_app_id);
+    (void)data;
+    
+    ipc_tree_mark_dirty(toplevel->server, toplevel);
+    if (toplevel->xdg_toplevel->base->surface->mapped)
+        window_rules_changed(toplevel);
+}
+
 void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
     struct server *server = wl_container_of(listener, server, new_xdg_toplevel);
     struct wlr_xdg_toplevel *xdg_toplevel = data;
@@ -568,6 +629,12 @@ void server_new_xdg_toplevel(struct wl_listener *listener, void *data) {
     
     toplevel->request_minimize.notify = toplevel_request_minimize;
     wl_signal_add(&xdg_toplevel->events.request_minimize, &toplevel->request_minimize);
+    
+    toplevel->set_title.notify = toplevel_set_title;
+    wl_signal_add(&xdg_toplevel->events.set_title, &toplevel->set_title);
+    
+    toplevel->set_app_id.notify = toplevel_set_app_id;
+    wl_signal_add(&xdg_toplevel->events.set_app_id, &toplevel->set_app_id);
 
     wlr_xdg_toplevel_set_size(xdg_toplevel, 0, 0);
 }
@@ -664,28 +731,8 @@ void cursor_motion(struct wl_listener *listener, void *data) {
     wlr_cursor_move(server->cursor, &event->pointer->base, event->delta_x,
                     event->delta_y);
     
-    // Update cursor appearance and handle hover events
-    double sx, sy;
-    struct wlr_surface *surface = NULL;
-    struct toplevel *toplevel = toplevel_at(server, server->cursor->x,
-        server->cursor->y, &surface, &sx, &sy);
-    
-    if (config.decor.enabled && toplevel) {
-        enum decor_hit hit = decor_hit_test(toplevel, server->cursor->x, server->cursor->y);
-        if (hit == HIT_TITLEBAR || (hit >= HIT_RESIZE_TOP && hit <= HIT_RESIZE_BOTTOM_RIGHT)) {
-            wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr,
-                hit == HIT_TITLEBAR ? "default" : "se-resize");
-        } else if (toplevel) {
-            wlr_cursor_set_xcursor(server->cursor, server->cursor_mgr, "default");
-        }
-    }
-    
-    if (surface) {
-        wlr_seat_pointer_notify_enter(server->seat, surface, sx, sy);
-        wlr_seat_pointer_notify_motion(server->seat, event->time_msec, sx, sy);
-    } else {
-        wlr_seat_pointer_clear_focus(server->seat);
-    }
+    // Hover, cursor image and focus-follows-mouse are settled on the next frame
+    process_cursor_motion(server, event->time_msec);
 }
 
 void cursor_button(struct wl_listener *listener, void *data) {
@@ -920,8 +967,12 @@ void cursor_button(struct wl_listener *listener, void *data) {
  */
 
 bool handle_keybind(struct server *server, enum keybind_action action, const char *arg) {
-    struct toplevel *focused = get_focused_toplevel(server);
-    
+    return handle_action(server, get_focused_toplevel(server), action, arg);
+}
+
+// Window actions apply to `focused`, which IPC commands point at any window
+bool handle_action(struct server *server, struct toplevel *focused,
+                   enum keybind_action action, const char *arg) {
     switch (action) {
     
     case ACTION_PRESELECT_LEFT:
@@ -965,10 +1016,7 @@ bool handle_keybind(struct server *server, enum keybind_action action, const cha
         return true;
         
     case ACTION_SPAWN:
-        if (fork() == 0) {
-            execl("/bin/sh", "sh", "-c", arg, NULL);
-            _exit(0);
-        }
+        spawn_command(arg);
         return true;
     
     case ACTION_CLOSE:
@@ -1329,10 +1377,12 @@ bool handle_keybind(struct server *server, enum keybind_action action, const cha
     case ACTION_MODE_TILING:
         server->mode = MODE_TILING;
         arrange_windows(server);
+        ipc_event_mode(server);
         return true;
         
     case ACTION_MODE_FLOATING:
         server->mode = MODE_FLOATING;
+        ipc_event_mode(server);
         return true;
         
     case ACTION_TOGGLE_MODE:
@@ -1363,10 +1413,26 @@ bool handle_keybind(struct server *server, enum keybind_action action, const cha
         arrange_windows(server);
         return true;
     
-    case ACTION_RELOAD_CONFIG:
-        config_reload();
-        arrange_windows(server);
+    case ACTION_RELOAD_CONFIG: {
+        uint32_t changed;
+        if (config_reload(&changed) == 0)
+            config_apply_live(server, changed);
         return true;
+    }
+        
+    case ACTION_LAYOUT_NEXT:
+        keyboard_layout_next(server);
+        return true;
+        
+    case ACTION_BINDING_MODE: {
+        int mode = binding_mode_find(arg[0] ? arg : "default");
+        if (mode < 0) {
+            fprintf(stderr, "Unknown binding mode: %s\n", arg);
+            return true;
+        }
+        server->binding_mode = mode;
+        return true;
+    }
         
     case ACTION_EXIT:
         wl_display_terminate(server->display);
@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+
+#include "spawner.h"
+#include "config.h"
+#include <errno.h>
+#include <pthread.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/*
+ * ============================================================================
+ * Spawner
+ * fork() copies the compositor's page tables and turns every written page
+ * into a copy-on-write fault until the child execs, on whichever thread
+ * called it. The helper is forked while the process is still small and
+ * single-threaded; afterwards the compositor only sends it a datagram.
+ * Programs started by the helper are its children, so they inherit none of
+ * the compositor's descriptors and the helper reaps them.
+ * ============================================================================
+ */
+
+// A request carries argv and the whole environment; larger ones spawn directly
+#define SPAWN_MAX_REQUEST (64 * 1024)
+
+#define SPAWN_SCOPE (1u << 0)
+
+// Followed by argc + envc NUL-terminated strings
+struct spawn_request {
+    uint32_t flags;
+    uint32_t argc;
+    uint32_t envc;
+};
+
+extern char **environ;
+
+static const char *const scope_argv[] = {
+    "systemd-run", "--user", "--scope", "--quiet", "--collect", "--slice=app.slice",
+};
+#define SCOPE_ARGC (sizeof(scope_argv) / sizeof(scope_argv[0]))
+
+static struct {
+    int fd;                 // compositor end of the socketpair
+    pid_t helper;
+    struct wl_event_source *sigchld;
+
+    // Children spawned without the helper, waiting to be reaped
+    pid_t *children;
+    int child_count;
+    int child_capacity;
+
+    bool no_systemd_run;
+} spawner = { .fd = -1, .helper = -1 };
+
+static int spawn_scoped(char *const argv[], char *const envp[],
+                        const posix_spawnattr_t *attr, pid_t *pid) {
+    int argc = 0;
+    while (argv[argc]) argc++;
+    char **scoped = malloc((SCOPE_ARGC + argc + 1) * sizeof(*scoped));
+    if (!scoped) return ENOMEM;
+
+    memcpy(scoped, scope_argv, sizeof(scope_argv));
+    memcpy(scoped + SCOPE_ARGC, argv, (argc + 1) * sizeof(*scoped));
+    int err = posix_spawnp(pid, scoped[0], NULL, attr, scoped, envp);
+    free(scoped);
+    return err;
+}
+
+/*
+ * Start argv with envp. posix_spawnp() looks argv[0] up in the caller's
+ * PATH, so environ is pointed at envp for the call; the helper has no other
+ * threads, and in the compositor envp is environ already.
+ */
+static int spawn_exec(char *const argv[], char *const envp[], bool scope, pid_t *pid) {
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    // Neither the blocked SIGCHLD nor the helper's SIG_IGN may leak into apps
+    sigset_t set;
+    sigemptyset(&set);
+    posix_spawnattr_setsigmask(&attr, &set);
+    sigfillset(&set);
+    posix_spawnattr_setsigdefault(&attr, &set);
+
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    // Not in the compositor's session, so a terminal hangup spares them
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    char **saved = environ;
+    environ = (char **)envp;
+
+    int err = ENOENT;
+    if (scope && !spawner.no_systemd_run) {
+        err = spawn_scoped(argv, envp, &attr, pid);
+        if (err == ENOENT) {
+            spawner.no_systemd_run = true;
+            fprintf(stderr, "Spawn: systemd-run not found, starting programs without a scope\n");
+        }
+    }
+    if (err == ENOENT)
+        err = posix_spawnp(pid, argv[0], NULL, &attr, argv, envp);
+
+    environ = saved;
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
+
+static void spawn_helper_handle(char *buf, size_t len) {
+    struct spawn_request req;
+    if (len < sizeof(req)) return;
+    memcpy(&req, buf, sizeof(req));
+
+    // Every string is at least its NUL, which bounds the counts
+    size_t count = (size_t)req.argc + req.envc;
+    if (req.argc == 0 || count > len - sizeof(req)) return;
+
+    char **strings = calloc(count + 2, sizeof(*strings));
+    if (!strings) return;
+    char **argv = strings;
+    char **envp = strings + req.argc + 1;
+
+    char *p = buf + sizeof(req), *end = buf + len;
+    for (size_t i = 0; i < count; i++) {
+        char *nul = memchr(p, '\0', end - p);
+        if (!nul) {
+            free(strings);
+            return;
+        }
+        if (i < req.argc) argv[i] = p;
+        else envp[i - req.argc] = p;
+        p = nul + 1;
+    }
+
+    pid_t pid;
+    int err = spawn_exec(argv, envp, req.flags & SPAWN_SCOPE, &pid);
+    if (err != 0) fprintf(stderr, "Spawn: %s: %s\n", argv[0], strerror(err));
+    free(strings);
+}
+
+static void spawn_helper(int fd) {
+    prctl(PR_SET_NAME, "starview-spawn");
+
+    // The kernel reaps the helper's children; nothing here waits for them
+    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_NOCLDWAIT };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    // Ctrl+C is for the compositor; the helper follows it out on EOF
+    signal(SIGINT, SIG_IGN);
+
+    static char buf[SPAWN_MAX_REQUEST];
+    for (;;) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len == 0) _exit(0);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            _exit(1);
+        }
+        spawn_helper_handle(buf, len);
+    }
+}
+
+int spawn_init(void) {
+    // Blocked before any thread exists, so every thread inherits the mask and
+    // SIGCHLD only ever reaches the signalfd spawn_attach() sets up
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        perror("Spawn: socketpair");
+        return -1;
+    }
+
+    // Buffered output would otherwise be written by both processes
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Spawn: fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        spawn_helper(fds[1]);
+    }
+
+    close(fds[1]);
+    spawner.fd = fds[0];
+    spawner.helper = pid;
+    printf("Spawn: helper is pid %d\n", (int)pid);
+    return 0;
+}
+
+static void spawn_helper_lost(void) {
+    if (spawner.fd < 0) return;
+    close(spawner.fd);
+    spawner.fd = -1;
+    fprintf(stderr, "Spawn: helper exited, spawning directly\n");
+}
+
+static void spawn_reap(void) {
+    for (int i = 0; i < spawner.child_count;) {
+        if (waitpid(spawner.children[i], NULL, WNOHANG) != 0)
+            spawner.children[i] = spawner.children[--spawner.child_count];
+        else
+            i++;
+    }
+
+    if (spawner.helper > 0 && waitpid(spawner.helper, NULL, WNOHANG) != 0) {
+        spawner.helper = -1;
+        spawn_helper_lost();
+    }
+}
+
+static int spawn_handle_sigchld(int signal_number, void *data) {
+    (void)signal_number;
+    (void)data;
+    spawn_reap();
+    return 0;
+}
+
+void spawn_attach(struct wl_event_loop *loop) {
+    spawner.sigchld = wl_event_loop_add_signal(loop, SIGCHLD, spawn_handle_sigchld, NULL);
+}
+
+// Never blocks: a full socket means the helper is behind, so spawn directly
+static int spawn_send(const char *const argv[], uint32_t flags) {
+    struct spawn_request req = { .flags = flags };
+    size_t size = sizeof(req);
+    for (; argv[req.argc]; req.argc++) size += strlen(argv[req.argc]) + 1;
+    for (; environ[req.envc]; req.envc++) size += strlen(environ[req.envc]) + 1;
+    if (size > SPAWN_MAX_REQUEST) return -1;
+
+    char *buf = malloc(size);
+    if (!buf) return -1;
+    memcpy(buf, &req, sizeof(req));
+    char *p = buf + sizeof(req);
+    for (uint32_t i = 0; i < req.argc; i++) p = stpcpy(p, argv[i]) + 1;
+    for (uint32_t i = 0; i < req.envc; i++) p = stpcpy(p, environ[i]) + 1;
+
+    ssize_t n = send(spawner.fd, buf, size, MSG_DONTWAIT | MSG_NOSIGNAL);
+    int err = errno;
+    free(buf);
+    if (n == (ssize_t)size) return 0;
+
+    if (n < 0 && (err == EPIPE || err == ECONNRESET)) spawn_helper_lost();
+    return -1;
+}
+
+static int spawn_direct(const char *const argv[], uint32_t flags) {
+    if (spawner.child_count == spawner.child_capacity) {
+        int capacity = spawner.child_capacity ? spawner.child_capacity * 2 : 8;
+        pid_t *grown = realloc(spawner.children, capacity * sizeof(*grown));
+        if (!grown) return -1;
+        spawner.children = grown;
+        spawner.child_capacity = capacity;
+    }
+
+    pid_t pid;
+    int err = spawn_exec((char *const *)argv, environ, flags & SPAWN_SCOPE, &pid);
+    if (err != 0) {
+        fprintf(stderr, "Spawn: %s: %s\n", argv[0], strerror(err));
+        return -1;
+    }
+    spawner.children[spawner.child_count++] = pid;
+    return 0;
+}
+
+// systemd-run --user fails after exec without the user bus, taking the program with it
+static bool spawn_user_bus(void) {
+    if (getenv("DBUS_SESSION_BUS_ADDRESS")) return true;
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (!runtime) return false;
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/bus", runtime);
+    return access(path, F_OK) == 0;
+}
+
+int spawn_argv(const char *const argv[]) {
+    if (!argv || !argv[0]) return -1;
+
+    uint32_t flags = config.systemd_scope && spawn_user_bus() ? SPAWN_SCOPE : 0;
+    if (spawner.fd >= 0 && spawn_send(argv, flags) == 0) return 0;
+    return spawn_direct(argv, flags);
+}
+
+int spawn_command(const char *command) {
+    if (!command || !command[0]) return -1;
+    const char *argv[] = { "/bin/sh", "-c", command, NULL };
+    return spawn_argv(argv);
+}
+
+void spawn_finish(void) {
+    if (spawner.sigchld) wl_event_source_remove(spawner.sigchld);
+    spawner.sigchld = NULL;
+
+    // EOF on the socket ends the helper; programs it started keep running
+    if (spawner.fd >= 0) close(spawner.fd);
+    spawner.fd = -1;
+    if (spawner.helper > 0) waitpid(spawner.helper, NULL, 0);
+    spawner.helper = -1;
+
+    free(spawner.children);
+    spawner.children = NULL;
+    spawner.child_count = spawner.child_capacity = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef SPAWNER_H
+#define SPAWNER_H
+
+#include <wayland-server-core.h>
+
+/*
+ * Process spawning. spawn_init() forks a small helper before the compositor
+ * has threads, GPU buffers or much of a heap; every later launch is a
+ * message to it over a socketpair, and it starts the program with
+ * posix_spawn() and reaps it. Each request carries the compositor's current
+ * environment, so WAYLAND_DISPLAY and DISPLAY set after the fork still
+ * reach the program. With general.systemd_scope, and a user bus to reach
+ * systemd through, the program is started by `systemd-run --user --scope`
+ * in its own cgroup under app.slice.
+ *
+ * If the helper is gone the compositor spawns directly, still without
+ * fork(), and reaps those children itself.
+ */
+
+/* Call first thing in main(), before any thread is created. */
+int spawn_init(void);
+/* Reap the helper and any directly spawned children on SIGCHLD. */
+void spawn_attach(struct wl_event_loop *loop);
+void spawn_finish(void);
+
+/* /bin/sh -c command */
+int spawn_command(const char *command);
+/* argv[0] is looked up in PATH; argv is NULL-terminated */
+int spawn_argv(const char *const argv[]);
+
+#endif
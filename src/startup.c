@@ -0,0 +1,58 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "startup.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static struct {
+    pthread_mutex_t lock;
+    struct timespec start;
+    bool trace;
+    struct startup_phase phases[STARTUP_MAX_PHASES];
+    int phase_count;
+    double first_frame_ms;
+} startup = { .lock = PTHREAD_MUTEX_INITIALIZER, .first_frame_ms = -1 };
+
+static double startup_elapsed_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - startup.start.tv_sec) * 1000.0 +
+           (now.tv_nsec - startup.start.tv_nsec) / 1e6;
+}
+
+void startup_begin(void) {
+    clock_gettime(CLOCK_MONOTONIC, &startup.start);
+    const char *trace = getenv("STARVIEW_TRACE_STARTUP");
+    startup.trace = trace && trace[0] && strcmp(trace, "0") != 0;
+}
+
+void startup_mark(const char *phase) {
+    pthread_mutex_lock(&startup.lock);
+    double ms = startup_elapsed_ms();
+    double last = startup.phase_count > 0 ?
+        startup.phases[startup.phase_count - 1].ms : 0;
+    if (startup.phase_count < STARTUP_MAX_PHASES)
+        startup.phases[startup.phase_count++] = (struct startup_phase){ phase, ms };
+    if (startup.trace)
+        printf("[STARTUP] %8.2f ms  (+%7.2f)  %s\n", ms, ms - last, phase);
+    pthread_mutex_unlock(&startup.lock);
+}
+
+void startup_frame_presented(void) {
+    if (startup.first_frame_ms >= 0) return;
+    startup.first_frame_ms = startup_elapsed_ms();
+    printf("Startup: first frame presented after %.1f ms\n", startup.first_frame_ms);
+}
+
+int startup_phases(const struct startup_phase **phases) {
+    *phases = startup.phases;
+    return startup.phase_count;
+}
+
+double startup_first_frame_ms(void) {
+    return startup.first_frame_ms;
+}
@@ -0,0 +1,27 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+/*
+ * Startup profile. Each init phase of main() is timestamped relative to
+ * startup_begin(); with STARVIEW_TRACE_STARTUP=1 in the environment every
+ * phase is printed as it ends. The time to the first presented frame is
+ * always printed, and everything is in the IPC GET_STATS reply.
+ */
+
+#define STARTUP_MAX_PHASES 32
+
+struct startup_phase {
+    const char *name;   // static string
+    double ms;          // since startup_begin()
+};
+
+void startup_begin(void);
+/* End a phase; safe from worker threads. */
+void startup_mark(const char *phase);
+void startup_frame_presented(void);
+
+int startup_phases(const struct startup_phase **phases);
+/* Negative until the first frame was presented. */
+double startup_first_frame_ms(void);
+
+#endif
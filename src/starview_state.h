@@ -0,0 +1,93 @@
+#ifndef STARVIEW_STATE_H
+#define STARVIEW_STATE_H
+
+/*
+ * Shared state page
+ *
+ * Layout of the read-only memory page the compositor publishes to bars and
+ * widgets. Ask for it with the IPC_GET_STATE_FD message (type 201): the
+ * reply carries two fds via SCM_RIGHTS, the memfd holding this page and an
+ * eventfd that becomes readable whenever the state changes.
+ *
+ *   struct starview_state_page *page =
+ *       mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, memfd, 0);
+ *   struct starview_state state;
+ *   if (starview_state_read(page, &state) == 0) ...
+ *
+ * Reading takes no syscalls and never involves the compositor; drain the
+ * eventfd with read() before re-reading. This header has no dependencies
+ * and can be copied into client projects (C or C++).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define STARVIEW_STATE_MAGIC 0x54535653u  // "SVST"
+#define STARVIEW_STATE_VERSION 1
+
+#define STARVIEW_STATE_MAX_WORKSPACES 10
+#define STARVIEW_STATE_MAX_OUTPUTS 8
+
+enum starview_state_workspace_flags {
+    STARVIEW_WORKSPACE_FOCUSED = (1 << 0),
+    STARVIEW_WORKSPACE_OCCUPIED = (1 << 1),
+};
+
+enum starview_state_mode {
+    STARVIEW_MODE_TILING = 0,
+    STARVIEW_MODE_FLOATING = 1,
+};
+
+struct starview_state_workspace {
+    uint32_t num;
+    uint32_t flags;
+    uint32_t windows;
+};
+
+struct starview_state_output {
+    char name[32];
+    int32_t x, y, width, height;
+    float scale;
+    uint32_t primary;
+};
+
+struct starview_state {
+    uint32_t current_workspace;
+    uint32_t mode;                    // enum starview_state_mode
+
+    uint64_t focused_id;              // same id as in GET_TREE, 0 if none
+    char focused_title[256];
+    char focused_app_id[128];
+
+    uint32_t workspace_count;
+    struct starview_state_workspace workspaces[STARVIEW_STATE_MAX_WORKSPACES];
+
+    uint32_t output_count;
+    struct starview_state_output outputs[STARVIEW_STATE_MAX_OUTPUTS];
+};
+
+struct starview_state_page {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                    // sizeof(struct starview_state_page)
+    uint32_t seq;                     // odd while the compositor is writing
+    uint64_t generation;              // bumped on every published change
+    struct starview_state state;
+};
+
+// Copy a consistent snapshot out of the page; -1 if the writer never settled
+static inline int starview_state_read(const struct starview_state_page *page,
+                                      struct starview_state *out) {
+    for (int tries = 0; tries < 1000; tries++) {
+        uint32_t seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+
+        memcpy(out, (const void *)&page->state, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == seq) return 0;
+    }
+    return -1;
+}
+
+#endif
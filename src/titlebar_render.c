@@ -1234,6 +1234,7 @@ struct rendered_titlebar *titlebar_render_create(struct wlr_scene_tree *parent,
   tb->width = 200;
   tb->height = theme->height;
   tb->active = true;
+  tb->theme_generation = theme->generation;
 
   return tb;
 }
@@ -1255,6 +1256,7 @@ void titlebar_render_update(struct rendered_titlebar *tb,
     return;
 
   bool needs_redraw = (tb->width != width) || (tb->active != active) ||
+                      (tb->theme_generation != theme->generation) ||
                       (title && strcmp(tb->cached_title, title) != 0);
 
   if (!needs_redraw)
@@ -1266,6 +1268,7 @@ void titlebar_render_update(struct rendered_titlebar *tb,
   tb->width = width;
   tb->height = theme->height;
   tb->active = active;
+  tb->theme_generation = theme->generation;
 
   if (title) {
     strncpy(tb->cached_title, title, sizeof(tb->cached_title) - 1);
@@ -1420,6 +1423,8 @@ int titlebar_theme_load_from_config(struct titlebar_theme *theme,
 
   theme->inactive_opacity = 0.85f;
 
+  theme->generation++;
+
   fprintf(stderr, "[TITLEBAR] Theme loaded successfully\n");
   return 0;
 }
@@ -187,6 +187,9 @@ struct titlebar_theme {
     struct color bg_color_inactive;
     struct gradient bg_gradient_inactive;
     float inactive_opacity;
+
+    /* Bumped on every reload so rendered titlebars know to redraw */
+    uint32_t generation;
 };
 
 /*
@@ -213,8 +216,9 @@ struct rendered_titlebar {
     enum button_state max_state;
     enum button_state min_state;
     
-    /* Cached title */
+    /* Cached title and the theme generation it was drawn with */
     char cached_title[256];
+    uint32_t theme_generation;
 };
 
 /*
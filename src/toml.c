@@ -30,6 +30,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -64,31 +65,11 @@ static void *CALLOC(size_t nmemb, size_t sz) {
 
 // some old platforms define strdup macro -- drop it.
 #undef strdup
-#define strdup(x) error - forbidden - use STRDUP instead
-
-static char *STRDUP(const char *s) {
-  int len = strlen(s);
-  char *p = MALLOC(len + 1);
-  if (p) {
-    memcpy(p, s, len);
-    p[len] = 0;
-  }
-  return p;
-}
+#define strdup(x) error - forbidden - use arena_strndup instead
 
 // some old platforms define strndup macro -- drop it.
 #undef strndup
-#define strndup(x) error - forbiden - use STRNDUP instead
-
-static char *STRNDUP(const char *s, size_t n) {
-  size_t len = strnlen(s, n);
-  char *p = MALLOC(len + 1);
-  if (p) {
-    memcpy(p, s, len);
-    p[len] = 0;
-  }
-  return p;
-}
+#define strndup(x) error - forbiden - use arena_strndup instead
 
 /**
  * Convert a char in utf8 into UCS, and store it in *ret.
@@ -301,9 +282,44 @@ struct toml_array_t {
                       'D'ate, 'T'imestamp, 'm'ixed */
 
   int nitem; /* number of elements */
+  int item_cap;
   toml_arritem_t *item;
 };
 
+/*
+ * Arena allocation
+ * Everything a parse creates (tables, arrays, keys, raw values and lookup
+ * indexes) comes from one arena owned by the root table. toml_free() is a
+ * few free() calls however large the document is, and error paths never
+ * unwind half-built trees.
+ */
+typedef struct toml_chunk_t toml_chunk_t;
+struct toml_chunk_t {
+  toml_chunk_t *next;
+  size_t used;
+  size_t size;
+  max_align_t data[];
+};
+
+typedef struct toml_arena_t toml_arena_t;
+struct toml_arena_t {
+  toml_chunk_t *head;
+  size_t next_size; /* doubles with every chunk, up to TOML_ARENA_MAX */
+};
+
+#define TOML_ARENA_MIN 4096
+#define TOML_ARENA_MAX (1 << 20)
+
+/* Tables with at least this many keys get a hash index */
+#define TOML_INDEX_MIN 8
+
+typedef struct toml_slot_t toml_slot_t;
+struct toml_slot_t {
+  uint32_t hash;
+  char kind; /* 'v', 'a', 't', or 0 if empty */
+  int idx;   /* into kval[], arr[] or tab[] */
+};
+
 struct toml_table_t {
   const char *key; /* key to this table */
   bool implicit;   /* table was created implicitly */
@@ -320,6 +336,14 @@ struct toml_table_t {
   /* tables in the table */
   int ntab;
   toml_table_t **tab;
+
+  int kval_cap, arr_cap, tab_cap;
+
+  /* open-addressed index over all keys, NULL while the table is small */
+  toml_slot_t *index;
+  uint32_t index_mask;
+
+  toml_arena_t *arena; /* root only: owns the whole document */
 };
 
 static inline void xfree(const void *x) {
@@ -358,6 +382,7 @@ struct context_t {
   int errbufsz;
 
   token_t tok;
+  toml_arena_t *arena;
   toml_table_t *root;
   toml_table_t *curtab;
 
@@ -419,26 +444,181 @@ static void *expand(void *p, int sz, int newsz) {
   return s;
 }
 
-static void **expand_ptrarr(void **p, int n) {
-  void **s = MALLOC((n + 1) * sizeof(void *));
-  if (!s)
+static toml_arena_t *arena_new(size_t hint) {
+  toml_arena_t *arena = CALLOC(1, sizeof(*arena));
+  if (!arena)
     return 0;
 
-  s[n] = 0;
-  if (p) {
-    memcpy(s, p, n * sizeof(void *));
-    FREE(p);
+  /* Sized from the input so a typical document fits in one chunk */
+  arena->next_size = TOML_ARENA_MIN;
+  while (arena->next_size < hint && arena->next_size < TOML_ARENA_MAX)
+    arena->next_size *= 2;
+  return arena;
+}
+
+static void arena_free(toml_arena_t *arena) {
+  if (!arena)
+    return;
+  toml_chunk_t *chunk = arena->head;
+  while (chunk) {
+    toml_chunk_t *next = chunk->next;
+    FREE(chunk);
+    chunk = next;
   }
+  FREE(arena);
+}
+
+/* Zeroed memory that lives until the arena is freed */
+static void *arena_alloc(toml_arena_t *arena, size_t n) {
+  const size_t align = sizeof(max_align_t);
+  n = (n + align - 1) & ~(align - 1);
+
+  toml_chunk_t *chunk = arena->head;
+  if (!chunk || chunk->size - chunk->used < n) {
+    size_t size = arena->next_size > n ? arena->next_size : n;
+    if (!(chunk = MALLOC(sizeof(*chunk) + size)))
+      return 0;
+    chunk->used = 0;
+    chunk->size = size;
+    chunk->next = arena->head;
+    arena->head = chunk;
+    if (arena->next_size < TOML_ARENA_MAX)
+      arena->next_size *= 2;
+  }
+
+  void *p = (char *)chunk->data + chunk->used;
+  chunk->used += n;
+  memset(p, 0, n);
+  return p;
+}
+
+static char *arena_strndup(toml_arena_t *arena, const char *s, size_t n) {
+  char *p = arena_alloc(arena, n + 1);
+  if (p)
+    memcpy(p, s, n);
+  return p;
+}
+
+/*
+ * Grow an arena array to hold n + 1 elements. Capacity doubles, so a table
+ * or array of n entries costs O(n) copying in total; the outgrown block
+ * stays in the arena until toml_free().
+ */
+static void *arena_grow(toml_arena_t *arena, void *p, int n, int *cap,
+                        size_t elemsz) {
+  if (n < *cap)
+    return p;
+
+  int newcap = *cap ? *cap * 2 : 4;
+  void *s = arena_alloc(arena, newcap * elemsz);
+  if (!s)
+    return 0;
+  if (p)
+    memcpy(s, p, n * elemsz);
+  *cap = newcap;
   return s;
 }
 
-static toml_arritem_t *expand_arritem(toml_arritem_t *p, int n) {
-  toml_arritem_t *pp = expand(p, n * sizeof(*p), (n + 1) * sizeof(*p));
-  if (!pp)
+/*
+ * Key index
+ */
+static uint32_t key_hash(const char *key) {
+  uint32_t h = 2166136261u; /* FNV-1a */
+  for (; *key; key++)
+    h = (h ^ (uint8_t)*key) * 16777619u;
+  return h;
+}
+
+static const char *slot_key(const toml_table_t *tab, char kind, int idx) {
+  switch (kind) {
+  case 'v':
+    return tab->kval[idx]->key;
+  case 'a':
+    return tab->arr[idx]->key;
+  default:
+    return tab->tab[idx]->key;
+  }
+}
+
+static void index_put(toml_table_t *tab, const char *key, char kind, int idx) {
+  uint32_t hash = key_hash(key);
+  uint32_t i = hash & tab->index_mask;
+  while (tab->index[i].kind)
+    i = (i + 1) & tab->index_mask;
+  tab->index[i].hash = hash;
+  tab->index[i].kind = kind;
+  tab->index[i].idx = idx;
+}
+
+/* Record a key just appended to the table; keys are known to be unique */
+static int index_add(toml_arena_t *arena, toml_table_t *tab, char kind,
+                     int idx) {
+  uint32_t total = tab->nkval + tab->narr + tab->ntab;
+  if (total < TOML_INDEX_MIN)
+    return 0;
+
+  if (tab->index && total * 2 <= tab->index_mask + 1) {
+    index_put(tab, slot_key(tab, kind, idx), kind, idx);
+    return 0;
+  }
+
+  /* (Re)build at a load factor of at most 1/4 */
+  uint32_t size = 16;
+  while (size < total * 4)
+    size *= 2;
+  toml_slot_t *index = arena_alloc(arena, size * sizeof(*index));
+  if (!index)
+    return -1;
+  tab->index = index;
+  tab->index_mask = size - 1;
+
+  for (int i = 0; i < tab->nkval; i++)
+    index_put(tab, tab->kval[i]->key, 'v', i);
+  for (int i = 0; i < tab->narr; i++)
+    index_put(tab, tab->arr[i]->key, 'a', i);
+  for (int i = 0; i < tab->ntab; i++)
+    index_put(tab, tab->tab[i]->key, 't', i);
+  return 0;
+}
+
+/* Find key in tab. Returns the kind ('v', 'a', 't') or 0, and the index. */
+static char lookup_key(const toml_table_t *tab, const char *key, int *idx) {
+  if (tab->index) {
+    uint32_t hash = key_hash(key);
+    for (uint32_t i = hash & tab->index_mask; tab->index[i].kind;
+         i = (i + 1) & tab->index_mask) {
+      const toml_slot_t *slot = &tab->index[i];
+      if (slot->hash == hash &&
+          0 == strcmp(key, slot_key(tab, slot->kind, slot->idx))) {
+        *idx = slot->idx;
+        return slot->kind;
+      }
+    }
     return 0;
+  }
 
-  memset(&pp[n], 0, sizeof(pp[n]));
-  return pp;
+  for (int i = 0; i < tab->nkval; i++) {
+    if (0 == strcmp(key, tab->kval[i]->key))
+      return *idx = i, 'v';
+  }
+  for (int i = 0; i < tab->narr; i++) {
+    if (0 == strcmp(key, tab->arr[i]->key))
+      return *idx = i, 'a';
+  }
+  for (int i = 0; i < tab->ntab; i++) {
+    if (0 == strcmp(key, tab->tab[i]->key))
+      return *idx = i, 't';
+  }
+  return 0;
+}
+
+static toml_arritem_t *expand_arritem(context_t *ctx, toml_array_t *arr) {
+  toml_arritem_t *base = arena_grow(ctx->arena, arr->item, arr->nitem,
+                                    &arr->item_cap, sizeof(*base));
+  if (!base)
+    return 0;
+  arr->item = base;
+  return &base[arr->nitem];
 }
 
 static char *norm_lit_str(const char *src, int srclen, int multiline,
@@ -453,7 +633,7 @@ static char *norm_lit_str(const char *src, int srclen, int multiline,
   /* scan forward on src */
   for (;;) {
     if (off >= max - 10) { /* have some slack for misc stuff */
-      int newmax = max + 50;
+      int newmax = max ? max * 2 : 64;
       char *x = expand(dst, max, newmax);
       if (!x) {
         xfree(dst);
@@ -502,7 +682,7 @@ static char *norm_basic_str(const char *src, int srclen, int multiline,
   /* scan forward on src */
   for (;;) {
     if (off >= max - 10) { /* have some slack for misc stuff */
-      int newmax = max + 50;
+      int newmax = max ? max * 2 : 64;
       char *x = expand(dst, max, newmax);
       if (!x) {
         xfree(dst);
@@ -643,22 +823,27 @@ static char *normalize_key(context_t *ctx, token_t strtok) {
 
     if (ch == '\'') {
       /* for single quote, take it verbatim. */
-      if (!(ret = STRNDUP(sp, sq - sp))) {
+      if (!(ret = arena_strndup(ctx->arena, sp, sq - sp))) {
         e_outofmemory(ctx, FLINE);
         return 0;
       }
     } else {
       /* for double quote, we need to normalize */
-      ret = norm_basic_str(sp, sq - sp, multiline, ebuf, sizeof(ebuf));
-      if (!ret) {
+      char *tmp = norm_basic_str(sp, sq - sp, multiline, ebuf, sizeof(ebuf));
+      if (!tmp) {
         e_syntax(ctx, lineno, ebuf);
         return 0;
       }
+      ret = arena_strndup(ctx->arena, tmp, strlen(tmp));
+      xfree(tmp);
+      if (!ret) {
+        e_outofmemory(ctx, FLINE);
+        return 0;
+      }
     }
 
     /* newlines are not allowed in keys */
     if (strchr(ret, '\n')) {
-      xfree(ret);
       e_badkey(ctx, lineno);
       return 0;
     }
@@ -678,7 +863,7 @@ static char *normalize_key(context_t *ctx, token_t strtok) {
   }
 
   /* dup and return it */
-  if (!(ret = STRNDUP(sp, sq - sp))) {
+  if (!(ret = arena_strndup(ctx->arena, sp, sq - sp))) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
@@ -692,7 +877,6 @@ static char *normalize_key(context_t *ctx, token_t strtok) {
 static int check_key(toml_table_t *tab, const char *key,
                      toml_keyval_t **ret_val, toml_array_t **ret_arr,
                      toml_table_t **ret_tab) {
-  int i;
   void *dummy;
 
   if (!ret_tab)
@@ -706,25 +890,20 @@ static int check_key(toml_table_t *tab, const char *key,
   *ret_arr = 0;
   *ret_val = 0;
 
-  for (i = 0; i < tab->nkval; i++) {
-    if (0 == strcmp(key, tab->kval[i]->key)) {
-      *ret_val = tab->kval[i];
-      return 'v';
-    }
-  }
-  for (i = 0; i < tab->narr; i++) {
-    if (0 == strcmp(key, tab->arr[i]->key)) {
-      *ret_arr = tab->arr[i];
-      return 'a';
-    }
-  }
-  for (i = 0; i < tab->ntab; i++) {
-    if (0 == strcmp(key, tab->tab[i]->key)) {
-      *ret_tab = tab->tab[i];
-      return 't';
-    }
+  int idx;
+  char kind = lookup_key(tab, key, &idx);
+  switch (kind) {
+  case 'v':
+    *ret_val = tab->kval[idx];
+    break;
+  case 'a':
+    *ret_arr = tab->arr[idx];
+    break;
+  case 't':
+    *ret_tab = tab->tab[idx];
+    break;
   }
-  return 0;
+  return kind;
 }
 
 static int key_kind(toml_table_t *tab, const char *key) {
@@ -745,23 +924,21 @@ static toml_keyval_t *create_keyval_in_table(context_t *ctx, toml_table_t *tab,
   /* if key exists: error out. */
   toml_keyval_t *dest = 0;
   if (key_kind(tab, newkey)) {
-    xfree(newkey);
     e_keyexists(ctx, keytok.lineno);
     return 0;
   }
 
   /* make a new entry */
   int n = tab->nkval;
-  toml_keyval_t **base;
-  if (0 == (base = (toml_keyval_t **)expand_ptrarr((void **)tab->kval, n))) {
-    xfree(newkey);
+  toml_keyval_t **base = arena_grow(ctx->arena, tab->kval, n, &tab->kval_cap,
+                                    sizeof(*base));
+  if (!base) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
   tab->kval = base;
 
-  if (0 == (base[n] = (toml_keyval_t *)CALLOC(1, sizeof(*base[n])))) {
-    xfree(newkey);
+  if (0 == (base[n] = arena_alloc(ctx->arena, sizeof(*base[n])))) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
@@ -769,6 +946,10 @@ static toml_keyval_t *create_keyval_in_table(context_t *ctx, toml_table_t *tab,
 
   /* save the key in the new value struct */
   dest->key = newkey;
+  if (index_add(ctx->arena, tab, 'v', n)) {
+    e_outofmemory(ctx, FLINE);
+    return 0;
+  }
   return dest;
 }
 
@@ -786,8 +967,6 @@ static toml_table_t *create_keytable_in_table(context_t *ctx, toml_table_t *tab,
   /* if key exists: error out */
   toml_table_t *dest = 0;
   if (check_key(tab, newkey, 0, 0, &dest)) {
-    xfree(newkey); /* don't need this anymore */
-
     /* special case: if table exists, but was created implicitly ... */
     if (dest && dest->implicit) {
       /* we make it explicit now, and simply return it. */
@@ -800,16 +979,15 @@ static toml_table_t *create_keytable_in_table(context_t *ctx, toml_table_t *tab,
 
   /* create a new table entry */
   int n = tab->ntab;
-  toml_table_t **base;
-  if (0 == (base = (toml_table_t **)expand_ptrarr((void **)tab->tab, n))) {
-    xfree(newkey);
+  toml_table_t **base = arena_grow(ctx->arena, tab->tab, n, &tab->tab_cap,
+                                   sizeof(*base));
+  if (!base) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
   tab->tab = base;
 
-  if (0 == (base[n] = (toml_table_t *)CALLOC(1, sizeof(*base[n])))) {
-    xfree(newkey);
+  if (0 == (base[n] = arena_alloc(ctx->arena, sizeof(*base[n])))) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
@@ -817,6 +995,10 @@ static toml_table_t *create_keytable_in_table(context_t *ctx, toml_table_t *tab,
 
   /* save the key in the new table struct */
   dest->key = newkey;
+  if (index_add(ctx->arena, tab, 't', n)) {
+    e_outofmemory(ctx, FLINE);
+    return 0;
+  }
   return dest;
 }
 
@@ -833,23 +1015,21 @@ static toml_array_t *create_keyarray_in_table(context_t *ctx, toml_table_t *tab,
 
   /* if key exists: error out */
   if (key_kind(tab, newkey)) {
-    xfree(newkey); /* don't need this anymore */
     e_keyexists(ctx, keytok.lineno);
     return 0;
   }
 
   /* make a new array entry */
   int n = tab->narr;
-  toml_array_t **base;
-  if (0 == (base = (toml_array_t **)expand_ptrarr((void **)tab->arr, n))) {
-    xfree(newkey);
+  toml_array_t **base = arena_grow(ctx->arena, tab->arr, n, &tab->arr_cap,
+                                   sizeof(*base));
+  if (!base) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
   tab->arr = base;
 
-  if (0 == (base[n] = (toml_array_t *)CALLOC(1, sizeof(*base[n])))) {
-    xfree(newkey);
+  if (0 == (base[n] = arena_alloc(ctx->arena, sizeof(*base[n])))) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
@@ -858,39 +1038,39 @@ static toml_array_t *create_keyarray_in_table(context_t *ctx, toml_table_t *tab,
   /* save the key in the new array struct */
   dest->key = newkey;
   dest->kind = kind;
+  if (index_add(ctx->arena, tab, 'a', n)) {
+    e_outofmemory(ctx, FLINE);
+    return 0;
+  }
   return dest;
 }
 
 static toml_arritem_t *create_value_in_array(context_t *ctx,
                                              toml_array_t *parent) {
-  const int n = parent->nitem;
-  toml_arritem_t *base = expand_arritem(parent->item, n);
-  if (!base) {
+  toml_arritem_t *item = expand_arritem(ctx, parent);
+  if (!item) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
-  parent->item = base;
   parent->nitem++;
-  return &parent->item[n];
+  return item;
 }
 
 /* Create an array in an array
  */
 static toml_array_t *create_array_in_array(context_t *ctx,
                                            toml_array_t *parent) {
-  const int n = parent->nitem;
-  toml_arritem_t *base = expand_arritem(parent->item, n);
-  if (!base) {
+  toml_arritem_t *item = expand_arritem(ctx, parent);
+  if (!item) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
-  toml_array_t *ret = (toml_array_t *)CALLOC(1, sizeof(toml_array_t));
+  toml_array_t *ret = arena_alloc(ctx->arena, sizeof(toml_array_t));
   if (!ret) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
-  base[n].arr = ret;
-  parent->item = base;
+  item->arr = ret;
   parent->nitem++;
   return ret;
 }
@@ -899,19 +1079,17 @@ static toml_array_t *create_array_in_array(context_t *ctx,
  */
 static toml_table_t *create_table_in_array(context_t *ctx,
                                            toml_array_t *parent) {
-  int n = parent->nitem;
-  toml_arritem_t *base = expand_arritem(parent->item, n);
-  if (!base) {
+  toml_arritem_t *item = expand_arritem(ctx, parent);
+  if (!item) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
-  toml_table_t *ret = (toml_table_t *)CALLOC(1, sizeof(toml_table_t));
+  toml_table_t *ret = arena_alloc(ctx->arena, sizeof(toml_table_t));
   if (!ret) {
     e_outofmemory(ctx, FLINE);
     return 0;
   }
-  base[n].tab = ret;
-  parent->item = base;
+  item->tab = ret;
   parent->nitem++;
   return ret;
 }
@@ -1031,7 +1209,7 @@ static int parse_array(context_t *ctx, toml_array_t *arr) {
       if (!newval)
         return e_outofmemory(ctx, FLINE);
 
-      if (!(newval->val = STRNDUP(val, vlen)))
+      if (!(newval->val = arena_strndup(ctx->arena, val, vlen)))
         return e_outofmemory(ctx, FLINE);
 
       newval->valtype = valtype(newval->val);
@@ -1126,7 +1304,6 @@ static int parse_keyval(context_t *ctx, toml_table_t *tab) {
         return -1;
 
       subtab = toml_table_in(tab, subtabstr);
-      xfree(subtabstr);
     }
     if (!subtab) {
       subtab = create_keytable_in_table(ctx, tab, key);
@@ -1155,7 +1332,7 @@ static int parse_keyval(context_t *ctx, toml_table_t *tab) {
     token_t val = ctx->tok;
 
     assert(keyval->val == 0);
-    if (!(keyval->val = STRNDUP(val.ptr, val.len)))
+    if (!(keyval->val = arena_strndup(ctx->arena, val.ptr, val.len)))
       return e_outofmemory(ctx, FLINE);
 
     if (next_token(ctx, 1))
@@ -1202,12 +1379,9 @@ static int fill_tabpath(context_t *ctx) {
   int lineno = ctx->tok.lineno;
   int i;
 
-  /* clear tpath */
-  for (i = 0; i < ctx->tpath.top; i++) {
-    char **p = &ctx->tpath.key[i];
-    xfree(*p);
-    *p = 0;
-  }
+  /* clear tpath; the keys live in the arena */
+  for (i = 0; i < ctx->tpath.top; i++)
+    ctx->tpath.key[i] = 0;
   ctx->tpath.top = 0;
 
   for (;;) {
@@ -1278,23 +1452,25 @@ static int walk_tabpath(context_t *ctx) {
 
     default: { /* Not found. Let's create an implicit table. */
       int n = curtab->ntab;
-      toml_table_t **base =
-          (toml_table_t **)expand_ptrarr((void **)curtab->tab, n);
+      toml_table_t **base = arena_grow(ctx->arena, curtab->tab, n,
+                                       &curtab->tab_cap, sizeof(*base));
       if (0 == base)
         return e_outofmemory(ctx, FLINE);
 
       curtab->tab = base;
 
-      if (0 == (base[n] = (toml_table_t *)CALLOC(1, sizeof(*base[n]))))
+      if (0 == (base[n] = arena_alloc(ctx->arena, sizeof(*base[n]))))
         return e_outofmemory(ctx, FLINE);
 
-      if (0 == (base[n]->key = STRDUP(key)))
-        return e_outofmemory(ctx, FLINE);
+      /* the tpath key already lives in the arena */
+      base[n]->key = key;
 
       nexttab = curtab->tab[curtab->ntab++];
 
       /* tabs created by walk_tabpath are considered implicit */
       nexttab->implicit = true;
+      if (index_add(ctx->arena, curtab, 't', n))
+        return e_outofmemory(ctx, FLINE);
     } break;
     }
 
@@ -1332,7 +1508,6 @@ static int parse_select(context_t *ctx) {
   /* For [x.y.z] or [[x.y.z]], remove z from tpath.
    */
   token_t z = ctx->tpath.tok[ctx->tpath.top - 1];
-  xfree(ctx->tpath.key[ctx->tpath.top - 1]);
   ctx->tpath.top--;
 
   /* set up ctx->curtab */
@@ -1353,7 +1528,6 @@ static int parse_select(context_t *ctx) {
       if (!zstr)
         return -1;
       arr = toml_array_in(ctx->curtab, zstr);
-      xfree(zstr);
     }
     if (!arr) {
       arr = create_keyarray_in_table(ctx, ctx->curtab, z, 't');
@@ -1370,7 +1544,7 @@ static int parse_select(context_t *ctx) {
       if (!t)
         return -1;
 
-      if (0 == (t->key = STRDUP("__anon__")))
+      if (0 == (t->key = arena_strndup(ctx->arena, "__anon__", 8)))
         return e_outofmemory(ctx, FLINE);
 
       dest = t;
@@ -1421,12 +1595,18 @@ toml_table_t *toml_parse(char *conf, char *errbuf, int errbufsz) {
   ctx.tok.ptr = conf;
   ctx.tok.len = 0;
 
-  // make a root table
-  if (0 == (ctx.root = CALLOC(1, sizeof(*ctx.root)))) {
+  // make the arena and a root table that owns it
+  if (0 == (ctx.arena = arena_new(ctx.stop - ctx.start))) {
+    e_outofmemory(&ctx, FLINE);
+    return 0;
+  }
+  if (0 == (ctx.root = arena_alloc(ctx.arena, sizeof(*ctx.root)))) {
     e_outofmemory(&ctx, FLINE);
     // Do not goto fail, root table not set up yet
+    arena_free(ctx.arena);
     return 0;
   }
+  ctx.root->arena = ctx.arena;
 
   // set root as default table
   ctx.curtab = ctx.root;
@@ -1465,14 +1645,10 @@ toml_table_t *toml_parse(char *conf, char *errbuf, int errbufsz) {
   }
 
   /* success */
-  for (int i = 0; i < ctx.tpath.top; i++)
-    xfree(ctx.tpath.key[i]);
   return ctx.root;
 
 fail:
   // Something bad has happened. Free resources and return error.
-  for (int i = 0; i < ctx.tpath.top; i++)
-    xfree(ctx.tpath.key[i]);
   toml_free(ctx.root);
   return 0;
 }
@@ -1486,7 +1662,7 @@ toml_table_t *toml_parse_file(FILE *fp, char *errbuf, int errbufsz) {
   while (!feof(fp)) {
 
     if (off == bufsz) {
-      int xsz = bufsz + 1000;
+      int xsz = bufsz ? bufsz * 2 : 4096;
       char *x = expand(buf, bufsz, xsz);
       if (!x) {
         snprintf(errbuf, errbufsz, "out of memory");
@@ -1528,60 +1704,12 @@ toml_table_t *toml_parse_file(FILE *fp, char *errbuf, int errbufsz) {
   return ret;
 }
 
-static void xfree_kval(toml_keyval_t *p) {
-  if (!p)
-    return;
-  xfree(p->key);
-  xfree(p->val);
-  xfree(p);
+/* Only the root owns an arena; sub-tables go away with their document */
+void toml_free(toml_table_t *tab) {
+  if (tab)
+    arena_free(tab->arena);
 }
 
-static void xfree_tab(toml_table_t *p);
-
-static void xfree_arr(toml_array_t *p) {
-  if (!p)
-    return;
-
-  xfree(p->key);
-  const int n = p->nitem;
-  for (int i = 0; i < n; i++) {
-    toml_arritem_t *a = &p->item[i];
-    if (a->val)
-      xfree(a->val);
-    else if (a->arr)
-      xfree_arr(a->arr);
-    else if (a->tab)
-      xfree_tab(a->tab);
-  }
-  xfree(p->item);
-  xfree(p);
-}
-
-static void xfree_tab(toml_table_t *p) {
-  int i;
-
-  if (!p)
-    return;
-
-  xfree(p->key);
-
-  for (i = 0; i < p->nkval; i++)
-    xfree_kval(p->kval[i]);
-  xfree(p->kval);
-
-  for (i = 0; i < p->narr; i++)
-    xfree_arr(p->arr[i]);
-  xfree(p->arr);
-
-  for (i = 0; i < p->ntab; i++)
-    xfree_tab(p->tab[i]);
-  xfree(p->tab);
-
-  xfree(p);
-}
-
-void toml_free(toml_table_t *tab) { xfree_tab(tab); }
-
 static void set_token(context_t *ctx, tokentype_t tok, int lineno, char *ptr,
                       int len) {
   token_t t;
@@ -1878,47 +2006,23 @@ const char *toml_key_in(const toml_table_t *tab, int keyidx) {
 }
 
 int toml_key_exists(const toml_table_t *tab, const char *key) {
-  int i;
-  for (i = 0; i < tab->nkval; i++) {
-    if (0 == strcmp(key, tab->kval[i]->key))
-      return 1;
-  }
-  for (i = 0; i < tab->narr; i++) {
-    if (0 == strcmp(key, tab->arr[i]->key))
-      return 1;
-  }
-  for (i = 0; i < tab->ntab; i++) {
-    if (0 == strcmp(key, tab->tab[i]->key))
-      return 1;
-  }
-  return 0;
+  int idx;
+  return lookup_key(tab, key, &idx) != 0;
 }
 
 toml_raw_t toml_raw_in(const toml_table_t *tab, const char *key) {
-  int i;
-  for (i = 0; i < tab->nkval; i++) {
-    if (0 == strcmp(key, tab->kval[i]->key))
-      return tab->kval[i]->val;
-  }
-  return 0;
+  int idx;
+  return lookup_key(tab, key, &idx) == 'v' ? tab->kval[idx]->val : 0;
 }
 
 toml_array_t *toml_array_in(const toml_table_t *tab, const char *key) {
-  int i;
-  for (i = 0; i < tab->narr; i++) {
-    if (0 == strcmp(key, tab->arr[i]->key))
-      return tab->arr[i];
-  }
-  return 0;
+  int idx;
+  return lookup_key(tab, key, &idx) == 'a' ? tab->arr[idx] : 0;
 }
 
 toml_table_t *toml_table_in(const toml_table_t *tab, const char *key) {
-  int i;
-  for (i = 0; i < tab->ntab; i++) {
-    if (0 == strcmp(key, tab->tab[i]->key))
-      return tab->tab[i];
-  }
-  return 0;
+  int idx;
+  return lookup_key(tab, key, &idx) == 't' ? tab->tab[idx] : 0;
 }
 
 toml_raw_t toml_raw_at(const toml_array_t *arr, int idx) {
@@ -147,6 +147,7 @@ struct toplevel *server_find_toplevel_by_title(struct server *server, const char
 void workspace_show(struct server *server, int workspace) {
     if (workspace < 1 || workspace > MAX_WORKSPACES) return;
     
+    gesture_swipe_cancel(server);
     server->current_workspace = workspace;
     
     struct toplevel *toplevel;